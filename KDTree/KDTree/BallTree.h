@@ -0,0 +1,435 @@
+#pragma once
+#include <vector>
+#include <cmath>
+#include <algorithm>
+#include <limits>
+
+#include "KDTree.h"
+
+//a metric tree whose nodes are bounded by balls instead of boxes: a ball follows clusters and curved manifolds
+//of any orientation, where the boxes of a kd-tree stay as wide as the cluster spread along the axes;
+//the queries are the same as the exact ones of BasicKDTree
+template <int Dimension, typename Scalar>
+class BasicBallTree {
+private:
+	static const int NO_CHILD = -1;
+	static const int LEAF_SCAN_BLOCK_SIZE = 16;
+	//the subtrees halve on every level, so no path of a tree over at most 2^31 points is this long
+	static const int TRAVERSAL_STACK_SIZE = 64;
+
+	struct BallNode {
+		int leftChild;
+		int rightChild;
+		int firstPoint;
+		int lastPoint;
+
+		BallNode() :
+			leftChild(NO_CHILD),
+			rightChild(NO_CHILD),
+			firstPoint(0),
+			lastPoint(0) {
+
+			//do nothing
+		}
+
+		bool isLeaf() const {
+			return leftChild == NO_CHILD;
+		}
+	};
+
+	//a subtree waiting to be built, the left child always follows its parent, so only right children are linked
+	//to the parent when they are built
+	struct BuildTask {
+		int parentIndex;
+		int firstPoint;
+		int lastPoint;
+
+		BuildTask(int newParentIndex, int newFirstPoint, int newLastPoint) :
+			parentIndex(newParentIndex),
+			firstPoint(newFirstPoint),
+			lastPoint(newLastPoint) {
+
+			//do nothing
+		}
+	};
+
+	//a child put aside by a search with the squared distance from the point to its ball
+	struct PendingNode {
+		int nodeIndex;
+		Scalar ballDistance;
+	};
+
+	int dimension_;
+	int leafSize_;
+	//the row kernel measured fastest for the dimension
+	DistanceKernel kernel_;
+
+	//nodes are stored in preorder, the ball of node i is centers_[i * stride] with radius radii_[i];
+	//the points of every subtree form the range [firstPoint, lastPoint) of points_, which are in leaf order
+	std::vector<BallNode> nodes_;
+	std::vector<Scalar> centers_;
+	std::vector<Scalar> radii_;
+	BasicPointSet<Scalar> points_;
+
+	BasicBallTree(const BasicBallTree &);
+	BasicBallTree& operator=(const BasicBallTree &);
+
+	const Scalar* getCenter(int nodeIndex) const {
+		return &centers_[static_cast<size_t>(points_.getStride()) * nodeIndex];
+	}
+
+	//squared distance from the point to the nearest point of the ball of the node, zero inside it
+	Scalar distanceToBall(int nodeIndex, const Scalar* point) const {
+		Scalar centerDistance = sqrt(distanceBetweenPoints<Dimension, Scalar>(getCenter(nodeIndex), point, getDimension())) - radii_[nodeIndex];
+		return (centerDistance > 0 ? centerDistance * centerDistance : 0);
+	}
+
+	Scalar farthestDistanceToBall(int nodeIndex, const Scalar* point) const {
+		Scalar centerDistance = sqrt(distanceBetweenPoints<Dimension, Scalar>(getCenter(nodeIndex), point, getDimension())) + radii_[nodeIndex];
+		return centerDistance * centerDistance;
+	}
+
+	//the centroid of the points and the distance to the farthest of them, returns the number of that point
+	int setBall(const BasicPointSet<Scalar> &sourcePoints, const std::vector<int> &permutation, int firstPoint, int lastPoint,
+		Scalar* center, Scalar &radius) const {
+
+		std::vector<double> sums(getDimension(), 0);
+		for (int currentPointPosition = firstPoint; currentPointPosition < lastPoint; ++currentPointPosition) {
+			const Scalar* point = sourcePoints.getPoint(permutation[currentPointPosition]);
+			for (int currentCoordinate = 0; currentCoordinate < getDimension(); ++currentCoordinate) {
+				sums[currentCoordinate] += point[currentCoordinate];
+			}
+		}
+		for (int currentCoordinate = 0; currentCoordinate < getDimension(); ++currentCoordinate) {
+			center[currentCoordinate] = static_cast<Scalar>(sums[currentCoordinate] / (lastPoint - firstPoint));
+		}
+
+		int farthestPoint = permutation[firstPoint];
+		Scalar squaredRadius = 0;
+		for (int currentPointPosition = firstPoint; currentPointPosition < lastPoint; ++currentPointPosition) {
+			Scalar newDistance = distanceBetweenPoints<Dimension, Scalar>(sourcePoints.getPoint(permutation[currentPointPosition]), center, getDimension());
+			if (newDistance > squaredRadius) {
+				squaredRadius = newDistance;
+				farthestPoint = permutation[currentPointPosition];
+			}
+		}
+
+		//the centroid is rounded, so the radius is widened by the rounding of the distance
+		radius = sqrt(squaredRadius) * (1 + 4 * std::numeric_limits<Scalar>::epsilon());
+		return farthestPoint;
+	}
+
+	//the points are split at the median of their projections onto the line through the farthest point from the centroid
+	//and the farthest point from that one, which approximates the widest direction of the node
+	int splitPoints(const BasicPointSet<Scalar> &sourcePoints, std::vector<int> &permutation, int firstPoint, int lastPoint, int farthestPoint) const {
+		const Scalar* firstPole = sourcePoints.getPoint(farthestPoint);
+		const Scalar* secondPole = firstPole;
+		Scalar maxDistance = -1;
+		for (int currentPointPosition = firstPoint; currentPointPosition < lastPoint; ++currentPointPosition) {
+			const Scalar* point = sourcePoints.getPoint(permutation[currentPointPosition]);
+			Scalar newDistance = distanceBetweenPoints<Dimension, Scalar>(point, firstPole, getDimension());
+			if (newDistance > maxDistance) {
+				maxDistance = newDistance;
+				secondPole = point;
+			}
+		}
+
+		std::vector<std::pair<Scalar, int> > projections(lastPoint - firstPoint);
+		for (int currentPointPosition = firstPoint; currentPointPosition < lastPoint; ++currentPointPosition) {
+			const Scalar* point = sourcePoints.getPoint(permutation[currentPointPosition]);
+			Scalar projection = 0;
+			for (int currentCoordinate = 0; currentCoordinate < getDimension(); ++currentCoordinate) {
+				projection += (secondPole[currentCoordinate] - firstPole[currentCoordinate]) * point[currentCoordinate];
+			}
+			projections[currentPointPosition - firstPoint] = std::make_pair(projection, permutation[currentPointPosition]);
+		}
+
+		//ties are broken by number, so the halves do not depend on the library
+		int middlePoint = firstPoint + (lastPoint - firstPoint) / 2;
+		std::nth_element(projections.begin(), projections.begin() + (middlePoint - firstPoint), projections.end());
+		for (int currentPointPosition = firstPoint; currentPointPosition < lastPoint; ++currentPointPosition) {
+			permutation[currentPointPosition] = projections[currentPointPosition - firstPoint].second;
+		}
+
+		return middlePoint;
+	}
+
+	void initialize(const BasicPointSet<Scalar> &sourcePoints, int leafSize) {
+		assert((Dimension == DYNAMIC_DIMENSION) || (sourcePoints.size() == 0) || (sourcePoints.getDimension() == Dimension));
+		assert(leafSize > 0);
+
+		dimension_ = (Dimension == DYNAMIC_DIMENSION ? sourcePoints.getDimension() : Dimension);
+		leafSize_ = leafSize;
+		kernel_ = getMeasuredDistanceKernel(dimension_, ROW_KERNEL_LAYOUT);
+		points_.changeDimension(getDimension());
+		if (sourcePoints.size() == 0) {
+			return;
+		}
+
+		std::vector<int> permutation(sourcePoints.size());
+		for (int currentPointNumber = 0; currentPointNumber < sourcePoints.size(); ++currentPointNumber) {
+			permutation[currentPointNumber] = currentPointNumber;
+		}
+
+		int stride = points_.getStride();
+		std::vector<BuildTask> buildTasks(1, BuildTask(NO_CHILD, 0, sourcePoints.size()));
+		while (!buildTasks.empty()) {
+			BuildTask task = buildTasks.back();
+			buildTasks.pop_back();
+
+			int nodeIndex = nodes_.size();
+			nodes_.push_back(BallNode());
+			nodes_[nodeIndex].firstPoint = task.firstPoint;
+			nodes_[nodeIndex].lastPoint = task.lastPoint;
+			if (task.parentIndex != NO_CHILD) {
+				nodes_[task.parentIndex].rightChild = nodeIndex;
+			}
+
+			centers_.resize(centers_.size() + stride, 0);
+			radii_.push_back(0);
+			int farthestPoint = setBall(sourcePoints, permutation, task.firstPoint, task.lastPoint, &centers_[stride * nodeIndex], radii_[nodeIndex]);
+
+			if (task.lastPoint - task.firstPoint <= leafSize_) {
+				continue;
+			}
+
+			int middlePoint = splitPoints(sourcePoints, permutation, task.firstPoint, task.lastPoint, farthestPoint);
+			nodes_[nodeIndex].leftChild = nodeIndex + 1;
+
+			//the left half is popped first, so it is stored right after its parent
+			buildTasks.push_back(BuildTask(nodeIndex, middlePoint, task.lastPoint));
+			buildTasks.push_back(BuildTask(NO_CHILD, task.firstPoint, middlePoint));
+		}
+
+		points_.reserve(sourcePoints.size());
+		for (int currentPointPosition = 0; currentPointPosition < sourcePoints.size(); ++currentPointPosition) {
+			points_.addPoint(sourcePoints.getPoint(permutation[currentPointPosition]), sourcePoints.getIdentifier(permutation[currentPointPosition]));
+		}
+	}
+
+	//squared distances from the point to the points at positions [firstPosition, lastPosition) by the vector kernel
+	int getBlockDistances(int firstPosition, int lastPosition, const Scalar* point, Scalar* distances) const {
+		return firstPosition + ::getBlockDistances(kernel_, points_.getPoint(firstPosition), lastPosition - firstPosition,
+			points_.getStride(), point, getDimension(), distances);
+	}
+
+	//depth-first search, the child with the nearer ball first; leafScanner(leaf) looks at the points of a leaf
+	//and isBallSearched(ballDistance) tells whether a ball may still hold a point the search is looking for
+	template <typename LeafScanner, typename BallCheck>
+	void searchBalls(const Scalar* point, const LeafScanner &leafScanner, const BallCheck &isBallSearched) const {
+		PendingNode pendingNodes[TRAVERSAL_STACK_SIZE];
+		int pendingNodesNumber = 0;
+		int nodeIndex = 0;
+
+		while (true) {
+			while (!nodes_[nodeIndex].isLeaf()) {
+				int nearChild = nodes_[nodeIndex].leftChild;
+				int farChild = nodes_[nodeIndex].rightChild;
+				Scalar nearBallDistance = distanceToBall(nearChild, point);
+				Scalar farBallDistance = distanceToBall(farChild, point);
+
+				if (farBallDistance < nearBallDistance) {
+					std::swap(nearChild, farChild);
+					std::swap(nearBallDistance, farBallDistance);
+				}
+
+				if (isBallSearched(farBallDistance)) {
+					assert(pendingNodesNumber < TRAVERSAL_STACK_SIZE);
+					pendingNodes[pendingNodesNumber].nodeIndex = farChild;
+					pendingNodes[pendingNodesNumber].ballDistance = farBallDistance;
+					++pendingNodesNumber;
+				}
+
+				if (!isBallSearched(nearBallDistance)) {
+					break;
+				}
+				nodeIndex = nearChild;
+			}
+
+			if (nodes_[nodeIndex].isLeaf()) {
+				leafScanner(nodes_[nodeIndex]);
+			}
+
+			while ((pendingNodesNumber > 0) && !isBallSearched(pendingNodes[pendingNodesNumber - 1].ballDistance)) {
+				--pendingNodesNumber;
+			}
+
+			if (pendingNodesNumber == 0) {
+				return;
+			}
+
+			nodeIndex = pendingNodes[--pendingNodesNumber].nodeIndex;
+		}
+	}
+
+	//balls inside the query ball are reported without looking at the distances of their points;
+	//pointsCallback(firstPosition, lastPosition) gets the ranges of positions of the points found;
+	//the bounds of a ball are rounded through a square root, so a ball is skipped or taken whole only
+	//when it is farther than EPS from the sphere
+	template <typename PointsCallback>
+	void searchRadius(const Scalar* point, Scalar squaredRadius, const PointsCallback &pointsCallback) const {
+		int pendingNodes[TRAVERSAL_STACK_SIZE];
+		int pendingNodesNumber = 0;
+		pendingNodes[pendingNodesNumber++] = 0;
+
+		while (pendingNodesNumber > 0) {
+			int nodeIndex = pendingNodes[--pendingNodesNumber];
+			if (distanceToBall(nodeIndex, point) > squaredRadius + EPS) {
+				continue;
+			}
+
+			const BallNode &currentNode = nodes_[nodeIndex];
+			if (farthestDistanceToBall(nodeIndex, point) < squaredRadius - EPS) {
+				pointsCallback(currentNode.firstPoint, currentNode.lastPoint);
+				continue;
+			}
+
+			if (currentNode.isLeaf()) {
+				for (int currentPointPosition = currentNode.firstPoint; currentPointPosition < currentNode.lastPoint; ++currentPointPosition) {
+					if (distanceBetweenPoints<Dimension, Scalar>(points_.getPoint(currentPointPosition), point, getDimension()) <= squaredRadius) {
+						pointsCallback(currentPointPosition, currentPointPosition + 1);
+					}
+				}
+
+				continue;
+			}
+
+			assert(pendingNodesNumber + 2 <= TRAVERSAL_STACK_SIZE);
+			pendingNodes[pendingNodesNumber++] = currentNode.rightChild;
+			pendingNodes[pendingNodesNumber++] = currentNode.leftChild;
+		}
+	}
+
+public:
+	BasicBallTree(const BasicPointSet<Scalar> &points, int leafSize = DEFAULT_LEAF_SIZE) {
+		initialize(points, leafSize);
+	}
+
+	int getDimension() const {
+		return (Dimension == DYNAMIC_DIMENSION ? dimension_ : Dimension);
+	}
+
+	int getPointsNumber() const {
+		return points_.size();
+	}
+
+	int getLeafSize() const {
+		return leafSize_;
+	}
+
+	//number of nodes on the longest path from the root to a leaf, the right halves are never smaller
+	int getDepth() const {
+		if (nodes_.empty()) {
+			return 0;
+		}
+
+		int depth = 1;
+		for (int nodeIndex = 0; !nodes_[nodeIndex].isLeaf(); nodeIndex = nodes_[nodeIndex].rightChild) {
+			++depth;
+		}
+
+		return depth;
+	}
+
+	//bytes taken by the nodes, balls and points
+	size_t getMemoryUsage() const {
+		return nodes_.size() * sizeof(BallNode) + (centers_.size() + radii_.size()) * sizeof(Scalar)
+			+ static_cast<size_t>(points_.size()) * (points_.getStride() * sizeof(Scalar) + sizeof(int));
+	}
+
+	int getMinDistanceIdentifier(const Scalar* point, double &distance) const {
+		Scalar squaredDistance = std::numeric_limits<Scalar>::max();
+		int resultIdentifier = -1;
+
+		if (!nodes_.empty()) {
+			searchBalls(point, [&](const BallNode &leaf) {
+				Scalar blockDistances[LEAF_SCAN_BLOCK_SIZE];
+
+				for (int blockBegin = leaf.firstPoint; blockBegin < leaf.lastPoint; blockBegin += LEAF_SCAN_BLOCK_SIZE) {
+					int blockEnd = std::min(blockBegin + LEAF_SCAN_BLOCK_SIZE, leaf.lastPoint);
+					int nearestPosition = getBlockDistances(blockBegin, blockEnd, point, blockDistances);
+
+					if (blockDistances[nearestPosition - blockBegin] < squaredDistance + EPS) {
+						resultIdentifier = points_.getIdentifier(nearestPosition);
+						squaredDistance = blockDistances[nearestPosition - blockBegin];
+					}
+				}
+			}, [&](Scalar ballDistance) {
+				return ballDistance < squaredDistance + EPS;
+			});
+		}
+
+		distance = sqrt(static_cast<double>(squaredDistance));
+		return resultIdentifier;
+	}
+
+	//fills neighbours with the k closest points sorted by distance
+	void getKNearest(const Scalar* point, int k, std::vector<Neighbour> &neighbours) const {
+		neighbours.clear();
+		if ((k <= 0) || nodes_.empty()) {
+			return;
+		}
+
+		size_t neighboursNumber = k;
+		searchBalls(point, [&](const BallNode &leaf) {
+			Scalar blockDistances[LEAF_SCAN_BLOCK_SIZE];
+
+			for (int blockBegin = leaf.firstPoint; blockBegin < leaf.lastPoint; blockBegin += LEAF_SCAN_BLOCK_SIZE) {
+				int blockEnd = std::min(blockBegin + LEAF_SCAN_BLOCK_SIZE, leaf.lastPoint);
+				getBlockDistances(blockBegin, blockEnd, point, blockDistances);
+
+				for (int currentPointPosition = blockBegin; currentPointPosition < blockEnd; ++currentPointPosition) {
+					Neighbour candidate(points_.getIdentifier(currentPointPosition), blockDistances[currentPointPosition - blockBegin]);
+
+					if (neighbours.size() < neighboursNumber) {
+						neighbours.push_back(candidate);
+						std::push_heap(neighbours.begin(), neighbours.end());
+					} else if (candidate < neighbours.front()) {
+						std::pop_heap(neighbours.begin(), neighbours.end());
+						neighbours.back() = candidate;
+						std::push_heap(neighbours.begin(), neighbours.end());
+					}
+				}
+			}
+		}, [&](Scalar ballDistance) {
+			return (neighbours.size() < neighboursNumber) || (ballDistance < neighbours.front().distance + EPS);
+		});
+
+		std::sort_heap(neighbours.begin(), neighbours.end());
+		for (size_t currentNeighbour = 0; currentNeighbour < neighbours.size(); ++currentNeighbour) {
+			neighbours[currentNeighbour].distance = sqrt(neighbours[currentNeighbour].distance);
+		}
+	}
+
+	//calls callback(identifier) for every point at distance at most radius, in no particular order
+	template <typename Callback>
+	void radiusSearch(const Scalar* point, double radius, Callback callback) const {
+		if (!nodes_.empty()) {
+			searchRadius(point, static_cast<Scalar>(radius * radius), [&](int firstPosition, int lastPosition) {
+				for (int currentPointPosition = firstPosition; currentPointPosition < lastPosition; ++currentPointPosition) {
+					callback(points_.getIdentifier(currentPointPosition));
+				}
+			});
+		}
+	}
+
+	void radiusSearch(const Scalar* point, double radius, std::vector<int> &identifiers) const {
+		identifiers.clear();
+		radiusSearch(point, radius, [&identifiers](int identifier) {
+			identifiers.push_back(identifier);
+		});
+	}
+
+	int radiusCount(const Scalar* point, double radius) const {
+		int pointsNumber = 0;
+		if (!nodes_.empty()) {
+			searchRadius(point, static_cast<Scalar>(radius * radius), [&pointsNumber](int firstPosition, int lastPosition) {
+				pointsNumber += lastPosition - firstPosition;
+			});
+		}
+
+		return pointsNumber;
+	}
+};
+
+typedef BasicBallTree<DYNAMIC_DIMENSION, double> BallTree;
@@ -0,0 +1,17 @@
+#pragma once
+
+#include "KDTree.h"
+
+//distance to the nearest point by a full scan, the oracle the trees are checked against
+double simpleAlgoritm(const PointSet &points, const double* requestPoint) {
+	double distance = distanceBetweenPoints(points.getPoint(0), requestPoint, points.getDimension());
+
+	for (int currentPointNumber = 1; currentPointNumber < points.size(); ++currentPointNumber) {
+		double newDistance = distanceBetweenPoints(points.getPoint(currentPointNumber), requestPoint, points.getDimension());
+		if (newDistance + EPS < distance) {
+			distance = newDistance;
+		}
+	}
+
+	return sqrt(distance);
+}
@@ -0,0 +1,393 @@
+#pragma once
+#include <vector>
+#include <cmath>
+#include <algorithm>
+#include <limits>
+#include <memory>
+#include <cassert>
+
+#include "KDTree.h"
+
+//relative error of a distance summed in float over up to a hundred coordinates, with a wide margin
+const double COMPACT_KDTREE_RELATIVE_ERROR = 1E-5;
+
+//coordinates are rounded to the nearest float
+class FloatStorage {
+public:
+	typedef float StoredScalar;
+
+private:
+	std::vector<double> maxErrors_;
+
+public:
+	//the borders are those of the box of all points
+	void fit(const std::vector<double> &lowerBorder, const std::vector<double> &upperBorder) {
+		maxErrors_.resize(lowerBorder.size());
+		for (size_t currentCoordinate = 0; currentCoordinate < maxErrors_.size(); ++currentCoordinate) {
+			maxErrors_[currentCoordinate] = std::max(fabs(lowerBorder[currentCoordinate]), fabs(upperBorder[currentCoordinate])) 
+				* std::numeric_limits<float>::epsilon();
+		}
+	}
+
+	StoredScalar encode(double value, int) const {
+		return static_cast<float>(value);
+	}
+
+	float decode(StoredScalar value, int) const {
+		return value;
+	}
+
+	//the largest difference between a coordinate and its decoded value
+	double getMaxError(int coordinate) const {
+		return maxErrors_[coordinate];
+	}
+};
+
+//every coordinate is mapped linearly onto [-32767, 32767] over the range of the points
+class Int16Storage {
+public:
+	typedef short StoredScalar;
+
+private:
+	static const int MAX_STORED_VALUE = 32767;
+
+	std::vector<float> offsets_;
+	std::vector<float> steps_;
+	std::vector<double> maxErrors_;
+
+public:
+	void fit(const std::vector<double> &lowerBorder, const std::vector<double> &upperBorder) {
+		int dimension = static_cast<int>(lowerBorder.size());
+		offsets_.resize(dimension);
+		steps_.resize(dimension);
+		maxErrors_.resize(dimension);
+		for (int currentCoordinate = 0; currentCoordinate < dimension; ++currentCoordinate) {
+			double halfRange = (upperBorder[currentCoordinate] - lowerBorder[currentCoordinate]) / 2;
+			offsets_[currentCoordinate] = static_cast<float>((lowerBorder[currentCoordinate] + upperBorder[currentCoordinate]) / 2);
+			steps_[currentCoordinate] = static_cast<float>(halfRange > 0 ? halfRange / MAX_STORED_VALUE : 1);
+
+			//half a step of rounding, the error of the float offset and of the float decoding
+			double magnitude = std::max(fabs(lowerBorder[currentCoordinate]), fabs(upperBorder[currentCoordinate]));
+			maxErrors_[currentCoordinate] = steps_[currentCoordinate] / 2 + fabs(offsets_[currentCoordinate] - (lowerBorder[currentCoordinate] + upperBorder[currentCoordinate]) / 2)
+				+ 4 * magnitude * std::numeric_limits<float>::epsilon();
+		}
+	}
+
+	StoredScalar encode(double value, int coordinate) const {
+		double storedValue = floor((value - offsets_[coordinate]) / steps_[coordinate] + 0.5);
+		return static_cast<StoredScalar>(std::max(-static_cast<double>(MAX_STORED_VALUE), std::min(static_cast<double>(MAX_STORED_VALUE), storedValue)));
+	}
+
+	float decode(StoredScalar value, int coordinate) const {
+		return offsets_[coordinate] + value * steps_[coordinate];
+	}
+
+	double getMaxError(int coordinate) const {
+		return maxErrors_[coordinate];
+	}
+};
+
+//a kd-tree whose boxes and leaf coordinates are kept in the reduced precision of Storage;
+//the search prunes with the reduced distances widened by their error bound and computes exact distances
+//for the remaining candidates only; the exact points come from a tree mapped from an index file, in the order
+//of the leaves, so only the pages of the re-checked candidates are read into memory
+template <int Dimension, typename Storage>
+class BasicCompactKDTree {
+public:
+	typedef BasicKDTree<Dimension, double> ExactTree;
+
+private:
+	typedef typename Storage::StoredScalar StoredScalar;
+
+	//the subtrees halve on every level, so no path of a tree over at most 2^31 points is this long
+	static const int TRAVERSAL_STACK_SIZE = 64;
+
+	struct CompactNode {
+		int leftChild;
+		int rightChild;
+		int firstPoint;
+		int lastPoint;
+
+		bool isLeaf() const {
+			return leftChild < 0;
+		}
+	};
+
+	//a subtree left for later with the reduced distance to its box
+	struct PendingNode {
+		int nodeIndex;
+		double distance;
+	};
+
+	int dimension_;
+	Storage storage_;
+
+	//the error of a reduced distance is at most maxError_ plus COMPACT_KDTREE_RELATIVE_ERROR of it,
+	//maxError_ is twice the norm of the coordinate errors to leave a margin
+	double maxError_;
+
+	std::vector<CompactNode> nodes_;
+	std::vector<StoredScalar> borders_;
+	std::vector<StoredScalar> points_;
+
+	//the mapped exact tree, its points are numbered like the reduced ones
+	std::unique_ptr<ExactTree> exactTree_;
+
+	BasicCompactKDTree(const BasicCompactKDTree &);
+	BasicCompactKDTree& operator=(const BasicCompactKDTree &);
+
+	explicit BasicCompactKDTree(std::unique_ptr<ExactTree> exactTree) :
+		dimension_(exactTree->getDimension()),
+		maxError_(0),
+		exactTree_(std::move(exactTree)) {
+
+		//do nothing
+	}
+
+	double getDistanceSlack(double distance) const {
+		return maxError_ + distance * COMPACT_KDTREE_RELATIVE_ERROR;
+	}
+
+	double distanceToStoredPoint(int pointPosition, const float* point) const {
+		const StoredScalar* storedPoint = &points_[static_cast<size_t>(dimension_) * pointPosition];
+		float result = 0;
+
+		for (int currentCoordinate = 0; currentCoordinate < getDimension(); ++currentCoordinate) {
+			float coordinatesDifference = storage_.decode(storedPoint[currentCoordinate], currentCoordinate) - point[currentCoordinate];
+			result += coordinatesDifference * coordinatesDifference;
+		}
+
+		return sqrt(static_cast<double>(result));
+	}
+
+	double distanceToStoredBox(int nodeIndex, const float* point) const {
+		const StoredScalar* lowerBorder = &borders_[2 * static_cast<size_t>(dimension_) * nodeIndex];
+		const StoredScalar* upperBorder = lowerBorder + dimension_;
+		float result = 0;
+
+		for (int currentCoordinate = 0; currentCoordinate < getDimension(); ++currentCoordinate) {
+			float coordinatesDifference = std::max(storage_.decode(lowerBorder[currentCoordinate], currentCoordinate) - point[currentCoordinate], 0.0f)
+				+ std::max(point[currentCoordinate] - storage_.decode(upperBorder[currentCoordinate], currentCoordinate), 0.0f);
+			result += coordinatesDifference * coordinatesDifference;
+		}
+
+		return sqrt(static_cast<double>(result));
+	}
+
+	//the error of the query rounded to float, added to the slack of every distance of the query
+	double prepareQuery(const double* point, std::vector<float> &reducedPoint) const {
+		reducedPoint.resize(dimension_);
+		double squaredError = 0;
+
+		for (int currentCoordinate = 0; currentCoordinate < dimension_; ++currentCoordinate) {
+			reducedPoint[currentCoordinate] = static_cast<float>(point[currentCoordinate]);
+			double coordinateError = fabs(point[currentCoordinate]) * std::numeric_limits<float>::epsilon();
+			squaredError += coordinateError * coordinateError;
+		}
+
+		return sqrt(squaredError);
+	}
+
+	//a reduced distance can belong to one of the k nearest points while it is not above the bound
+	static double getBound(size_t k, const std::vector<double> &bounds) {
+		return (bounds.size() < k ? std::numeric_limits<double>::max() : bounds.front());
+	}
+
+	//bounds is a max-heap of the k smallest upper bounds of the true distances seen so far,
+	//candidates keep the positions and reduced distances of the points which may still be among the k nearest;
+	//the nearer child is visited first, the farther one waits on the stack with the distance to its box
+	void collectCandidates(const float* point, double queryError, size_t k, std::vector<double> &bounds,
+		std::vector<Neighbour> &candidates) const {
+
+		PendingNode pendingNodes[TRAVERSAL_STACK_SIZE];
+		int pendingNodesNumber = 0;
+		pendingNodes[pendingNodesNumber].nodeIndex = 0;
+		pendingNodes[pendingNodesNumber++].distance = 0;
+
+		while (pendingNodesNumber > 0) {
+			PendingNode pendingNode = pendingNodes[--pendingNodesNumber];
+			if (pendingNode.distance - getDistanceSlack(pendingNode.distance) - queryError > getBound(k, bounds)) {
+				continue;
+			}
+
+			const CompactNode &currentNode = nodes_[pendingNode.nodeIndex];
+			if (currentNode.isLeaf()) {
+				for (int currentPointPosition = currentNode.firstPoint; currentPointPosition < currentNode.lastPoint; ++currentPointPosition) {
+					double distance = distanceToStoredPoint(currentPointPosition, point);
+					double slack = getDistanceSlack(distance) + queryError;
+					if (distance - slack > getBound(k, bounds)) {
+						continue;
+					}
+
+					candidates.push_back(Neighbour(currentPointPosition, distance));
+					if (bounds.size() < k) {
+						bounds.push_back(distance + slack);
+						std::push_heap(bounds.begin(), bounds.end());
+					} else if (distance + slack < bounds.front()) {
+						std::pop_heap(bounds.begin(), bounds.end());
+						bounds.back() = distance + slack;
+						std::push_heap(bounds.begin(), bounds.end());
+					}
+				}
+
+				continue;
+			}
+
+			int nearChild = currentNode.leftChild;
+			int farChild = currentNode.rightChild;
+			double nearChildDistance = distanceToStoredBox(nearChild, point);
+			double farChildDistance = distanceToStoredBox(farChild, point);
+			if (farChildDistance < nearChildDistance) {
+				std::swap(nearChild, farChild);
+				std::swap(nearChildDistance, farChildDistance);
+			}
+
+			assert(pendingNodesNumber + 2 <= TRAVERSAL_STACK_SIZE);
+			pendingNodes[pendingNodesNumber].nodeIndex = farChild;
+			pendingNodes[pendingNodesNumber++].distance = farChildDistance;
+			pendingNodes[pendingNodesNumber].nodeIndex = nearChild;
+			pendingNodes[pendingNodesNumber++].distance = nearChildDistance;
+		}
+	}
+
+	//replaces the candidates by the k nearest of them with exact distances and identifiers, sorted
+	void checkCandidates(const double* point, double queryError, size_t k, const std::vector<double> &bounds, std::vector<Neighbour> &candidates) const {
+		double bound = getBound(k, bounds);
+		size_t checkedNumber = 0;
+
+		for (size_t currentCandidate = 0; currentCandidate < candidates.size(); ++currentCandidate) {
+			double distance = candidates[currentCandidate].distance;
+			if (distance - getDistanceSlack(distance) - queryError > bound) {
+				continue;
+			}
+
+			int pointPosition = candidates[currentCandidate].identifier;
+			candidates[checkedNumber++] = Neighbour(exactTree_->getIdentifier(pointPosition),
+				distanceBetweenPoints<Dimension>(exactTree_->getPoint(pointPosition), point, dimension_));
+		}
+
+		candidates.resize(checkedNumber);
+		size_t resultSize = std::min(k, candidates.size());
+		std::partial_sort(candidates.begin(), candidates.begin() + resultSize, candidates.end());
+		candidates.resize(resultSize);
+	}
+
+public:
+	//the arrays a search works in, a caller running many searches passes the same buffers to all of them
+	//so they are allocated once; one buffers object serves one search at a time
+	struct SearchBuffers {
+		std::vector<float> reducedPoint;
+		std::vector<double> bounds;
+	};
+
+	//builds the tree over an exact tree opened by ExactTree::open, which it keeps to re-check the candidates;
+	//the index file belongs to the caller and has to outlive the tree, returns NULL when openedTree is NULL
+	static std::unique_ptr<BasicCompactKDTree> create(std::unique_ptr<ExactTree> openedTree) {
+		if (!openedTree) {
+			return std::unique_ptr<BasicCompactKDTree>();
+		}
+
+		std::unique_ptr<BasicCompactKDTree> tree(new BasicCompactKDTree(std::move(openedTree)));
+		const ExactTree &exactTree = *tree->exactTree_;
+		Storage &storage = tree->storage_;
+		int dimension = tree->dimension_;
+
+		//the root box is the box of all points
+		std::vector<double> lowerBorder(dimension, 0), upperBorder(dimension, 0);
+		if (exactTree.nodesNumber_ > 0) {
+			std::copy(exactTree.getLowerBorder(0), exactTree.getLowerBorder(0) + dimension, lowerBorder.begin());
+			std::copy(exactTree.getUpperBorder(0), exactTree.getUpperBorder(0) + dimension, upperBorder.begin());
+		}
+
+		storage.fit(lowerBorder, upperBorder);
+		for (int currentCoordinate = 0; currentCoordinate < dimension; ++currentCoordinate) {
+			tree->maxError_ += storage.getMaxError(currentCoordinate) * storage.getMaxError(currentCoordinate);
+		}
+		tree->maxError_ = 2 * sqrt(tree->maxError_);
+
+		tree->nodes_.resize(exactTree.nodesNumber_);
+		tree->borders_.resize(2 * static_cast<size_t>(dimension) * exactTree.nodesNumber_);
+		for (int currentNode = 0; currentNode < exactTree.nodesNumber_; ++currentNode) {
+			tree->nodes_[currentNode].leftChild = exactTree.nodes_[currentNode].leftChild;
+			tree->nodes_[currentNode].rightChild = exactTree.nodes_[currentNode].rightChild;
+			tree->nodes_[currentNode].firstPoint = exactTree.nodes_[currentNode].firstPoint;
+			tree->nodes_[currentNode].lastPoint = exactTree.nodes_[currentNode].lastPoint;
+
+			for (int currentCoordinate = 0; currentCoordinate < dimension; ++currentCoordinate) {
+				tree->borders_[2 * static_cast<size_t>(dimension) * currentNode + currentCoordinate] =
+					storage.encode(exactTree.getLowerBorder(currentNode)[currentCoordinate], currentCoordinate);
+				tree->borders_[2 * static_cast<size_t>(dimension) * currentNode + dimension + currentCoordinate] =
+					storage.encode(exactTree.getUpperBorder(currentNode)[currentCoordinate], currentCoordinate);
+			}
+		}
+
+		tree->points_.resize(static_cast<size_t>(dimension) * exactTree.getPointsNumber());
+		for (int currentPointPosition = 0; currentPointPosition < exactTree.getPointsNumber(); ++currentPointPosition) {
+			for (int currentCoordinate = 0; currentCoordinate < dimension; ++currentCoordinate) {
+				tree->points_[static_cast<size_t>(dimension) * currentPointPosition + currentCoordinate] =
+					storage.encode(exactTree.getPoint(currentPointPosition)[currentCoordinate], currentCoordinate);
+			}
+		}
+
+		return tree;
+	}
+
+	int getDimension() const {
+		return (Dimension == DYNAMIC_DIMENSION ? dimension_ : Dimension);
+	}
+
+	int getPointsNumber() const {
+		return exactTree_->getPointsNumber();
+	}
+
+	//bytes of the reduced arrays kept in memory, the exact tree allocates nothing beside its mapping and is not counted
+	size_t getMemoryUsage() const {
+		return nodes_.size() * sizeof(CompactNode) + (borders_.size() + points_.size()) * sizeof(StoredScalar);
+	}
+
+	//the distance is exact, returns -1 when the tree is empty
+	int getMinDistanceIdentifier(const double* point, double &distance) const {
+		SearchBuffers buffers;
+		std::vector<Neighbour> neighbours;
+		return getMinDistanceIdentifier(point, distance, neighbours, buffers);
+	}
+
+	//same search in the arrays of the caller
+	int getMinDistanceIdentifier(const double* point, double &distance, std::vector<Neighbour> &neighbours, SearchBuffers &buffers) const {
+		getKNearest(point, 1, neighbours, buffers);
+
+		if (neighbours.empty()) {
+			distance = sqrt(std::numeric_limits<double>::max());
+			return -1;
+		}
+
+		distance = neighbours[0].distance;
+		return neighbours[0].identifier;
+	}
+
+	void getKNearest(const double* point, int k, std::vector<Neighbour> &neighbours) const {
+		SearchBuffers buffers;
+		getKNearest(point, k, neighbours, buffers);
+	}
+
+	//the candidates are collected in neighbours, so it keeps its capacity between searches as well
+	void getKNearest(const double* point, int k, std::vector<Neighbour> &neighbours, SearchBuffers &buffers) const {
+		neighbours.clear();
+		if ((k <= 0) || nodes_.empty()) {
+			return;
+		}
+
+		double queryError = prepareQuery(point, buffers.reducedPoint);
+
+		buffers.bounds.clear();
+		collectCandidates(&buffers.reducedPoint[0], queryError, k, buffers.bounds, neighbours);
+		checkCandidates(point, queryError, k, buffers.bounds, neighbours);
+
+		for (size_t currentNeighbour = 0; currentNeighbour < neighbours.size(); ++currentNeighbour) {
+			neighbours[currentNeighbour].distance = sqrt(neighbours[currentNeighbour].distance);
+		}
+	}
+};
+
+typedef BasicCompactKDTree<DYNAMIC_DIMENSION, FloatStorage> FloatKDTree;
+typedef BasicCompactKDTree<DYNAMIC_DIMENSION, Int16Storage> Int16KDTree;
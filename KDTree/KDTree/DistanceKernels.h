@@ -0,0 +1,1436 @@
+#pragma once
+#include <cstddef>
+#include <cmath>
+#include <cstdlib>
+#include <algorithm>
+#include <vector>
+#include <map>
+#include <mutex>
+#include <chrono>
+#include <limits>
+
+//squared distances from one point to a block of points, and the distances of the other metrics; the points
+//are stored either as rows of stride values or transposed in groups, the kernel for a dimension and layout
+//is chosen once at run time by timing the ones the processor and the system support on a sample of that dimension
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define KDTREE_X86_KERNELS
+#include <emmintrin.h>
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+#endif
+
+//compilers too old for the intrinsics leave the kernel out
+#if defined(KDTREE_X86_KERNELS) && (!defined(_MSC_VER) || (_MSC_VER >= 1800))
+#define KDTREE_AVX2_KERNEL
+#endif
+#if defined(KDTREE_X86_KERNELS) && (!defined(_MSC_VER) || (_MSC_VER >= 1910)) && (!defined(__GNUC__) || defined(__clang__) || (__GNUC__ >= 7))
+#define KDTREE_AVX512_KERNEL
+#endif
+
+//functions using wider instructions than the build targets are compiled for them alone
+#if defined(__GNUC__) || defined(__clang__)
+#define KDTREE_TARGET(instructions) __attribute__((target(instructions)))
+#else
+#define KDTREE_TARGET(instructions)
+#endif
+
+enum DistanceKernelLevel {
+	SCALAR_KERNEL,
+	SSE2_KERNEL,
+	AVX2_KERNEL,
+	AVX512_KERNEL
+};
+
+//a row kernel sums the coordinates of one point across the lanes of a register, which pays off for long rows only;
+//a transposed kernel takes the same coordinate of several points into a register and measures them at once
+enum DistanceKernelLayout {
+	ROW_KERNEL_LAYOUT,
+	TRANSPOSED_KERNEL_LAYOUT
+};
+
+//points of the transposed layout, group after group, a group keeps the first coordinate of its points,
+//then the second one and so on; a point of group g at lane l has its coordinate c at
+//g * KERNEL_GROUP_SIZE * dimension + c * KERNEL_GROUP_SIZE + l, the lanes of a partial last group are zero
+const int KERNEL_GROUP_SIZE = 8;
+
+//fills distances for pointsNumber rows and returns the position of the first smallest one
+typedef int (*BlockDistancesFunction)(const double* points, int pointsNumber, int stride, const double* point, int dimension, double* distances);
+//the same with the squared difference along every coordinate multiplied by its weight
+typedef int (*WeightedBlockDistancesFunction)(const double* points, int pointsNumber, int stride, const double* point, const double* weights, 
+	int dimension, double* distances);
+//fills the distances of every lane of the groups of the transposed layout holding pointsNumber points
+//and returns the position of the first smallest one among the points
+typedef int (*GroupDistancesFunction)(const double* groups, int pointsNumber, const double* point, int dimension, double* distances);
+typedef int (*WeightedGroupDistancesFunction)(const double* groups, int pointsNumber, const double* point, const double* weights, 
+	int dimension, double* distances);
+
+//the kernels of one level in both layouts, layout is the one points should be stored in for this kernel
+struct DistanceKernel {
+	DistanceKernelLevel level;
+	DistanceKernelLayout layout;
+	const char* name;
+	BlockDistancesFunction getBlockDistances;
+	BlockDistancesFunction getBlockManhattanDistances;
+	BlockDistancesFunction getBlockChebyshevDistances;
+	WeightedBlockDistancesFunction getBlockWeightedDistances;
+	GroupDistancesFunction getGroupDistances;
+	GroupDistancesFunction getGroupManhattanDistances;
+	GroupDistancesFunction getGroupChebyshevDistances;
+	WeightedGroupDistancesFunction getGroupWeightedDistances;
+};
+
+int getBlockDistancesScalar(const double* points, int pointsNumber, int stride, const double* point, int dimension, double* distances) {
+	int minPosition = 0;
+
+	for (int currentPoint = 0; currentPoint < pointsNumber; ++currentPoint) {
+		const double* currentRow = points + static_cast<size_t>(stride) * currentPoint;
+		double distance = 0;
+		for (int currentCoordinate = 0; currentCoordinate < dimension; ++currentCoordinate) {
+			double coordinatesDifference = currentRow[currentCoordinate] - point[currentCoordinate];
+			distance += coordinatesDifference * coordinatesDifference;
+		}
+
+		distances[currentPoint] = distance;
+		if (distance < distances[minPosition]) {
+			minPosition = currentPoint;
+		}
+	}
+
+	return minPosition;
+}
+
+int getBlockManhattanDistancesScalar(const double* points, int pointsNumber, int stride, const double* point, int dimension, double* distances) {
+	int minPosition = 0;
+
+	for (int currentPoint = 0; currentPoint < pointsNumber; ++currentPoint) {
+		const double* currentRow = points + static_cast<size_t>(stride) * currentPoint;
+		double distance = 0;
+		for (int currentCoordinate = 0; currentCoordinate < dimension; ++currentCoordinate) {
+			distance += fabs(currentRow[currentCoordinate] - point[currentCoordinate]);
+		}
+
+		distances[currentPoint] = distance;
+		if (distance < distances[minPosition]) {
+			minPosition = currentPoint;
+		}
+	}
+
+	return minPosition;
+}
+
+int getBlockChebyshevDistancesScalar(const double* points, int pointsNumber, int stride, const double* point, int dimension, double* distances) {
+	int minPosition = 0;
+
+	for (int currentPoint = 0; currentPoint < pointsNumber; ++currentPoint) {
+		const double* currentRow = points + static_cast<size_t>(stride) * currentPoint;
+		double distance = 0;
+		for (int currentCoordinate = 0; currentCoordinate < dimension; ++currentCoordinate) {
+			distance = std::max(distance, fabs(currentRow[currentCoordinate] - point[currentCoordinate]));
+		}
+
+		distances[currentPoint] = distance;
+		if (distance < distances[minPosition]) {
+			minPosition = currentPoint;
+		}
+	}
+
+	return minPosition;
+}
+
+int getBlockWeightedDistancesScalar(const double* points, int pointsNumber, int stride, const double* point, const double* weights, 
+	int dimension, double* distances) {
+
+	int minPosition = 0;
+
+	for (int currentPoint = 0; currentPoint < pointsNumber; ++currentPoint) {
+		const double* currentRow = points + static_cast<size_t>(stride) * currentPoint;
+		double distance = 0;
+		for (int currentCoordinate = 0; currentCoordinate < dimension; ++currentCoordinate) {
+			double coordinatesDifference = currentRow[currentCoordinate] - point[currentCoordinate];
+			distance += weights[currentCoordinate] * coordinatesDifference * coordinatesDifference;
+		}
+
+		distances[currentPoint] = distance;
+		if (distance < distances[minPosition]) {
+			minPosition = currentPoint;
+		}
+	}
+
+	return minPosition;
+}
+
+//groups of the transposed layout taken by pointsNumber points
+int getGroupsNumber(int pointsNumber) {
+	return (pointsNumber + KERNEL_GROUP_SIZE - 1) / KERNEL_GROUP_SIZE;
+}
+
+//the position of the first smallest of the distances of pointsNumber points
+template <typename Scalar>
+int getFirstMinPosition(const Scalar* distances, int pointsNumber) {
+	int minPosition = 0;
+
+	for (int currentPoint = 1; currentPoint < pointsNumber; ++currentPoint) {
+		if (distances[currentPoint] < distances[minPosition]) {
+			minPosition = currentPoint;
+		}
+	}
+
+	return minPosition;
+}
+
+//the transposed loops keep the order of the additions of the row loops, so both give the same distances;
+//they are templates since they also serve the scalar types without vector kernels
+template <typename Scalar>
+int getGroupDistancesScalar(const Scalar* groups, int pointsNumber, const Scalar* point, int dimension, Scalar* distances) {
+	const int groupsNumber = getGroupsNumber(pointsNumber);
+
+	for (int currentGroup = 0; currentGroup < groupsNumber; ++currentGroup) {
+		const Scalar* group = groups + static_cast<size_t>(KERNEL_GROUP_SIZE) * dimension * currentGroup;
+		Scalar* groupDistances = distances + KERNEL_GROUP_SIZE * currentGroup;
+		std::fill(groupDistances, groupDistances + KERNEL_GROUP_SIZE, Scalar(0));
+
+		for (int currentCoordinate = 0; currentCoordinate < dimension; ++currentCoordinate) {
+			const Scalar* coordinates = group + KERNEL_GROUP_SIZE * currentCoordinate;
+			for (int currentLane = 0; currentLane < KERNEL_GROUP_SIZE; ++currentLane) {
+				Scalar coordinatesDifference = coordinates[currentLane] - point[currentCoordinate];
+				groupDistances[currentLane] += coordinatesDifference * coordinatesDifference;
+			}
+		}
+	}
+
+	return getFirstMinPosition(distances, pointsNumber);
+}
+
+template <typename Scalar>
+int getGroupManhattanDistancesScalar(const Scalar* groups, int pointsNumber, const Scalar* point, int dimension, Scalar* distances) {
+	const int groupsNumber = getGroupsNumber(pointsNumber);
+
+	for (int currentGroup = 0; currentGroup < groupsNumber; ++currentGroup) {
+		const Scalar* group = groups + static_cast<size_t>(KERNEL_GROUP_SIZE) * dimension * currentGroup;
+		Scalar* groupDistances = distances + KERNEL_GROUP_SIZE * currentGroup;
+		std::fill(groupDistances, groupDistances + KERNEL_GROUP_SIZE, Scalar(0));
+
+		for (int currentCoordinate = 0; currentCoordinate < dimension; ++currentCoordinate) {
+			const Scalar* coordinates = group + KERNEL_GROUP_SIZE * currentCoordinate;
+			for (int currentLane = 0; currentLane < KERNEL_GROUP_SIZE; ++currentLane) {
+				groupDistances[currentLane] += std::abs(coordinates[currentLane] - point[currentCoordinate]);
+			}
+		}
+	}
+
+	return getFirstMinPosition(distances, pointsNumber);
+}
+
+template <typename Scalar>
+int getGroupChebyshevDistancesScalar(const Scalar* groups, int pointsNumber, const Scalar* point, int dimension, Scalar* distances) {
+	const int groupsNumber = getGroupsNumber(pointsNumber);
+
+	for (int currentGroup = 0; currentGroup < groupsNumber; ++currentGroup) {
+		const Scalar* group = groups + static_cast<size_t>(KERNEL_GROUP_SIZE) * dimension * currentGroup;
+		Scalar* groupDistances = distances + KERNEL_GROUP_SIZE * currentGroup;
+		std::fill(groupDistances, groupDistances + KERNEL_GROUP_SIZE, Scalar(0));
+
+		for (int currentCoordinate = 0; currentCoordinate < dimension; ++currentCoordinate) {
+			const Scalar* coordinates = group + KERNEL_GROUP_SIZE * currentCoordinate;
+			for (int currentLane = 0; currentLane < KERNEL_GROUP_SIZE; ++currentLane) {
+				groupDistances[currentLane] = std::max(groupDistances[currentLane], 
+					static_cast<Scalar>(std::abs(coordinates[currentLane] - point[currentCoordinate])));
+			}
+		}
+	}
+
+	return getFirstMinPosition(distances, pointsNumber);
+}
+
+template <typename Scalar>
+int getGroupWeightedDistancesScalar(const Scalar* groups, int pointsNumber, const Scalar* point, const double* weights, 
+	int dimension, Scalar* distances) {
+
+	const int groupsNumber = getGroupsNumber(pointsNumber);
+
+	for (int currentGroup = 0; currentGroup < groupsNumber; ++currentGroup) {
+		const Scalar* group = groups + static_cast<size_t>(KERNEL_GROUP_SIZE) * dimension * currentGroup;
+		Scalar* groupDistances = distances + KERNEL_GROUP_SIZE * currentGroup;
+		std::fill(groupDistances, groupDistances + KERNEL_GROUP_SIZE, Scalar(0));
+
+		for (int currentCoordinate = 0; currentCoordinate < dimension; ++currentCoordinate) {
+			const Scalar* coordinates = group + KERNEL_GROUP_SIZE * currentCoordinate;
+			Scalar weight = static_cast<Scalar>(weights[currentCoordinate]);
+			for (int currentLane = 0; currentLane < KERNEL_GROUP_SIZE; ++currentLane) {
+				Scalar coordinatesDifference = coordinates[currentLane] - point[currentCoordinate];
+				groupDistances[currentLane] += weight * coordinatesDifference * coordinatesDifference;
+			}
+		}
+	}
+
+	return getFirstMinPosition(distances, pointsNumber);
+}
+
+#ifdef KDTREE_X86_KERNELS
+
+//an odd last coordinate is loaded alone, so neither the rows nor the point need padding
+int getBlockDistancesSse2(const double* points, int pointsNumber, int stride, const double* point, int dimension, double* distances) {
+	const int fullDimension = dimension & ~1;
+	int minPosition = 0;
+
+	for (int currentPoint = 0; currentPoint < pointsNumber; ++currentPoint) {
+		const double* currentRow = points + static_cast<size_t>(stride) * currentPoint;
+		__m128d sum = _mm_setzero_pd();
+
+		for (int currentCoordinate = 0; currentCoordinate < fullDimension; currentCoordinate += 2) {
+			__m128d coordinatesDifference = _mm_sub_pd(_mm_loadu_pd(currentRow + currentCoordinate), _mm_loadu_pd(point + currentCoordinate));
+			sum = _mm_add_pd(sum, _mm_mul_pd(coordinatesDifference, coordinatesDifference));
+		}
+		if (fullDimension < dimension) {
+			__m128d coordinatesDifference = _mm_sub_pd(_mm_load_sd(currentRow + fullDimension), _mm_load_sd(point + fullDimension));
+			sum = _mm_add_pd(sum, _mm_mul_pd(coordinatesDifference, coordinatesDifference));
+		}
+
+		double distance = _mm_cvtsd_f64(_mm_add_sd(sum, _mm_unpackhi_pd(sum, sum)));
+		distances[currentPoint] = distance;
+		if (distance < distances[minPosition]) {
+			minPosition = currentPoint;
+		}
+	}
+
+	return minPosition;
+}
+
+//the absolute value clears the sign bit, the zero the odd last coordinate is loaded with adds nothing
+int getBlockManhattanDistancesSse2(const double* points, int pointsNumber, int stride, const double* point, int dimension, double* distances) {
+	const int fullDimension = dimension & ~1;
+	const __m128d signMask = _mm_set1_pd(-0.0);
+	int minPosition = 0;
+
+	for (int currentPoint = 0; currentPoint < pointsNumber; ++currentPoint) {
+		const double* currentRow = points + static_cast<size_t>(stride) * currentPoint;
+		__m128d sum = _mm_setzero_pd();
+
+		for (int currentCoordinate = 0; currentCoordinate < fullDimension; currentCoordinate += 2) {
+			__m128d coordinatesDifference = _mm_sub_pd(_mm_loadu_pd(currentRow + currentCoordinate), _mm_loadu_pd(point + currentCoordinate));
+			sum = _mm_add_pd(sum, _mm_andnot_pd(signMask, coordinatesDifference));
+		}
+		if (fullDimension < dimension) {
+			__m128d coordinatesDifference = _mm_sub_pd(_mm_load_sd(currentRow + fullDimension), _mm_load_sd(point + fullDimension));
+			sum = _mm_add_pd(sum, _mm_andnot_pd(signMask, coordinatesDifference));
+		}
+
+		double distance = _mm_cvtsd_f64(_mm_add_sd(sum, _mm_unpackhi_pd(sum, sum)));
+		distances[currentPoint] = distance;
+		if (distance < distances[minPosition]) {
+			minPosition = currentPoint;
+		}
+	}
+
+	return minPosition;
+}
+
+int getBlockChebyshevDistancesSse2(const double* points, int pointsNumber, int stride, const double* point, int dimension, double* distances) {
+	const int fullDimension = dimension & ~1;
+	const __m128d signMask = _mm_set1_pd(-0.0);
+	int minPosition = 0;
+
+	for (int currentPoint = 0; currentPoint < pointsNumber; ++currentPoint) {
+		const double* currentRow = points + static_cast<size_t>(stride) * currentPoint;
+		__m128d maxDifference = _mm_setzero_pd();
+
+		for (int currentCoordinate = 0; currentCoordinate < fullDimension; currentCoordinate += 2) {
+			__m128d coordinatesDifference = _mm_sub_pd(_mm_loadu_pd(currentRow + currentCoordinate), _mm_loadu_pd(point + currentCoordinate));
+			maxDifference = _mm_max_pd(maxDifference, _mm_andnot_pd(signMask, coordinatesDifference));
+		}
+		if (fullDimension < dimension) {
+			__m128d coordinatesDifference = _mm_sub_pd(_mm_load_sd(currentRow + fullDimension), _mm_load_sd(point + fullDimension));
+			maxDifference = _mm_max_pd(maxDifference, _mm_andnot_pd(signMask, coordinatesDifference));
+		}
+
+		double distance = _mm_cvtsd_f64(_mm_max_sd(maxDifference, _mm_unpackhi_pd(maxDifference, maxDifference)));
+		distances[currentPoint] = distance;
+		if (distance < distances[minPosition]) {
+			minPosition = currentPoint;
+		}
+	}
+
+	return minPosition;
+}
+
+int getBlockWeightedDistancesSse2(const double* points, int pointsNumber, int stride, const double* point, const double* weights, 
+	int dimension, double* distances) {
+
+	const int fullDimension = dimension & ~1;
+	int minPosition = 0;
+
+	for (int currentPoint = 0; currentPoint < pointsNumber; ++currentPoint) {
+		const double* currentRow = points + static_cast<size_t>(stride) * currentPoint;
+		__m128d sum = _mm_setzero_pd();
+
+		for (int currentCoordinate = 0; currentCoordinate < fullDimension; currentCoordinate += 2) {
+			__m128d coordinatesDifference = _mm_sub_pd(_mm_loadu_pd(currentRow + currentCoordinate), _mm_loadu_pd(point + currentCoordinate));
+			sum = _mm_add_pd(sum, _mm_mul_pd(_mm_loadu_pd(weights + currentCoordinate), _mm_mul_pd(coordinatesDifference, coordinatesDifference)));
+		}
+		if (fullDimension < dimension) {
+			__m128d coordinatesDifference = _mm_sub_pd(_mm_load_sd(currentRow + fullDimension), _mm_load_sd(point + fullDimension));
+			sum = _mm_add_pd(sum, _mm_mul_pd(_mm_load_sd(weights + fullDimension), _mm_mul_pd(coordinatesDifference, coordinatesDifference)));
+		}
+
+		double distance = _mm_cvtsd_f64(_mm_add_sd(sum, _mm_unpackhi_pd(sum, sum)));
+		distances[currentPoint] = distance;
+		if (distance < distances[minPosition]) {
+			minPosition = currentPoint;
+		}
+	}
+
+	return minPosition;
+}
+
+//the lanes keep their smallest distance and the position it was first seen at, the smallest of the lanes
+//is then found without branches: a branch on every distance of a group is mispredicted half of the time
+int getFirstMinPositionSse2(const double* distances, int pointsNumber) {
+	const __m128d limit = _mm_set1_pd(pointsNumber);
+	const __m128d step = _mm_set1_pd(2);
+	__m128d positions = _mm_set_pd(1, 0);
+	__m128d minDistances = _mm_set1_pd(std::numeric_limits<double>::max());
+	__m128d minPositions = _mm_setzero_pd();
+
+	for (int currentPoint = 0; currentPoint < pointsNumber; currentPoint += 2) {
+		__m128d currentDistances = _mm_loadu_pd(distances + currentPoint);
+		__m128d smaller = _mm_and_pd(_mm_cmplt_pd(positions, limit), _mm_cmplt_pd(currentDistances, minDistances));
+		minDistances = _mm_or_pd(_mm_and_pd(smaller, currentDistances), _mm_andnot_pd(smaller, minDistances));
+		minPositions = _mm_or_pd(_mm_and_pd(smaller, positions), _mm_andnot_pd(smaller, minPositions));
+		positions = _mm_add_pd(positions, step);
+	}
+
+	__m128d minDistance = _mm_min_pd(minDistances, _mm_unpackhi_pd(minDistances, minDistances));
+	__m128d smallest = _mm_cmpeq_pd(minDistances, _mm_unpacklo_pd(minDistance, minDistance));
+	minPositions = _mm_or_pd(_mm_and_pd(smallest, minPositions), _mm_andnot_pd(smallest, limit));
+	return static_cast<int>(_mm_cvtsd_f64(_mm_min_sd(minPositions, _mm_unpackhi_pd(minPositions, minPositions))));
+}
+
+//a group is measured in four registers of two lanes against the coordinate of the point broadcast to both lanes,
+//no lanes are summed, so the distances come out in the order of the additions of the scalar loop
+int getGroupDistancesSse2(const double* groups, int pointsNumber, const double* point, int dimension, double* distances) {
+	const int groupsNumber = getGroupsNumber(pointsNumber);
+	const int REGISTERS_NUMBER = KERNEL_GROUP_SIZE / 2;
+
+	for (int currentGroup = 0; currentGroup < groupsNumber; ++currentGroup) {
+		const double* group = groups + static_cast<size_t>(KERNEL_GROUP_SIZE) * dimension * currentGroup;
+		__m128d sums[REGISTERS_NUMBER];
+		for (int currentRegister = 0; currentRegister < REGISTERS_NUMBER; ++currentRegister) {
+			sums[currentRegister] = _mm_setzero_pd();
+		}
+
+		for (int currentCoordinate = 0; currentCoordinate < dimension; ++currentCoordinate) {
+			const double* coordinates = group + KERNEL_GROUP_SIZE * currentCoordinate;
+			const __m128d pointCoordinate = _mm_set1_pd(point[currentCoordinate]);
+			for (int currentRegister = 0; currentRegister < REGISTERS_NUMBER; ++currentRegister) {
+				__m128d coordinatesDifference = _mm_sub_pd(_mm_loadu_pd(coordinates + 2 * currentRegister), pointCoordinate);
+				sums[currentRegister] = _mm_add_pd(sums[currentRegister], _mm_mul_pd(coordinatesDifference, coordinatesDifference));
+			}
+		}
+
+		for (int currentRegister = 0; currentRegister < REGISTERS_NUMBER; ++currentRegister) {
+			_mm_storeu_pd(distances + KERNEL_GROUP_SIZE * currentGroup + 2 * currentRegister, sums[currentRegister]);
+		}
+	}
+
+	return getFirstMinPositionSse2(distances, pointsNumber);
+}
+
+int getGroupManhattanDistancesSse2(const double* groups, int pointsNumber, const double* point, int dimension, double* distances) {
+	const int groupsNumber = getGroupsNumber(pointsNumber);
+	const int REGISTERS_NUMBER = KERNEL_GROUP_SIZE / 2;
+	const __m128d signMask = _mm_set1_pd(-0.0);
+
+	for (int currentGroup = 0; currentGroup < groupsNumber; ++currentGroup) {
+		const double* group = groups + static_cast<size_t>(KERNEL_GROUP_SIZE) * dimension * currentGroup;
+		__m128d sums[REGISTERS_NUMBER];
+		for (int currentRegister = 0; currentRegister < REGISTERS_NUMBER; ++currentRegister) {
+			sums[currentRegister] = _mm_setzero_pd();
+		}
+
+		for (int currentCoordinate = 0; currentCoordinate < dimension; ++currentCoordinate) {
+			const double* coordinates = group + KERNEL_GROUP_SIZE * currentCoordinate;
+			const __m128d pointCoordinate = _mm_set1_pd(point[currentCoordinate]);
+			for (int currentRegister = 0; currentRegister < REGISTERS_NUMBER; ++currentRegister) {
+				__m128d coordinatesDifference = _mm_sub_pd(_mm_loadu_pd(coordinates + 2 * currentRegister), pointCoordinate);
+				sums[currentRegister] = _mm_add_pd(sums[currentRegister], _mm_andnot_pd(signMask, coordinatesDifference));
+			}
+		}
+
+		for (int currentRegister = 0; currentRegister < REGISTERS_NUMBER; ++currentRegister) {
+			_mm_storeu_pd(distances + KERNEL_GROUP_SIZE * currentGroup + 2 * currentRegister, sums[currentRegister]);
+		}
+	}
+
+	return getFirstMinPositionSse2(distances, pointsNumber);
+}
+
+int getGroupChebyshevDistancesSse2(const double* groups, int pointsNumber, const double* point, int dimension, double* distances) {
+	const int groupsNumber = getGroupsNumber(pointsNumber);
+	const int REGISTERS_NUMBER = KERNEL_GROUP_SIZE / 2;
+	const __m128d signMask = _mm_set1_pd(-0.0);
+
+	for (int currentGroup = 0; currentGroup < groupsNumber; ++currentGroup) {
+		const double* group = groups + static_cast<size_t>(KERNEL_GROUP_SIZE) * dimension * currentGroup;
+		__m128d maxDifferences[REGISTERS_NUMBER];
+		for (int currentRegister = 0; currentRegister < REGISTERS_NUMBER; ++currentRegister) {
+			maxDifferences[currentRegister] = _mm_setzero_pd();
+		}
+
+		for (int currentCoordinate = 0; currentCoordinate < dimension; ++currentCoordinate) {
+			const double* coordinates = group + KERNEL_GROUP_SIZE * currentCoordinate;
+			const __m128d pointCoordinate = _mm_set1_pd(point[currentCoordinate]);
+			for (int currentRegister = 0; currentRegister < REGISTERS_NUMBER; ++currentRegister) {
+				__m128d coordinatesDifference = _mm_sub_pd(_mm_loadu_pd(coordinates + 2 * currentRegister), pointCoordinate);
+				maxDifferences[currentRegister] = _mm_max_pd(maxDifferences[currentRegister], _mm_andnot_pd(signMask, coordinatesDifference));
+			}
+		}
+
+		for (int currentRegister = 0; currentRegister < REGISTERS_NUMBER; ++currentRegister) {
+			_mm_storeu_pd(distances + KERNEL_GROUP_SIZE * currentGroup + 2 * currentRegister, maxDifferences[currentRegister]);
+		}
+	}
+
+	return getFirstMinPositionSse2(distances, pointsNumber);
+}
+
+int getGroupWeightedDistancesSse2(const double* groups, int pointsNumber, const double* point, const double* weights, 
+	int dimension, double* distances) {
+
+	const int groupsNumber = getGroupsNumber(pointsNumber);
+	const int REGISTERS_NUMBER = KERNEL_GROUP_SIZE / 2;
+
+	for (int currentGroup = 0; currentGroup < groupsNumber; ++currentGroup) {
+		const double* group = groups + static_cast<size_t>(KERNEL_GROUP_SIZE) * dimension * currentGroup;
+		__m128d sums[REGISTERS_NUMBER];
+		for (int currentRegister = 0; currentRegister < REGISTERS_NUMBER; ++currentRegister) {
+			sums[currentRegister] = _mm_setzero_pd();
+		}
+
+		for (int currentCoordinate = 0; currentCoordinate < dimension; ++currentCoordinate) {
+			const double* coordinates = group + KERNEL_GROUP_SIZE * currentCoordinate;
+			const __m128d pointCoordinate = _mm_set1_pd(point[currentCoordinate]);
+			const __m128d weight = _mm_set1_pd(weights[currentCoordinate]);
+			for (int currentRegister = 0; currentRegister < REGISTERS_NUMBER; ++currentRegister) {
+				__m128d coordinatesDifference = _mm_sub_pd(_mm_loadu_pd(coordinates + 2 * currentRegister), pointCoordinate);
+				sums[currentRegister] = _mm_add_pd(sums[currentRegister], _mm_mul_pd(weight, _mm_mul_pd(coordinatesDifference, coordinatesDifference)));
+			}
+		}
+
+		for (int currentRegister = 0; currentRegister < REGISTERS_NUMBER; ++currentRegister) {
+			_mm_storeu_pd(distances + KERNEL_GROUP_SIZE * currentGroup + 2 * currentRegister, sums[currentRegister]);
+		}
+	}
+
+	return getFirstMinPositionSse2(distances, pointsNumber);
+}
+
+#endif
+
+#ifdef KDTREE_AVX2_KERNEL
+
+//the last coordinates are read with a masked load, which never touches memory past the mask
+KDTREE_TARGET("avx2")
+int getBlockDistancesAvx2(const double* points, int pointsNumber, int stride, const double* point, int dimension, double* distances) {
+	const int fullDimension = dimension & ~3;
+	const int tailSize = dimension - fullDimension;
+	const __m256i tailMask = _mm256_set_epi64x(tailSize > 3 ? -1 : 0, tailSize > 2 ? -1 : 0, tailSize > 1 ? -1 : 0, tailSize > 0 ? -1 : 0);
+	const __m256d pointTail = _mm256_maskload_pd(point + fullDimension, tailMask);
+	int minPosition = 0;
+
+	for (int currentPoint = 0; currentPoint < pointsNumber; ++currentPoint) {
+		const double* currentRow = points + static_cast<size_t>(stride) * currentPoint;
+		__m256d sum = _mm256_setzero_pd();
+
+		for (int currentCoordinate = 0; currentCoordinate < fullDimension; currentCoordinate += 4) {
+			__m256d coordinatesDifference = _mm256_sub_pd(_mm256_loadu_pd(currentRow + currentCoordinate), _mm256_loadu_pd(point + currentCoordinate));
+			sum = _mm256_add_pd(sum, _mm256_mul_pd(coordinatesDifference, coordinatesDifference));
+		}
+		if (tailSize > 0) {
+			__m256d coordinatesDifference = _mm256_sub_pd(_mm256_maskload_pd(currentRow + fullDimension, tailMask), pointTail);
+			sum = _mm256_add_pd(sum, _mm256_mul_pd(coordinatesDifference, coordinatesDifference));
+		}
+
+		__m128d halfSum = _mm_add_pd(_mm256_castpd256_pd128(sum), _mm256_extractf128_pd(sum, 1));
+		double distance = _mm_cvtsd_f64(_mm_add_sd(halfSum, _mm_unpackhi_pd(halfSum, halfSum)));
+		distances[currentPoint] = distance;
+		if (distance < distances[minPosition]) {
+			minPosition = currentPoint;
+		}
+	}
+
+	return minPosition;
+}
+
+KDTREE_TARGET("avx2")
+int getBlockManhattanDistancesAvx2(const double* points, int pointsNumber, int stride, const double* point, int dimension, double* distances) {
+	const int fullDimension = dimension & ~3;
+	const int tailSize = dimension - fullDimension;
+	const __m256i tailMask = _mm256_set_epi64x(tailSize > 3 ? -1 : 0, tailSize > 2 ? -1 : 0, tailSize > 1 ? -1 : 0, tailSize > 0 ? -1 : 0);
+	const __m256d pointTail = _mm256_maskload_pd(point + fullDimension, tailMask);
+	const __m256d signMask = _mm256_set1_pd(-0.0);
+	int minPosition = 0;
+
+	for (int currentPoint = 0; currentPoint < pointsNumber; ++currentPoint) {
+		const double* currentRow = points + static_cast<size_t>(stride) * currentPoint;
+		__m256d sum = _mm256_setzero_pd();
+
+		for (int currentCoordinate = 0; currentCoordinate < fullDimension; currentCoordinate += 4) {
+			__m256d coordinatesDifference = _mm256_sub_pd(_mm256_loadu_pd(currentRow + currentCoordinate), _mm256_loadu_pd(point + currentCoordinate));
+			sum = _mm256_add_pd(sum, _mm256_andnot_pd(signMask, coordinatesDifference));
+		}
+		if (tailSize > 0) {
+			__m256d coordinatesDifference = _mm256_sub_pd(_mm256_maskload_pd(currentRow + fullDimension, tailMask), pointTail);
+			sum = _mm256_add_pd(sum, _mm256_andnot_pd(signMask, coordinatesDifference));
+		}
+
+		__m128d halfSum = _mm_add_pd(_mm256_castpd256_pd128(sum), _mm256_extractf128_pd(sum, 1));
+		double distance = _mm_cvtsd_f64(_mm_add_sd(halfSum, _mm_unpackhi_pd(halfSum, halfSum)));
+		distances[currentPoint] = distance;
+		if (distance < distances[minPosition]) {
+			minPosition = currentPoint;
+		}
+	}
+
+	return minPosition;
+}
+
+KDTREE_TARGET("avx2")
+int getBlockChebyshevDistancesAvx2(const double* points, int pointsNumber, int stride, const double* point, int dimension, double* distances) {
+	const int fullDimension = dimension & ~3;
+	const int tailSize = dimension - fullDimension;
+	const __m256i tailMask = _mm256_set_epi64x(tailSize > 3 ? -1 : 0, tailSize > 2 ? -1 : 0, tailSize > 1 ? -1 : 0, tailSize > 0 ? -1 : 0);
+	const __m256d pointTail = _mm256_maskload_pd(point + fullDimension, tailMask);
+	const __m256d signMask = _mm256_set1_pd(-0.0);
+	int minPosition = 0;
+
+	for (int currentPoint = 0; currentPoint < pointsNumber; ++currentPoint) {
+		const double* currentRow = points + static_cast<size_t>(stride) * currentPoint;
+		__m256d maxDifference = _mm256_setzero_pd();
+
+		for (int currentCoordinate = 0; currentCoordinate < fullDimension; currentCoordinate += 4) {
+			__m256d coordinatesDifference = _mm256_sub_pd(_mm256_loadu_pd(currentRow + currentCoordinate), _mm256_loadu_pd(point + currentCoordinate));
+			maxDifference = _mm256_max_pd(maxDifference, _mm256_andnot_pd(signMask, coordinatesDifference));
+		}
+		if (tailSize > 0) {
+			__m256d coordinatesDifference = _mm256_sub_pd(_mm256_maskload_pd(currentRow + fullDimension, tailMask), pointTail);
+			maxDifference = _mm256_max_pd(maxDifference, _mm256_andnot_pd(signMask, coordinatesDifference));
+		}
+
+		__m128d halfMax = _mm_max_pd(_mm256_castpd256_pd128(maxDifference), _mm256_extractf128_pd(maxDifference, 1));
+		double distance = _mm_cvtsd_f64(_mm_max_sd(halfMax, _mm_unpackhi_pd(halfMax, halfMax)));
+		distances[currentPoint] = distance;
+		if (distance < distances[minPosition]) {
+			minPosition = currentPoint;
+		}
+	}
+
+	return minPosition;
+}
+
+KDTREE_TARGET("avx2")
+int getBlockWeightedDistancesAvx2(const double* points, int pointsNumber, int stride, const double* point, const double* weights, 
+	int dimension, double* distances) {
+
+	const int fullDimension = dimension & ~3;
+	const int tailSize = dimension - fullDimension;
+	const __m256i tailMask = _mm256_set_epi64x(tailSize > 3 ? -1 : 0, tailSize > 2 ? -1 : 0, tailSize > 1 ? -1 : 0, tailSize > 0 ? -1 : 0);
+	const __m256d pointTail = _mm256_maskload_pd(point + fullDimension, tailMask);
+	const __m256d weightsTail = _mm256_maskload_pd(weights + fullDimension, tailMask);
+	int minPosition = 0;
+
+	for (int currentPoint = 0; currentPoint < pointsNumber; ++currentPoint) {
+		const double* currentRow = points + static_cast<size_t>(stride) * currentPoint;
+		__m256d sum = _mm256_setzero_pd();
+
+		for (int currentCoordinate = 0; currentCoordinate < fullDimension; currentCoordinate += 4) {
+			__m256d coordinatesDifference = _mm256_sub_pd(_mm256_loadu_pd(currentRow + currentCoordinate), _mm256_loadu_pd(point + currentCoordinate));
+			sum = _mm256_add_pd(sum, _mm256_mul_pd(_mm256_loadu_pd(weights + currentCoordinate), _mm256_mul_pd(coordinatesDifference, coordinatesDifference)));
+		}
+		if (tailSize > 0) {
+			__m256d coordinatesDifference = _mm256_sub_pd(_mm256_maskload_pd(currentRow + fullDimension, tailMask), pointTail);
+			sum = _mm256_add_pd(sum, _mm256_mul_pd(weightsTail, _mm256_mul_pd(coordinatesDifference, coordinatesDifference)));
+		}
+
+		__m128d halfSum = _mm_add_pd(_mm256_castpd256_pd128(sum), _mm256_extractf128_pd(sum, 1));
+		double distance = _mm_cvtsd_f64(_mm_add_sd(halfSum, _mm_unpackhi_pd(halfSum, halfSum)));
+		distances[currentPoint] = distance;
+		if (distance < distances[minPosition]) {
+			minPosition = currentPoint;
+		}
+	}
+
+	return minPosition;
+}
+
+KDTREE_TARGET("avx2")
+int getFirstMinPositionAvx2(const double* distances, int pointsNumber) {
+	const __m256d limit = _mm256_set1_pd(pointsNumber);
+	const __m256d step = _mm256_set1_pd(4);
+	__m256d positions = _mm256_set_pd(3, 2, 1, 0);
+	__m256d minDistances = _mm256_set1_pd(std::numeric_limits<double>::max());
+	__m256d minPositions = _mm256_setzero_pd();
+
+	for (int currentPoint = 0; currentPoint < pointsNumber; currentPoint += 4) {
+		__m256d currentDistances = _mm256_loadu_pd(distances + currentPoint);
+		__m256d smaller = _mm256_and_pd(_mm256_cmp_pd(positions, limit, _CMP_LT_OQ), _mm256_cmp_pd(currentDistances, minDistances, _CMP_LT_OQ));
+		minDistances = _mm256_blendv_pd(minDistances, currentDistances, smaller);
+		minPositions = _mm256_blendv_pd(minPositions, positions, smaller);
+		positions = _mm256_add_pd(positions, step);
+	}
+
+	__m256d minDistance = _mm256_min_pd(minDistances, _mm256_permute2f128_pd(minDistances, minDistances, 1));
+	minDistance = _mm256_min_pd(minDistance, _mm256_permute_pd(minDistance, 5));
+	minPositions = _mm256_blendv_pd(limit, minPositions, _mm256_cmp_pd(minDistances, minDistance, _CMP_EQ_OQ));
+	minPositions = _mm256_min_pd(minPositions, _mm256_permute2f128_pd(minPositions, minPositions, 1));
+	minPositions = _mm256_min_pd(minPositions, _mm256_permute_pd(minPositions, 5));
+	return static_cast<int>(_mm_cvtsd_f64(_mm256_castpd256_pd128(minPositions)));
+}
+
+//two registers of four lanes a group
+KDTREE_TARGET("avx2")
+int getGroupDistancesAvx2(const double* groups, int pointsNumber, const double* point, int dimension, double* distances) {
+	const int groupsNumber = getGroupsNumber(pointsNumber);
+	const int REGISTERS_NUMBER = KERNEL_GROUP_SIZE / 4;
+
+	for (int currentGroup = 0; currentGroup < groupsNumber; ++currentGroup) {
+		const double* group = groups + static_cast<size_t>(KERNEL_GROUP_SIZE) * dimension * currentGroup;
+		__m256d sums[REGISTERS_NUMBER];
+		for (int currentRegister = 0; currentRegister < REGISTERS_NUMBER; ++currentRegister) {
+			sums[currentRegister] = _mm256_setzero_pd();
+		}
+
+		for (int currentCoordinate = 0; currentCoordinate < dimension; ++currentCoordinate) {
+			const double* coordinates = group + KERNEL_GROUP_SIZE * currentCoordinate;
+			const __m256d pointCoordinate = _mm256_set1_pd(point[currentCoordinate]);
+			for (int currentRegister = 0; currentRegister < REGISTERS_NUMBER; ++currentRegister) {
+				__m256d coordinatesDifference = _mm256_sub_pd(_mm256_loadu_pd(coordinates + 4 * currentRegister), pointCoordinate);
+				sums[currentRegister] = _mm256_add_pd(sums[currentRegister], _mm256_mul_pd(coordinatesDifference, coordinatesDifference));
+			}
+		}
+
+		for (int currentRegister = 0; currentRegister < REGISTERS_NUMBER; ++currentRegister) {
+			_mm256_storeu_pd(distances + KERNEL_GROUP_SIZE * currentGroup + 4 * currentRegister, sums[currentRegister]);
+		}
+	}
+
+	return getFirstMinPositionAvx2(distances, pointsNumber);
+}
+
+KDTREE_TARGET("avx2")
+int getGroupManhattanDistancesAvx2(const double* groups, int pointsNumber, const double* point, int dimension, double* distances) {
+	const int groupsNumber = getGroupsNumber(pointsNumber);
+	const int REGISTERS_NUMBER = KERNEL_GROUP_SIZE / 4;
+	const __m256d signMask = _mm256_set1_pd(-0.0);
+
+	for (int currentGroup = 0; currentGroup < groupsNumber; ++currentGroup) {
+		const double* group = groups + static_cast<size_t>(KERNEL_GROUP_SIZE) * dimension * currentGroup;
+		__m256d sums[REGISTERS_NUMBER];
+		for (int currentRegister = 0; currentRegister < REGISTERS_NUMBER; ++currentRegister) {
+			sums[currentRegister] = _mm256_setzero_pd();
+		}
+
+		for (int currentCoordinate = 0; currentCoordinate < dimension; ++currentCoordinate) {
+			const double* coordinates = group + KERNEL_GROUP_SIZE * currentCoordinate;
+			const __m256d pointCoordinate = _mm256_set1_pd(point[currentCoordinate]);
+			for (int currentRegister = 0; currentRegister < REGISTERS_NUMBER; ++currentRegister) {
+				__m256d coordinatesDifference = _mm256_sub_pd(_mm256_loadu_pd(coordinates + 4 * currentRegister), pointCoordinate);
+				sums[currentRegister] = _mm256_add_pd(sums[currentRegister], _mm256_andnot_pd(signMask, coordinatesDifference));
+			}
+		}
+
+		for (int currentRegister = 0; currentRegister < REGISTERS_NUMBER; ++currentRegister) {
+			_mm256_storeu_pd(distances + KERNEL_GROUP_SIZE * currentGroup + 4 * currentRegister, sums[currentRegister]);
+		}
+	}
+
+	return getFirstMinPositionAvx2(distances, pointsNumber);
+}
+
+KDTREE_TARGET("avx2")
+int getGroupChebyshevDistancesAvx2(const double* groups, int pointsNumber, const double* point, int dimension, double* distances) {
+	const int groupsNumber = getGroupsNumber(pointsNumber);
+	const int REGISTERS_NUMBER = KERNEL_GROUP_SIZE / 4;
+	const __m256d signMask = _mm256_set1_pd(-0.0);
+
+	for (int currentGroup = 0; currentGroup < groupsNumber; ++currentGroup) {
+		const double* group = groups + static_cast<size_t>(KERNEL_GROUP_SIZE) * dimension * currentGroup;
+		__m256d maxDifferences[REGISTERS_NUMBER];
+		for (int currentRegister = 0; currentRegister < REGISTERS_NUMBER; ++currentRegister) {
+			maxDifferences[currentRegister] = _mm256_setzero_pd();
+		}
+
+		for (int currentCoordinate = 0; currentCoordinate < dimension; ++currentCoordinate) {
+			const double* coordinates = group + KERNEL_GROUP_SIZE * currentCoordinate;
+			const __m256d pointCoordinate = _mm256_set1_pd(point[currentCoordinate]);
+			for (int currentRegister = 0; currentRegister < REGISTERS_NUMBER; ++currentRegister) {
+				__m256d coordinatesDifference = _mm256_sub_pd(_mm256_loadu_pd(coordinates + 4 * currentRegister), pointCoordinate);
+				maxDifferences[currentRegister] = _mm256_max_pd(maxDifferences[currentRegister], _mm256_andnot_pd(signMask, coordinatesDifference));
+			}
+		}
+
+		for (int currentRegister = 0; currentRegister < REGISTERS_NUMBER; ++currentRegister) {
+			_mm256_storeu_pd(distances + KERNEL_GROUP_SIZE * currentGroup + 4 * currentRegister, maxDifferences[currentRegister]);
+		}
+	}
+
+	return getFirstMinPositionAvx2(distances, pointsNumber);
+}
+
+KDTREE_TARGET("avx2")
+int getGroupWeightedDistancesAvx2(const double* groups, int pointsNumber, const double* point, const double* weights, 
+	int dimension, double* distances) {
+
+	const int groupsNumber = getGroupsNumber(pointsNumber);
+	const int REGISTERS_NUMBER = KERNEL_GROUP_SIZE / 4;
+
+	for (int currentGroup = 0; currentGroup < groupsNumber; ++currentGroup) {
+		const double* group = groups + static_cast<size_t>(KERNEL_GROUP_SIZE) * dimension * currentGroup;
+		__m256d sums[REGISTERS_NUMBER];
+		for (int currentRegister = 0; currentRegister < REGISTERS_NUMBER; ++currentRegister) {
+			sums[currentRegister] = _mm256_setzero_pd();
+		}
+
+		for (int currentCoordinate = 0; currentCoordinate < dimension; ++currentCoordinate) {
+			const double* coordinates = group + KERNEL_GROUP_SIZE * currentCoordinate;
+			const __m256d pointCoordinate = _mm256_set1_pd(point[currentCoordinate]);
+			const __m256d weight = _mm256_set1_pd(weights[currentCoordinate]);
+			for (int currentRegister = 0; currentRegister < REGISTERS_NUMBER; ++currentRegister) {
+				__m256d coordinatesDifference = _mm256_sub_pd(_mm256_loadu_pd(coordinates + 4 * currentRegister), pointCoordinate);
+				sums[currentRegister] = _mm256_add_pd(sums[currentRegister], _mm256_mul_pd(weight, _mm256_mul_pd(coordinatesDifference, coordinatesDifference)));
+			}
+		}
+
+		for (int currentRegister = 0; currentRegister < REGISTERS_NUMBER; ++currentRegister) {
+			_mm256_storeu_pd(distances + KERNEL_GROUP_SIZE * currentGroup + 4 * currentRegister, sums[currentRegister]);
+		}
+	}
+
+	return getFirstMinPositionAvx2(distances, pointsNumber);
+}
+
+#endif
+
+#ifdef KDTREE_AVX512_KERNEL
+
+//the casts and extracts of the wide register trip false warnings in some compilers, a store does not
+KDTREE_TARGET("avx512f")
+double getLanesSum(__m512d values) {
+	double lanes[8];
+	_mm512_storeu_pd(lanes, values);
+	__m256d quarterSum = _mm256_add_pd(_mm256_loadu_pd(lanes), _mm256_loadu_pd(lanes + 4));
+	__m128d halfSum = _mm_add_pd(_mm256_castpd256_pd128(quarterSum), _mm256_extractf128_pd(quarterSum, 1));
+	return _mm_cvtsd_f64(_mm_add_sd(halfSum, _mm_unpackhi_pd(halfSum, halfSum)));
+}
+
+KDTREE_TARGET("avx512f")
+double getLanesMax(__m512d values) {
+	double lanes[8];
+	_mm512_storeu_pd(lanes, values);
+	__m256d quarterMax = _mm256_max_pd(_mm256_loadu_pd(lanes), _mm256_loadu_pd(lanes + 4));
+	__m128d halfMax = _mm_max_pd(_mm256_castpd256_pd128(quarterMax), _mm256_extractf128_pd(quarterMax, 1));
+	return _mm_cvtsd_f64(_mm_max_sd(halfMax, _mm_unpackhi_pd(halfMax, halfMax)));
+}
+
+KDTREE_TARGET("avx512f")
+double getLanesMin(__m512d values) {
+	double lanes[8];
+	_mm512_storeu_pd(lanes, values);
+	__m256d quarterMin = _mm256_min_pd(_mm256_loadu_pd(lanes), _mm256_loadu_pd(lanes + 4));
+	__m128d halfMin = _mm_min_pd(_mm256_castpd256_pd128(quarterMin), _mm256_extractf128_pd(quarterMin, 1));
+	return _mm_cvtsd_f64(_mm_min_sd(halfMin, _mm_unpackhi_pd(halfMin, halfMin)));
+}
+
+KDTREE_TARGET("avx512f")
+int getFirstMinPositionAvx512(const double* distances, int pointsNumber) {
+	const __m512d limit = _mm512_set1_pd(pointsNumber);
+	const __m512d step = _mm512_set1_pd(8);
+	__m512d positions = _mm512_set_pd(7, 6, 5, 4, 3, 2, 1, 0);
+	__m512d minDistances = _mm512_set1_pd(std::numeric_limits<double>::max());
+	__m512d minPositions = _mm512_setzero_pd();
+
+	for (int currentPoint = 0; currentPoint < pointsNumber; currentPoint += 8) {
+		__m512d currentDistances = _mm512_loadu_pd(distances + currentPoint);
+		__mmask8 smaller = _mm512_mask_cmp_pd_mask(_mm512_cmp_pd_mask(positions, limit, _CMP_LT_OQ), currentDistances, minDistances, _CMP_LT_OQ);
+		minDistances = _mm512_mask_mov_pd(minDistances, smaller, currentDistances);
+		minPositions = _mm512_mask_mov_pd(minPositions, smaller, positions);
+		positions = _mm512_add_pd(positions, step);
+	}
+
+	__mmask8 smallest = _mm512_cmp_pd_mask(minDistances, _mm512_set1_pd(getLanesMin(minDistances)), _CMP_EQ_OQ);
+	return static_cast<int>(getLanesMin(_mm512_mask_mov_pd(limit, smallest, minPositions)));
+}
+
+KDTREE_TARGET("avx512f")
+int getBlockDistancesAvx512(const double* points, int pointsNumber, int stride, const double* point, int dimension, double* distances) {
+	const int fullDimension = dimension & ~7;
+	const __mmask8 tailMask = static_cast<__mmask8>((1 << (dimension - fullDimension)) - 1);
+	const __m512d pointTail = _mm512_maskz_loadu_pd(tailMask, point + fullDimension);
+	int minPosition = 0;
+
+	for (int currentPoint = 0; currentPoint < pointsNumber; ++currentPoint) {
+		const double* currentRow = points + static_cast<size_t>(stride) * currentPoint;
+		__m512d sum = _mm512_setzero_pd();
+
+		for (int currentCoordinate = 0; currentCoordinate < fullDimension; currentCoordinate += 8) {
+			__m512d coordinatesDifference = _mm512_sub_pd(_mm512_loadu_pd(currentRow + currentCoordinate), _mm512_loadu_pd(point + currentCoordinate));
+			sum = _mm512_add_pd(sum, _mm512_mul_pd(coordinatesDifference, coordinatesDifference));
+		}
+		if (tailMask != 0) {
+			__m512d coordinatesDifference = _mm512_sub_pd(_mm512_maskz_loadu_pd(tailMask, currentRow + fullDimension), pointTail);
+			sum = _mm512_add_pd(sum, _mm512_mul_pd(coordinatesDifference, coordinatesDifference));
+		}
+
+		double distance = getLanesSum(sum);
+		distances[currentPoint] = distance;
+		if (distance < distances[minPosition]) {
+			minPosition = currentPoint;
+		}
+	}
+
+	return minPosition;
+}
+
+KDTREE_TARGET("avx512f")
+int getBlockManhattanDistancesAvx512(const double* points, int pointsNumber, int stride, const double* point, int dimension, double* distances) {
+	const int fullDimension = dimension & ~7;
+	const __mmask8 tailMask = static_cast<__mmask8>((1 << (dimension - fullDimension)) - 1);
+	const __m512d pointTail = _mm512_maskz_loadu_pd(tailMask, point + fullDimension);
+	int minPosition = 0;
+
+	for (int currentPoint = 0; currentPoint < pointsNumber; ++currentPoint) {
+		const double* currentRow = points + static_cast<size_t>(stride) * currentPoint;
+		__m512d sum = _mm512_setzero_pd();
+
+		for (int currentCoordinate = 0; currentCoordinate < fullDimension; currentCoordinate += 8) {
+			__m512d coordinatesDifference = _mm512_sub_pd(_mm512_loadu_pd(currentRow + currentCoordinate), _mm512_loadu_pd(point + currentCoordinate));
+			sum = _mm512_add_pd(sum, _mm512_abs_pd(coordinatesDifference));
+		}
+		if (tailMask != 0) {
+			__m512d coordinatesDifference = _mm512_sub_pd(_mm512_maskz_loadu_pd(tailMask, currentRow + fullDimension), pointTail);
+			sum = _mm512_add_pd(sum, _mm512_abs_pd(coordinatesDifference));
+		}
+
+		double distance = getLanesSum(sum);
+		distances[currentPoint] = distance;
+		if (distance < distances[minPosition]) {
+			minPosition = currentPoint;
+		}
+	}
+
+	return minPosition;
+}
+
+//the unmasked maximum starts from an undefined register, which some compilers warn about
+const __mmask8 ALL_LANES_MASK = 0xFF;
+
+KDTREE_TARGET("avx512f")
+int getBlockChebyshevDistancesAvx512(const double* points, int pointsNumber, int stride, const double* point, int dimension, double* distances) {
+	const int fullDimension = dimension & ~7;
+	const __mmask8 tailMask = static_cast<__mmask8>((1 << (dimension - fullDimension)) - 1);
+	const __m512d pointTail = _mm512_maskz_loadu_pd(tailMask, point + fullDimension);
+	int minPosition = 0;
+
+	for (int currentPoint = 0; currentPoint < pointsNumber; ++currentPoint) {
+		const double* currentRow = points + static_cast<size_t>(stride) * currentPoint;
+		__m512d maxDifference = _mm512_setzero_pd();
+
+		for (int currentCoordinate = 0; currentCoordinate < fullDimension; currentCoordinate += 8) {
+			__m512d coordinatesDifference = _mm512_sub_pd(_mm512_loadu_pd(currentRow + currentCoordinate), _mm512_loadu_pd(point + currentCoordinate));
+			maxDifference = _mm512_mask_max_pd(maxDifference, ALL_LANES_MASK, maxDifference, _mm512_abs_pd(coordinatesDifference));
+		}
+		if (tailMask != 0) {
+			__m512d coordinatesDifference = _mm512_sub_pd(_mm512_maskz_loadu_pd(tailMask, currentRow + fullDimension), pointTail);
+			maxDifference = _mm512_mask_max_pd(maxDifference, ALL_LANES_MASK, maxDifference, _mm512_abs_pd(coordinatesDifference));
+		}
+
+		double distance = getLanesMax(maxDifference);
+		distances[currentPoint] = distance;
+		if (distance < distances[minPosition]) {
+			minPosition = currentPoint;
+		}
+	}
+
+	return minPosition;
+}
+
+KDTREE_TARGET("avx512f")
+int getBlockWeightedDistancesAvx512(const double* points, int pointsNumber, int stride, const double* point, const double* weights, 
+	int dimension, double* distances) {
+
+	const int fullDimension = dimension & ~7;
+	const __mmask8 tailMask = static_cast<__mmask8>((1 << (dimension - fullDimension)) - 1);
+	const __m512d pointTail = _mm512_maskz_loadu_pd(tailMask, point + fullDimension);
+	const __m512d weightsTail = _mm512_maskz_loadu_pd(tailMask, weights + fullDimension);
+	int minPosition = 0;
+
+	for (int currentPoint = 0; currentPoint < pointsNumber; ++currentPoint) {
+		const double* currentRow = points + static_cast<size_t>(stride) * currentPoint;
+		__m512d sum = _mm512_setzero_pd();
+
+		for (int currentCoordinate = 0; currentCoordinate < fullDimension; currentCoordinate += 8) {
+			__m512d coordinatesDifference = _mm512_sub_pd(_mm512_loadu_pd(currentRow + currentCoordinate), _mm512_loadu_pd(point + currentCoordinate));
+			sum = _mm512_add_pd(sum, _mm512_mul_pd(_mm512_loadu_pd(weights + currentCoordinate), _mm512_mul_pd(coordinatesDifference, coordinatesDifference)));
+		}
+		if (tailMask != 0) {
+			__m512d coordinatesDifference = _mm512_sub_pd(_mm512_maskz_loadu_pd(tailMask, currentRow + fullDimension), pointTail);
+			sum = _mm512_add_pd(sum, _mm512_mul_pd(weightsTail, _mm512_mul_pd(coordinatesDifference, coordinatesDifference)));
+		}
+
+		double distance = getLanesSum(sum);
+		distances[currentPoint] = distance;
+		if (distance < distances[minPosition]) {
+			minPosition = currentPoint;
+		}
+	}
+
+	return minPosition;
+}
+
+//a group fills one register
+KDTREE_TARGET("avx512f")
+int getGroupDistancesAvx512(const double* groups, int pointsNumber, const double* point, int dimension, double* distances) {
+	const int groupsNumber = getGroupsNumber(pointsNumber);
+
+	for (int currentGroup = 0; currentGroup < groupsNumber; ++currentGroup) {
+		const double* group = groups + static_cast<size_t>(KERNEL_GROUP_SIZE) * dimension * currentGroup;
+		__m512d sum = _mm512_setzero_pd();
+
+		for (int currentCoordinate = 0; currentCoordinate < dimension; ++currentCoordinate) {
+			__m512d coordinatesDifference = _mm512_sub_pd(_mm512_loadu_pd(group + KERNEL_GROUP_SIZE * currentCoordinate), 
+				_mm512_set1_pd(point[currentCoordinate]));
+			sum = _mm512_add_pd(sum, _mm512_mul_pd(coordinatesDifference, coordinatesDifference));
+		}
+
+		_mm512_storeu_pd(distances + KERNEL_GROUP_SIZE * currentGroup, sum);
+	}
+
+	return getFirstMinPositionAvx512(distances, pointsNumber);
+}
+
+KDTREE_TARGET("avx512f")
+int getGroupManhattanDistancesAvx512(const double* groups, int pointsNumber, const double* point, int dimension, double* distances) {
+	const int groupsNumber = getGroupsNumber(pointsNumber);
+
+	for (int currentGroup = 0; currentGroup < groupsNumber; ++currentGroup) {
+		const double* group = groups + static_cast<size_t>(KERNEL_GROUP_SIZE) * dimension * currentGroup;
+		__m512d sum = _mm512_setzero_pd();
+
+		for (int currentCoordinate = 0; currentCoordinate < dimension; ++currentCoordinate) {
+			__m512d coordinatesDifference = _mm512_sub_pd(_mm512_loadu_pd(group + KERNEL_GROUP_SIZE * currentCoordinate), 
+				_mm512_set1_pd(point[currentCoordinate]));
+			sum = _mm512_add_pd(sum, _mm512_abs_pd(coordinatesDifference));
+		}
+
+		_mm512_storeu_pd(distances + KERNEL_GROUP_SIZE * currentGroup, sum);
+	}
+
+	return getFirstMinPositionAvx512(distances, pointsNumber);
+}
+
+KDTREE_TARGET("avx512f")
+int getGroupChebyshevDistancesAvx512(const double* groups, int pointsNumber, const double* point, int dimension, double* distances) {
+	const int groupsNumber = getGroupsNumber(pointsNumber);
+
+	for (int currentGroup = 0; currentGroup < groupsNumber; ++currentGroup) {
+		const double* group = groups + static_cast<size_t>(KERNEL_GROUP_SIZE) * dimension * currentGroup;
+		__m512d maxDifference = _mm512_setzero_pd();
+
+		for (int currentCoordinate = 0; currentCoordinate < dimension; ++currentCoordinate) {
+			__m512d coordinatesDifference = _mm512_sub_pd(_mm512_loadu_pd(group + KERNEL_GROUP_SIZE * currentCoordinate), 
+				_mm512_set1_pd(point[currentCoordinate]));
+			maxDifference = _mm512_mask_max_pd(maxDifference, ALL_LANES_MASK, maxDifference, _mm512_abs_pd(coordinatesDifference));
+		}
+
+		_mm512_storeu_pd(distances + KERNEL_GROUP_SIZE * currentGroup, maxDifference);
+	}
+
+	return getFirstMinPositionAvx512(distances, pointsNumber);
+}
+
+KDTREE_TARGET("avx512f")
+int getGroupWeightedDistancesAvx512(const double* groups, int pointsNumber, const double* point, const double* weights, 
+	int dimension, double* distances) {
+
+	const int groupsNumber = getGroupsNumber(pointsNumber);
+
+	for (int currentGroup = 0; currentGroup < groupsNumber; ++currentGroup) {
+		const double* group = groups + static_cast<size_t>(KERNEL_GROUP_SIZE) * dimension * currentGroup;
+		__m512d sum = _mm512_setzero_pd();
+
+		for (int currentCoordinate = 0; currentCoordinate < dimension; ++currentCoordinate) {
+			__m512d coordinatesDifference = _mm512_sub_pd(_mm512_loadu_pd(group + KERNEL_GROUP_SIZE * currentCoordinate), 
+				_mm512_set1_pd(point[currentCoordinate]));
+			sum = _mm512_add_pd(sum, _mm512_mul_pd(_mm512_set1_pd(weights[currentCoordinate]), _mm512_mul_pd(coordinatesDifference, coordinatesDifference)));
+		}
+
+		_mm512_storeu_pd(distances + KERNEL_GROUP_SIZE * currentGroup, sum);
+	}
+
+	return getFirstMinPositionAvx512(distances, pointsNumber);
+}
+
+#endif
+
+#ifdef KDTREE_X86_KERNELS
+
+void getCpuidRegisters(int leaf, int subleaf, unsigned int registers[4]) {
+#ifdef _MSC_VER
+	int values[4];
+	__cpuidex(values, leaf, subleaf);
+	for (int currentRegister = 0; currentRegister < 4; ++currentRegister) {
+		registers[currentRegister] = static_cast<unsigned int>(values[currentRegister]);
+	}
+#else
+	__cpuid_count(leaf, subleaf, registers[0], registers[1], registers[2], registers[3]);
+#endif
+}
+
+//register states the system saves on context switches, wide registers are useless without them
+unsigned long long getEnabledRegisterStates() {
+#ifdef _MSC_VER
+	return _xgetbv(0);
+#else
+	unsigned int lowHalf, highHalf;
+	__asm__ __volatile__("xgetbv" : "=a"(lowHalf), "=d"(highHalf) : "c"(0));
+	return (static_cast<unsigned long long>(highHalf) << 32) | lowHalf;
+#endif
+}
+
+#endif
+
+DistanceKernelLevel getSupportedKernelLevel() {
+#ifdef KDTREE_X86_KERNELS
+	const unsigned int OSXSAVE_BIT = 1u << 27;
+	const unsigned int AVX_BIT = 1u << 28;
+	const unsigned int AVX2_BIT = 1u << 5;
+	const unsigned int AVX512F_BIT = 1u << 16;
+	const unsigned long long AVX_STATES = 0x6;
+	const unsigned long long AVX512_STATES = 0xE6;
+
+	unsigned int registers[4];
+	getCpuidRegisters(0, 0, registers);
+	unsigned int maxLeaf = registers[0];
+
+	getCpuidRegisters(1, 0, registers);
+	if ((maxLeaf < 7) || ((registers[2] & OSXSAVE_BIT) == 0) || ((registers[2] & AVX_BIT) == 0)) {
+		return SSE2_KERNEL;
+	}
+
+	unsigned long long enabledStates = getEnabledRegisterStates();
+	getCpuidRegisters(7, 0, registers);
+	if (((registers[1] & AVX512F_BIT) != 0) && ((enabledStates & AVX512_STATES) == AVX512_STATES)) {
+		return AVX512_KERNEL;
+	}
+	if (((registers[1] & AVX2_BIT) != 0) && ((enabledStates & AVX_STATES) == AVX_STATES)) {
+		return AVX2_KERNEL;
+	}
+	return SSE2_KERNEL;
+#else
+	return SCALAR_KERNEL;
+#endif
+}
+
+//the widest kernel not above maxLevel that this processor runs and this build contains, for points in the layout
+DistanceKernel getDistanceKernel(DistanceKernelLevel maxLevel, DistanceKernelLayout layout = ROW_KERNEL_LAYOUT) {
+	static const DistanceKernelLevel supportedLevel = getSupportedKernelLevel();
+	DistanceKernelLevel level = (maxLevel < supportedLevel ? maxLevel : supportedLevel);
+	bool transposed = (layout == TRANSPOSED_KERNEL_LAYOUT);
+
+#ifdef KDTREE_AVX512_KERNEL
+	if (level >= AVX512_KERNEL) {
+		DistanceKernel kernel = {AVX512_KERNEL, layout, transposed ? "avx512 transposed" : "avx512", getBlockDistancesAvx512, 
+			getBlockManhattanDistancesAvx512, getBlockChebyshevDistancesAvx512, getBlockWeightedDistancesAvx512, getGroupDistancesAvx512, 
+			getGroupManhattanDistancesAvx512, getGroupChebyshevDistancesAvx512, getGroupWeightedDistancesAvx512};
+		return kernel;
+	}
+#endif
+#ifdef KDTREE_AVX2_KERNEL
+	if (level >= AVX2_KERNEL) {
+		DistanceKernel kernel = {AVX2_KERNEL, layout, transposed ? "avx2 transposed" : "avx2", getBlockDistancesAvx2, 
+			getBlockManhattanDistancesAvx2, getBlockChebyshevDistancesAvx2, getBlockWeightedDistancesAvx2, getGroupDistancesAvx2, 
+			getGroupManhattanDistancesAvx2, getGroupChebyshevDistancesAvx2, getGroupWeightedDistancesAvx2};
+		return kernel;
+	}
+#endif
+#ifdef KDTREE_X86_KERNELS
+	if (level >= SSE2_KERNEL) {
+		DistanceKernel kernel = {SSE2_KERNEL, layout, transposed ? "sse2 transposed" : "sse2", getBlockDistancesSse2, 
+			getBlockManhattanDistancesSse2, getBlockChebyshevDistancesSse2, getBlockWeightedDistancesSse2, getGroupDistancesSse2, 
+			getGroupManhattanDistancesSse2, getGroupChebyshevDistancesSse2, getGroupWeightedDistancesSse2};
+		return kernel;
+	}
+#endif
+
+	DistanceKernel kernel = {SCALAR_KERNEL, layout, transposed ? "scalar transposed" : "scalar", getBlockDistancesScalar, 
+		getBlockManhattanDistancesScalar, getBlockChebyshevDistancesScalar, getBlockWeightedDistancesScalar, getGroupDistancesScalar<double>, 
+		getGroupManhattanDistancesScalar<double>, getGroupChebyshevDistancesScalar<double>, getGroupWeightedDistancesScalar<double>};
+	return kernel;
+}
+
+//the kernels are timed on this many leaves of this many points, as many as the leaves of a tree of the default
+//leaf size hold on average; a leaf is a run of rows or a group of its own, like in a tree
+const int KERNEL_SAMPLE_LEAVES_NUMBER = 256;
+const int KERNEL_SAMPLE_LEAF_SIZE = 6;
+//a round of the measurement scans about this many coordinates, every kernel is timed in this many rounds
+//and its fastest round counts
+const int KERNEL_SAMPLE_COORDINATES_NUMBER = 65536;
+const int KERNEL_MEASUREMENT_ROUNDS = 5;
+//larger dimensions are measured as this one, the kernels rank alike once the rows are this long
+const int MAX_MEASURED_KERNEL_DIMENSION = 32;
+
+//seconds of the fastest round of the kernel over the sample leaves
+double getKernelScanTime(const DistanceKernel &kernel, int dimension, const std::vector<double> &rows, const std::vector<double> &groups, 
+	const std::vector<double> &point) {
+
+	int passesNumber = std::max(1, KERNEL_SAMPLE_COORDINATES_NUMBER / (KERNEL_SAMPLE_LEAVES_NUMBER * KERNEL_SAMPLE_LEAF_SIZE * dimension));
+	double distances[KERNEL_GROUP_SIZE];
+	double bestTime = std::numeric_limits<double>::max();
+	double distancesSum = 0;
+
+	for (int currentRound = 0; currentRound < KERNEL_MEASUREMENT_ROUNDS; ++currentRound) {
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+		for (int currentPass = 0; currentPass < passesNumber; ++currentPass) {
+			for (int currentLeaf = 0; currentLeaf < KERNEL_SAMPLE_LEAVES_NUMBER; ++currentLeaf) {
+				if (kernel.layout == ROW_KERNEL_LAYOUT) {
+					distancesSum += distances[kernel.getBlockDistances(&rows[static_cast<size_t>(KERNEL_SAMPLE_LEAF_SIZE) * dimension * currentLeaf], 
+						KERNEL_SAMPLE_LEAF_SIZE, dimension, &point[0], dimension, distances)];
+				} else {
+					distancesSum += distances[kernel.getGroupDistances(&groups[static_cast<size_t>(KERNEL_GROUP_SIZE) * dimension * currentLeaf], 
+						KERNEL_SAMPLE_LEAF_SIZE, &point[0], dimension, distances)];
+				}
+			}
+		}
+
+		bestTime = std::min(bestTime, std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+	}
+
+	//the sum is used, so the scans are not left out
+	return (distancesSum >= 0 ? bestTime : std::numeric_limits<double>::max());
+}
+
+//times the kernels of every level this processor runs in the layout on a sample of the dimension and returns
+//the fastest; row kernels are slower than the scalar loop for short rows, so the widest level is not always the best one
+DistanceKernel measureDistanceKernel(int dimension, DistanceKernelLayout layout) {
+	std::vector<double> rows(static_cast<size_t>(KERNEL_SAMPLE_LEAVES_NUMBER) * KERNEL_SAMPLE_LEAF_SIZE * dimension);
+	std::vector<double> groups(static_cast<size_t>(KERNEL_SAMPLE_LEAVES_NUMBER) * KERNEL_GROUP_SIZE * dimension, 0);
+	std::vector<double> point(dimension);
+
+	//any spread of values does, the kernels take the same time on all of them
+	unsigned int value = 1;
+	for (size_t currentValue = 0; currentValue < rows.size(); ++currentValue) {
+		value = value * 1103515245u + 12345u;
+		rows[currentValue] = static_cast<double>(value >> 16) / 65536.0;
+
+		size_t pointNumber = currentValue / dimension;
+		size_t coordinate = currentValue % dimension;
+		groups[(pointNumber / KERNEL_SAMPLE_LEAF_SIZE) * KERNEL_GROUP_SIZE * dimension + coordinate * KERNEL_GROUP_SIZE + pointNumber % KERNEL_SAMPLE_LEAF_SIZE] = 
+			rows[currentValue];
+	}
+	for (int currentCoordinate = 0; currentCoordinate < dimension; ++currentCoordinate) {
+		point[currentCoordinate] = rows[currentCoordinate] / 2;
+	}
+
+	DistanceKernel bestKernel = getDistanceKernel(SCALAR_KERNEL, layout);
+	double bestTime = std::numeric_limits<double>::max();
+
+	for (int currentLevel = SCALAR_KERNEL; currentLevel <= getSupportedKernelLevel(); ++currentLevel) {
+		DistanceKernel kernel = getDistanceKernel(static_cast<DistanceKernelLevel>(currentLevel), layout);
+		if (kernel.level != currentLevel) {
+			continue;
+		}
+
+		double scanTime = getKernelScanTime(kernel, dimension, rows, groups, point);
+		if (scanTime < bestTime) {
+			bestTime = scanTime;
+			bestKernel = kernel;
+		}
+	}
+
+	return bestKernel;
+}
+
+//the kernel of the layout measured fastest for the dimension, the measurement is done once per dimension and layout
+DistanceKernel getMeasuredDistanceKernel(int dimension, DistanceKernelLayout layout) {
+	static std::mutex measuredKernelsMutex;
+	static std::map<std::pair<int, int>, DistanceKernel> measuredKernels;
+
+	std::pair<int, int> kernelKey(std::max(1, std::min(dimension, MAX_MEASURED_KERNEL_DIMENSION)), layout);
+	std::lock_guard<std::mutex> lock(measuredKernelsMutex);
+	std::map<std::pair<int, int>, DistanceKernel>::const_iterator measuredKernel = measuredKernels.find(kernelKey);
+	if (measuredKernel != measuredKernels.end()) {
+		return measuredKernel->second;
+	}
+
+	DistanceKernel kernel = measureDistanceKernel(kernelKey.first, layout);
+	measuredKernels[kernelKey] = kernel;
+	return kernel;
+}
+
+//the kernel functions for doubles, the templates below loop over other scalar types, which have no vector kernels
+int getBlockDistances(const DistanceKernel &kernel, const double* points, int pointsNumber, int stride, const double* point, int dimension, 
+	double* distances) {
+
+	return kernel.getBlockDistances(points, pointsNumber, stride, point, dimension, distances);
+}
+
+template <typename Scalar>
+int getBlockDistances(const DistanceKernel &, const Scalar* points, int pointsNumber, int stride, const Scalar* point, int dimension, 
+	Scalar* distances) {
+
+	int minPosition = 0;
+
+	for (int currentPoint = 0; currentPoint < pointsNumber; ++currentPoint) {
+		const Scalar* currentRow = points + static_cast<size_t>(stride) * currentPoint;
+		Scalar distance = 0;
+		for (int currentCoordinate = 0; currentCoordinate < dimension; ++currentCoordinate) {
+			Scalar coordinatesDifference = currentRow[currentCoordinate] - point[currentCoordinate];
+			distance += coordinatesDifference * coordinatesDifference;
+		}
+
+		distances[currentPoint] = distance;
+		if (distance < distances[minPosition]) {
+			minPosition = currentPoint;
+		}
+	}
+
+	return minPosition;
+}
+
+int getBlockManhattanDistances(const DistanceKernel &kernel, const double* points, int pointsNumber, int stride, const double* point, int dimension, 
+	double* distances) {
+
+	return kernel.getBlockManhattanDistances(points, pointsNumber, stride, point, dimension, distances);
+}
+
+template <typename Scalar>
+int getBlockManhattanDistances(const DistanceKernel &, const Scalar* points, int pointsNumber, int stride, const Scalar* point, int dimension, 
+	Scalar* distances) {
+
+	int minPosition = 0;
+
+	for (int currentPoint = 0; currentPoint < pointsNumber; ++currentPoint) {
+		const Scalar* currentRow = points + static_cast<size_t>(stride) * currentPoint;
+		Scalar distance = 0;
+		for (int currentCoordinate = 0; currentCoordinate < dimension; ++currentCoordinate) {
+			distance += std::abs(currentRow[currentCoordinate] - point[currentCoordinate]);
+		}
+
+		distances[currentPoint] = distance;
+		if (distance < distances[minPosition]) {
+			minPosition = currentPoint;
+		}
+	}
+
+	return minPosition;
+}
+
+int getBlockChebyshevDistances(const DistanceKernel &kernel, const double* points, int pointsNumber, int stride, const double* point, int dimension, 
+	double* distances) {
+
+	return kernel.getBlockChebyshevDistances(points, pointsNumber, stride, point, dimension, distances);
+}
+
+template <typename Scalar>
+int getBlockChebyshevDistances(const DistanceKernel &, const Scalar* points, int pointsNumber, int stride, const Scalar* point, int dimension, 
+	Scalar* distances) {
+
+	int minPosition = 0;
+
+	for (int currentPoint = 0; currentPoint < pointsNumber; ++currentPoint) {
+		const Scalar* currentRow = points + static_cast<size_t>(stride) * currentPoint;
+		Scalar distance = 0;
+		for (int currentCoordinate = 0; currentCoordinate < dimension; ++currentCoordinate) {
+			distance = std::max(distance, static_cast<Scalar>(std::abs(currentRow[currentCoordinate] - point[currentCoordinate])));
+		}
+
+		distances[currentPoint] = distance;
+		if (distance < distances[minPosition]) {
+			minPosition = currentPoint;
+		}
+	}
+
+	return minPosition;
+}
+
+int getBlockWeightedDistances(const DistanceKernel &kernel, const double* points, int pointsNumber, int stride, const double* point, 
+	const double* weights, int dimension, double* distances) {
+
+	return kernel.getBlockWeightedDistances(points, pointsNumber, stride, point, weights, dimension, distances);
+}
+
+template <typename Scalar>
+int getBlockWeightedDistances(const DistanceKernel &, const Scalar* points, int pointsNumber, int stride, const Scalar* point, 
+	const double* weights, int dimension, Scalar* distances) {
+
+	int minPosition = 0;
+
+	for (int currentPoint = 0; currentPoint < pointsNumber; ++currentPoint) {
+		const Scalar* currentRow = points + static_cast<size_t>(stride) * currentPoint;
+		Scalar distance = 0;
+		for (int currentCoordinate = 0; currentCoordinate < dimension; ++currentCoordinate) {
+			Scalar coordinatesDifference = currentRow[currentCoordinate] - point[currentCoordinate];
+			distance += static_cast<Scalar>(weights[currentCoordinate]) * coordinatesDifference * coordinatesDifference;
+		}
+
+		distances[currentPoint] = distance;
+		if (distance < distances[minPosition]) {
+			minPosition = currentPoint;
+		}
+	}
+
+	return minPosition;
+}
+
+int getGroupDistances(const DistanceKernel &kernel, const double* groups, int pointsNumber, const double* point, int dimension, double* distances) {
+	return kernel.getGroupDistances(groups, pointsNumber, point, dimension, distances);
+}
+
+template <typename Scalar>
+int getGroupDistances(const DistanceKernel &, const Scalar* groups, int pointsNumber, const Scalar* point, int dimension, Scalar* distances) {
+	return getGroupDistancesScalar(groups, pointsNumber, point, dimension, distances);
+}
+
+int getGroupManhattanDistances(const DistanceKernel &kernel, const double* groups, int pointsNumber, const double* point, int dimension, 
+	double* distances) {
+
+	return kernel.getGroupManhattanDistances(groups, pointsNumber, point, dimension, distances);
+}
+
+template <typename Scalar>
+int getGroupManhattanDistances(const DistanceKernel &, const Scalar* groups, int pointsNumber, const Scalar* point, int dimension, 
+	Scalar* distances) {
+
+	return getGroupManhattanDistancesScalar(groups, pointsNumber, point, dimension, distances);
+}
+
+int getGroupChebyshevDistances(const DistanceKernel &kernel, const double* groups, int pointsNumber, const double* point, int dimension, 
+	double* distances) {
+
+	return kernel.getGroupChebyshevDistances(groups, pointsNumber, point, dimension, distances);
+}
+
+template <typename Scalar>
+int getGroupChebyshevDistances(const DistanceKernel &, const Scalar* groups, int pointsNumber, const Scalar* point, int dimension, 
+	Scalar* distances) {
+
+	return getGroupChebyshevDistancesScalar(groups, pointsNumber, point, dimension, distances);
+}
+
+int getGroupWeightedDistances(const DistanceKernel &kernel, const double* groups, int pointsNumber, const double* point, const double* weights, 
+	int dimension, double* distances) {
+
+	return kernel.getGroupWeightedDistances(groups, pointsNumber, point, weights, dimension, distances);
+}
+
+template <typename Scalar>
+int getGroupWeightedDistances(const DistanceKernel &, const Scalar* groups, int pointsNumber, const Scalar* point, const double* weights, 
+	int dimension, Scalar* distances) {
+
+	return getGroupWeightedDistancesScalar(groups, pointsNumber, point, weights, dimension, distances);
+}
@@ -0,0 +1,192 @@
+#pragma once
+#include <cmath>
+#include <vector>
+#include <algorithm>
+#include <cassert>
+
+#include "DistanceKernels.h"
+
+//metrics the tree measures distances in; the searches work with a metric distance, which is combined from
+//the offsets of the coordinates: getOffset(difference, coordinate) is the offset of one coordinate,
+//addOffset adds an offset to a metric distance and updateCellDistance replaces one offset of a cell
+//by a larger one; getBlockDistances and getGroupDistances measure points stored in rows and in transposed groups
+//by the kernel of the metric, getDistance turns a metric distance into the distance reported to the caller
+//and getMetricDistance back
+
+//squared differences summed, the distance is the square root of the sum
+struct EuclideanMetric {
+	template <typename Scalar>
+	Scalar getOffset(Scalar difference, int) const {
+		return difference * difference;
+	}
+
+	template <typename Scalar>
+	Scalar addOffset(Scalar distance, Scalar offset) const {
+		return distance + offset;
+	}
+
+	template <typename Scalar>
+	Scalar updateCellDistance(Scalar cellDistance, Scalar oldOffset, Scalar newOffset) const {
+		return cellDistance - oldOffset + newOffset;
+	}
+
+	template <typename Scalar>
+	int getBlockDistances(const DistanceKernel &kernel, const Scalar* points, int pointsNumber, int stride, const Scalar* point, int dimension, 
+		Scalar* distances) const {
+
+		return ::getBlockDistances(kernel, points, pointsNumber, stride, point, dimension, distances);
+	}
+
+	template <typename Scalar>
+	int getGroupDistances(const DistanceKernel &kernel, const Scalar* groups, int pointsNumber, const Scalar* point, int dimension, 
+		Scalar* distances) const {
+
+		return ::getGroupDistances(kernel, groups, pointsNumber, point, dimension, distances);
+	}
+
+	double getDistance(double metricDistance) const {
+		return sqrt(metricDistance);
+	}
+
+	double getMetricDistance(double distance) const {
+		return distance * distance;
+	}
+};
+
+//absolute differences summed
+struct ManhattanMetric {
+	template <typename Scalar>
+	Scalar getOffset(Scalar difference, int) const {
+		return std::abs(difference);
+	}
+
+	template <typename Scalar>
+	Scalar addOffset(Scalar distance, Scalar offset) const {
+		return distance + offset;
+	}
+
+	template <typename Scalar>
+	Scalar updateCellDistance(Scalar cellDistance, Scalar oldOffset, Scalar newOffset) const {
+		return cellDistance - oldOffset + newOffset;
+	}
+
+	template <typename Scalar>
+	int getBlockDistances(const DistanceKernel &kernel, const Scalar* points, int pointsNumber, int stride, const Scalar* point, int dimension, 
+		Scalar* distances) const {
+
+		return ::getBlockManhattanDistances(kernel, points, pointsNumber, stride, point, dimension, distances);
+	}
+
+	template <typename Scalar>
+	int getGroupDistances(const DistanceKernel &kernel, const Scalar* groups, int pointsNumber, const Scalar* point, int dimension, 
+		Scalar* distances) const {
+
+		return ::getGroupManhattanDistances(kernel, groups, pointsNumber, point, dimension, distances);
+	}
+
+	double getDistance(double metricDistance) const {
+		return metricDistance;
+	}
+
+	double getMetricDistance(double distance) const {
+		return distance;
+	}
+};
+
+//the largest absolute difference; the offsets of a child cell are never smaller than the ones of its parent,
+//so the larger offset is simply taken in, the offset it replaces can not be the only maximum left
+struct ChebyshevMetric {
+	template <typename Scalar>
+	Scalar getOffset(Scalar difference, int) const {
+		return std::abs(difference);
+	}
+
+	template <typename Scalar>
+	Scalar addOffset(Scalar distance, Scalar offset) const {
+		return std::max(distance, offset);
+	}
+
+	template <typename Scalar>
+	Scalar updateCellDistance(Scalar cellDistance, Scalar oldOffset, Scalar newOffset) const {
+		assert(newOffset >= oldOffset);
+		return std::max(cellDistance, newOffset);
+	}
+
+	template <typename Scalar>
+	int getBlockDistances(const DistanceKernel &kernel, const Scalar* points, int pointsNumber, int stride, const Scalar* point, int dimension, 
+		Scalar* distances) const {
+
+		return ::getBlockChebyshevDistances(kernel, points, pointsNumber, stride, point, dimension, distances);
+	}
+
+	template <typename Scalar>
+	int getGroupDistances(const DistanceKernel &kernel, const Scalar* groups, int pointsNumber, const Scalar* point, int dimension, 
+		Scalar* distances) const {
+
+		return ::getGroupChebyshevDistances(kernel, groups, pointsNumber, point, dimension, distances);
+	}
+
+	double getDistance(double metricDistance) const {
+		return metricDistance;
+	}
+
+	double getMetricDistance(double distance) const {
+		return distance;
+	}
+};
+
+//squared differences multiplied by the non-negative weights of their coordinates, one weight per coordinate
+class WeightedEuclideanMetric {
+private:
+	std::vector<double> weights_;
+
+public:
+	explicit WeightedEuclideanMetric(const std::vector<double> &weights) :
+		weights_(weights) {
+
+		//do nothing
+	}
+
+	const std::vector<double>& getWeights() const {
+		return weights_;
+	}
+
+	template <typename Scalar>
+	Scalar getOffset(Scalar difference, int coordinate) const {
+		return static_cast<Scalar>(weights_[coordinate]) * difference * difference;
+	}
+
+	template <typename Scalar>
+	Scalar addOffset(Scalar distance, Scalar offset) const {
+		return distance + offset;
+	}
+
+	template <typename Scalar>
+	Scalar updateCellDistance(Scalar cellDistance, Scalar oldOffset, Scalar newOffset) const {
+		return cellDistance - oldOffset + newOffset;
+	}
+
+	template <typename Scalar>
+	int getBlockDistances(const DistanceKernel &kernel, const Scalar* points, int pointsNumber, int stride, const Scalar* point, int dimension, 
+		Scalar* distances) const {
+
+		assert(static_cast<int>(weights_.size()) >= dimension);
+		return ::getBlockWeightedDistances(kernel, points, pointsNumber, stride, point, &weights_[0], dimension, distances);
+	}
+
+	template <typename Scalar>
+	int getGroupDistances(const DistanceKernel &kernel, const Scalar* groups, int pointsNumber, const Scalar* point, int dimension, 
+		Scalar* distances) const {
+
+		assert(static_cast<int>(weights_.size()) >= dimension);
+		return ::getGroupWeightedDistances(kernel, groups, pointsNumber, point, &weights_[0], dimension, distances);
+	}
+
+	double getDistance(double metricDistance) const {
+		return sqrt(metricDistance);
+	}
+
+	double getMetricDistance(double distance) const {
+		return distance * distance;
+	}
+};
@@ -0,0 +1,286 @@
+#pragma once
+#include <vector>
+#include <memory>
+#include <unordered_map>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#include "KDTree.h"
+
+//new points wait in an unsorted buffer of this size before they are moved to a tree
+const int DYNAMIC_KDTREE_BUFFER_SIZE = 64;
+
+//logarithmic method: level i holds a static tree of at most DYNAMIC_KDTREE_BUFFER_SIZE * 2^i points,
+//a full buffer is merged with the lowest occupied levels into the first level that can take them all;
+//removed points stay in their tree as tombstones until they make up half of it, then the tree is rebuilt
+template <int Dimension, typename Scalar>
+class BasicDynamicKDTree {
+private:
+	typedef BasicKDTree<Dimension, Scalar> StaticTree;
+
+	static const int BUFFER_LEVEL = -1;
+
+	struct TreeLevel {
+		std::unique_ptr<StaticTree> tree;
+		std::vector<char> removedPoints;
+		int removedPointsNumber;
+
+		TreeLevel() :
+			removedPointsNumber(0) {
+
+			//do nothing
+		}
+
+		bool isEmpty() const {
+			return !tree;
+		}
+
+		int getLivePointsNumber() const {
+			return (isEmpty() ? 0 : tree->getPointsNumber() - removedPointsNumber);
+		}
+	};
+
+	struct LivePointsFilter {
+		const std::vector<char>* removedPoints;
+
+		explicit LivePointsFilter(const std::vector<char>* newRemovedPoints) :
+			removedPoints(newRemovedPoints) {
+
+			//do nothing
+		}
+
+		bool operator()(int pointPosition) const {
+			return !(*removedPoints)[pointPosition];
+		}
+	};
+
+	struct PointLocation {
+		int level;
+		int position;
+
+		PointLocation() :
+			level(BUFFER_LEVEL),
+			position(0) {
+
+			//do nothing
+		}
+
+		PointLocation(int newLevel, int newPosition) :
+			level(newLevel),
+			position(newPosition) {
+
+			//do nothing
+		}
+	};
+
+	int dimension_;
+	BasicPointSet<Scalar> buffer_;
+	std::vector<TreeLevel> levels_;
+	std::unordered_map<int, PointLocation> locations_;
+
+	static int getLevelCapacity(int level) {
+		return DYNAMIC_KDTREE_BUFFER_SIZE << level;
+	}
+
+	void collectLivePoints(const TreeLevel &level, BasicPointSet<Scalar>* points) const {
+		const StaticTree &tree = *level.tree;
+		for (int currentPointPosition = 0; currentPointPosition < tree.getPointsNumber(); ++currentPointPosition) {
+			if (!level.removedPoints[currentPointPosition]) {
+				(*points).addPoint(tree.getPoint(currentPointPosition), tree.getIdentifier(currentPointPosition));
+			}
+		}
+	}
+
+	void buildLevel(int levelIndex, const BasicPointSet<Scalar> &points) {
+		TreeLevel &level = levels_[levelIndex];
+
+		if (points.size() == 0) {
+			level.tree.reset();
+			level.removedPoints.clear();
+			level.removedPointsNumber = 0;
+			return;
+		}
+
+		//levels are rebuilt on every flush, so their trees are neither tuned nor probed for the scan fallback
+		KDTreeBuildParameters parameters;
+		parameters.bruteForceFallback = false;
+		level.tree.reset(new StaticTree(points, parameters));
+		level.removedPoints.assign(points.size(), 0);
+		level.removedPointsNumber = 0;
+
+		const StaticTree &tree = *level.tree;
+		for (int currentPointPosition = 0; currentPointPosition < tree.getPointsNumber(); ++currentPointPosition) {
+			locations_[tree.getIdentifier(currentPointPosition)] = PointLocation(levelIndex, currentPointPosition);
+		}
+	}
+
+	void flushBuffer() {
+		BasicPointSet<Scalar> mergedPoints(dimension_);
+		for (int currentPointNumber = 0; currentPointNumber < buffer_.size(); ++currentPointNumber) {
+			mergedPoints.addPoint(buffer_.getPoint(currentPointNumber), buffer_.getIdentifier(currentPointNumber));
+		}
+		buffer_.resize(0);
+
+		int targetLevel = 0;
+		while (true) {
+			if (targetLevel == static_cast<int>(levels_.size())) {
+				levels_.push_back(TreeLevel());
+			}
+
+			TreeLevel &level = levels_[targetLevel];
+			if (level.isEmpty() && (mergedPoints.size() <= getLevelCapacity(targetLevel))) {
+				break;
+			}
+
+			if (!level.isEmpty()) {
+				collectLivePoints(level, &mergedPoints);
+				level.tree.reset();
+				level.removedPoints.clear();
+				level.removedPointsNumber = 0;
+			}
+			++targetLevel;
+		}
+
+		buildLevel(targetLevel, mergedPoints);
+	}
+
+	void removeFromBuffer(int position) {
+		int lastPosition = buffer_.size() - 1;
+		if (position != lastPosition) {
+			std::copy(buffer_.getPoint(lastPosition), buffer_.getPoint(lastPosition) + dimension_, buffer_.getPoint(position));
+			buffer_.setIdentifier(position, buffer_.getIdentifier(lastPosition));
+			locations_[buffer_.getIdentifier(position)] = PointLocation(BUFFER_LEVEL, position);
+		}
+		buffer_.resize(lastPosition);
+	}
+
+	void scanBuffer(const Scalar* point, Scalar &squaredDistance, int &identifier) const {
+		for (int currentPointNumber = 0; currentPointNumber < buffer_.size(); ++currentPointNumber) {
+			Scalar newDistance = distanceBetweenPoints<Dimension>(buffer_.getPoint(currentPointNumber), point, dimension_);
+			if (newDistance < squaredDistance) {
+				identifier = buffer_.getIdentifier(currentPointNumber);
+				squaredDistance = newDistance;
+			}
+		}
+	}
+
+public:
+	explicit BasicDynamicKDTree(int dimension) :
+		dimension_(Dimension == DYNAMIC_DIMENSION ? dimension : Dimension),
+		buffer_(dimension_) {
+
+		//do nothing
+	}
+
+	explicit BasicDynamicKDTree(const BasicPointSet<Scalar> &points) :
+		dimension_(points.getDimension()),
+		buffer_(dimension_) {
+
+		int levelIndex = 0;
+		while (getLevelCapacity(levelIndex) < points.size()) {
+			++levelIndex;
+		}
+
+		levels_.resize(levelIndex + 1);
+		buildLevel(levelIndex, points);
+	}
+
+	int getDimension() const {
+		return dimension_;
+	}
+
+	int size() const {
+		return locations_.size();
+	}
+
+	//a point with an identifier which is already present replaces the old one
+	void insert(const Scalar* point, int identifier) {
+		erase(identifier);
+
+		buffer_.addPoint(point, identifier);
+		locations_[identifier] = PointLocation(BUFFER_LEVEL, buffer_.size() - 1);
+
+		if (buffer_.size() >= DYNAMIC_KDTREE_BUFFER_SIZE) {
+			flushBuffer();
+		}
+	}
+
+	bool erase(int identifier) {
+		typename std::unordered_map<int, PointLocation>::iterator location = locations_.find(identifier);
+		if (location == locations_.end()) {
+			return false;
+		}
+
+		PointLocation pointLocation = location->second;
+		locations_.erase(location);
+
+		if (pointLocation.level == BUFFER_LEVEL) {
+			removeFromBuffer(pointLocation.position);
+			return true;
+		}
+
+		TreeLevel &level = levels_[pointLocation.level];
+		level.removedPoints[pointLocation.position] = 1;
+		++level.removedPointsNumber;
+
+		if (2 * level.removedPointsNumber > level.tree->getPointsNumber()) {
+			BasicPointSet<Scalar> livePoints(dimension_);
+			collectLivePoints(level, &livePoints);
+			buildLevel(pointLocation.level, livePoints);
+		}
+
+		return true;
+	}
+
+	//returns -1 when the tree is empty
+	int getMinDistanceIdentifier(const Scalar* point, double &distance) const {
+		Scalar squaredDistance = std::numeric_limits<Scalar>::max();
+		int resultIdentifier = -1;
+
+		scanBuffer(point, squaredDistance, resultIdentifier);
+		for (size_t currentLevel = 0; currentLevel < levels_.size(); ++currentLevel) {
+			if (!levels_[currentLevel].isEmpty()) {
+				levels_[currentLevel].tree->updateMinDistance(point, squaredDistance, resultIdentifier,
+					LivePointsFilter(&levels_[currentLevel].removedPoints));
+			}
+		}
+
+		distance = sqrt(static_cast<double>(squaredDistance));
+		return resultIdentifier;
+	}
+
+	void getKNearest(const Scalar* point, int k, std::vector<Neighbour> &neighbours) const {
+		neighbours.clear();
+		if (k <= 0) {
+			return;
+		}
+
+		for (int currentPointNumber = 0; currentPointNumber < buffer_.size(); ++currentPointNumber) {
+			Neighbour candidate(buffer_.getIdentifier(currentPointNumber),
+				distanceBetweenPoints<Dimension>(buffer_.getPoint(currentPointNumber), point, dimension_));
+
+			if (neighbours.size() < static_cast<size_t>(k)) {
+				neighbours.push_back(candidate);
+				std::push_heap(neighbours.begin(), neighbours.end());
+			} else if (candidate < neighbours.front()) {
+				std::pop_heap(neighbours.begin(), neighbours.end());
+				neighbours.back() = candidate;
+				std::push_heap(neighbours.begin(), neighbours.end());
+			}
+		}
+
+		for (size_t currentLevel = 0; currentLevel < levels_.size(); ++currentLevel) {
+			if (!levels_[currentLevel].isEmpty()) {
+				levels_[currentLevel].tree->updateKNearest(point, k, neighbours, LivePointsFilter(&levels_[currentLevel].removedPoints));
+			}
+		}
+
+		std::sort_heap(neighbours.begin(), neighbours.end());
+		for (size_t currentNeighbour = 0; currentNeighbour < neighbours.size(); ++currentNeighbour) {
+			neighbours[currentNeighbour].distance = sqrt(neighbours[currentNeighbour].distance);
+		}
+	}
+};
+
+typedef BasicDynamicKDTree<DYNAMIC_DIMENSION, double> DynamicKDTree;
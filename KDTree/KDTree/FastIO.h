@@ -0,0 +1,475 @@
+#pragma once
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+#include <string>
+#include <vector>
+
+#include "MappedFile.h"
+
+const size_t FAST_INPUT_BLOCK_SIZE = 1 << 20;
+const size_t FAST_OUTPUT_BUFFER_SIZE = 1 << 16;
+
+//answers are printed like an ostream with setprecision(FAST_OUTPUT_PRECISION) prints them
+const int FAST_OUTPUT_PRECISION = 15;
+
+const double FAST_POWERS_OF_TEN[] = {
+	1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+	1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+//reads whitespace separated numbers either from a mapped file or from a stream in large blocks
+class FastInput {
+private:
+	const char* current_;
+	const char* end_;
+
+	FILE* file_;
+	bool ownFile_;
+	std::vector<char> buffer_;
+	MappedFile mappedFile_;
+
+	FastInput(const FastInput &);
+	FastInput& operator=(const FastInput &);
+
+	//moves the unread tail to the beginning of the buffer and reads the next block after it,
+	//the buffer grows when the tail alone fills it
+	void refill() {
+		if (file_ == NULL) {
+			return;
+		}
+
+		size_t unreadSize = end_ - current_;
+		memmove(&buffer_[0], current_, unreadSize);
+		if (unreadSize == buffer_.size()) {
+			buffer_.resize(2 * buffer_.size());
+		}
+
+		size_t readSize = fread(&buffer_[unreadSize], 1, buffer_.size() - unreadSize, file_);
+		if (readSize == 0) {
+			closeFile();
+		}
+
+		current_ = &buffer_[0];
+		end_ = current_ + unreadSize + readSize;
+	}
+
+	void closeFile() {
+		if (ownFile_ && (file_ != NULL)) {
+			fclose(file_);
+		}
+		file_ = NULL;
+	}
+
+	static bool isSpace(char character) {
+		return (character == ' ') || (character == '\n') || (character == '\r') || (character == '\t') || (character == '\v') || (character == '\f');
+	}
+
+	static bool isDigit(char character) {
+		return (character >= '0') && (character <= '9');
+	}
+
+	//skips whitespace, returns false at the end of the input
+	bool prepareToken() {
+		while (true) {
+			while ((current_ < end_) && isSpace(*current_)) {
+				++current_;
+			}
+
+			if ((current_ < end_) || (file_ == NULL)) {
+				return current_ < end_;
+			}
+
+			refill();
+		}
+	}
+
+	//reads on until the whole token starting at current_ is in the buffer
+	const char* getTokenEnd() {
+		size_t tokenLength = 0;
+		while (true) {
+			while ((current_ + tokenLength < end_) && !isSpace(current_[tokenLength])) {
+				++tokenLength;
+			}
+
+			if ((current_ + tokenLength < end_) || (file_ == NULL)) {
+				return current_ + tokenLength;
+			}
+
+			refill();
+		}
+	}
+
+	//the same conversion operator>> uses, for the numbers the fast path can not round exactly
+	double parseSlowly(const char* tokenEnd) {
+		std::string token(current_, tokenEnd);
+		const char* tokenBegin = token.c_str();
+
+		char* parsedEnd = NULL;
+		double value = strtod(tokenBegin, &parsedEnd);
+		current_ += (parsedEnd == tokenBegin ? token.size() : parsedEnd - tokenBegin);
+		return value;
+	}
+
+public:
+	explicit FastInput(FILE* file) :
+		current_(NULL),
+		end_(NULL),
+		file_(file),
+		ownFile_(false),
+		buffer_(FAST_INPUT_BLOCK_SIZE) {
+
+		current_ = end_ = &buffer_[0];
+	}
+
+	//maps the whole file, if it can not be mapped it is read in blocks
+	explicit FastInput(const std::string &path) :
+		current_(NULL),
+		end_(NULL),
+		file_(NULL),
+		ownFile_(true) {
+
+		if (mappedFile_.open(path.c_str())) {
+			current_ = mappedFile_.data();
+			end_ = current_ + mappedFile_.size();
+			return;
+		}
+
+		file_ = fopen(path.c_str(), "rb");
+		buffer_.resize(FAST_INPUT_BLOCK_SIZE);
+		current_ = end_ = &buffer_[0];
+	}
+
+	~FastInput() {
+		closeFile();
+	}
+
+	bool readInt(int &value) {
+		if (!prepareToken()) {
+			return false;
+		}
+
+		const char* tokenEnd = getTokenEnd();
+		bool negative = (*current_ == '-');
+		const char* position = current_ + ((*current_ == '-') || (*current_ == '+') ? 1 : 0);
+		if ((position == tokenEnd) || !isDigit(*position)) {
+			return false;
+		}
+
+		long long result = 0;
+		while ((position < tokenEnd) && isDigit(*position)) {
+			result = result * 10 + (*position - '0');
+			++position;
+		}
+
+		current_ = position;
+		value = static_cast<int>(negative ? -result : result);
+		return true;
+	}
+
+	//numbers with at most 15 significant digits and a small exponent are converted with one exactly rounded
+	//multiplication or division, the others go through strtod, so the result is always the correctly rounded one
+	bool readDouble(double &value) {
+		if (!prepareToken()) {
+			return false;
+		}
+
+		const char* tokenEnd = getTokenEnd();
+		const char* position = current_;
+		bool negative = (*position == '-');
+		if ((*position == '-') || (*position == '+')) {
+			++position;
+		}
+
+		unsigned long long mantissa = 0;
+		int digitsNumber = 0;
+		int exponent = 0;
+		bool hasDigits = false;
+
+		while ((position < tokenEnd) && isDigit(*position)) {
+			if ((mantissa != 0) || (*position != '0')) {
+				mantissa = mantissa * 10 + (*position - '0');
+				++digitsNumber;
+			}
+			hasDigits = true;
+			++position;
+			if (digitsNumber > 15) {
+				break;
+			}
+		}
+
+		if ((digitsNumber <= 15) && (position < tokenEnd) && (*position == '.')) {
+			++position;
+			while ((position < tokenEnd) && isDigit(*position) && (digitsNumber <= 15)) {
+				if ((mantissa != 0) || (*position != '0')) {
+					mantissa = mantissa * 10 + (*position - '0');
+					++digitsNumber;
+				}
+				hasDigits = true;
+				--exponent;
+				++position;
+			}
+		}
+
+		if (hasDigits && (digitsNumber <= 15) && (position < tokenEnd) && ((*position == 'e') || (*position == 'E'))) {
+			const char* exponentPosition = position + 1;
+			bool negativeExponent = (exponentPosition < tokenEnd) && (*exponentPosition == '-');
+			if ((exponentPosition < tokenEnd) && ((*exponentPosition == '-') || (*exponentPosition == '+'))) {
+				++exponentPosition;
+			}
+
+			int exponentValue = 0;
+			const char* firstExponentDigit = exponentPosition;
+			while ((exponentPosition < tokenEnd) && isDigit(*exponentPosition) && (exponentValue < 10000)) {
+				exponentValue = exponentValue * 10 + (*exponentPosition - '0');
+				++exponentPosition;
+			}
+
+			if (exponentPosition != firstExponentDigit) {
+				exponent += (negativeExponent ? -exponentValue : exponentValue);
+				position = exponentPosition;
+			}
+		}
+
+		bool fastPath = hasDigits && (digitsNumber <= 15) && (exponent >= -22) && (exponent <= 22)
+			&& ((position == tokenEnd) || !(isDigit(*position) || (*position == '.') || (*position == 'e') || (*position == 'E')));
+
+		if (!fastPath) {
+			value = parseSlowly(tokenEnd);
+			return true;
+		}
+
+		double result = static_cast<double>(mantissa);
+		if (exponent < 0) {
+			result /= FAST_POWERS_OF_TEN[-exponent];
+		} else {
+			result *= FAST_POWERS_OF_TEN[exponent];
+		}
+
+		current_ = position;
+		value = (negative ? -result : result);
+		return true;
+	}
+};
+
+//collects the output in a buffer which is written with one call when it is full
+class FastOutput {
+private:
+	FILE* file_;
+	std::vector<char> buffer_;
+	size_t size_;
+
+	FastOutput(const FastOutput &);
+	FastOutput& operator=(const FastOutput &);
+
+	void reserve(size_t charactersNumber) {
+		if (size_ + charactersNumber > buffer_.size()) {
+			flush();
+		}
+	}
+
+	//high and low halves of the full product of two 64-bit numbers
+	static void multiplyWide(unsigned long long first, unsigned long long second, unsigned long long &high, unsigned long long &low) {
+		const unsigned long long LOW_MASK = 0xFFFFFFFFULL;
+		unsigned long long lowLow = (first & LOW_MASK) * (second & LOW_MASK);
+		unsigned long long highLow = (first >> 32) * (second & LOW_MASK);
+		unsigned long long lowHigh = (first & LOW_MASK) * (second >> 32);
+		unsigned long long highHigh = (first >> 32) * (second >> 32);
+
+		unsigned long long middle = (lowLow >> 32) + (highLow & LOW_MASK) + (lowHigh & LOW_MASK);
+		low = (middle << 32) | (lowLow & LOW_MASK);
+		high = highHigh + (highLow >> 32) + (lowHigh >> 32) + (middle >> 32);
+	}
+
+	static bool getWideBit(unsigned long long high, unsigned long long low, int bit) {
+		return ((bit < 64 ? low >> bit : high >> (bit - 64)) & 1) != 0;
+	}
+
+	//true when any of the bits below the given one is set
+	static bool hasLowerBits(unsigned long long high, unsigned long long low, int bit) {
+		if (bit <= 64) {
+			return (bit == 64 ? low : low & ((1ULL << bit) - 1)) != 0;
+		}
+		return (low != 0) || ((high & ((1ULL << (bit - 64)) - 1)) != 0);
+	}
+
+	//rounds value * 10^scale to an integer exactly, value is mantissa * 2^binaryExponent with a 53-bit mantissa;
+	//returns false for an exact tie, whose rounding is left to the C library
+	static bool getScaledDigits(unsigned long long mantissa, int binaryExponent, int scale, unsigned long long &digits) {
+		unsigned long long powerOfFive = 1;
+		for (int currentPower = 0; currentPower < scale; ++currentPower) {
+			powerOfFive *= 5;
+		}
+
+		unsigned long long high, low;
+		multiplyWide(mantissa, powerOfFive, high, low);
+
+		int shift = -(binaryExponent + scale);
+		if ((shift <= 0) || (shift >= 128)) {
+			return false;
+		}
+
+		digits = (shift < 64 ? (low >> shift) | (high << (64 - shift)) : high >> (shift - 64));
+		if (getWideBit(high, low, shift - 1)) {
+			if (!hasLowerBits(high, low, shift - 1)) {
+				return false;
+			}
+			++digits;
+		}
+
+		return true;
+	}
+
+	//writes the 15 significant digits of a positive value whose decimal exponent is in [-4, 14],
+	//where %g uses the fixed notation; the digits are computed exactly with integer arithmetic
+	bool writeFixedDouble(double value) {
+		int binaryExponent = 0;
+		unsigned long long mantissa = static_cast<unsigned long long>(ldexp(frexp(value, &binaryExponent), 53));
+		binaryExponent -= 53;
+
+		int exponent = 0;
+		while ((exponent < FAST_OUTPUT_PRECISION - 1) && (value >= FAST_POWERS_OF_TEN[exponent + 1])) {
+			++exponent;
+		}
+		while ((exponent <= 0) && (exponent > -4) && (value * FAST_POWERS_OF_TEN[-exponent] < 1)) {
+			--exponent;
+		}
+
+		const unsigned long long MIN_DIGITS = static_cast<unsigned long long>(FAST_POWERS_OF_TEN[FAST_OUTPUT_PRECISION - 1]);
+		const unsigned long long MAX_DIGITS = static_cast<unsigned long long>(FAST_POWERS_OF_TEN[FAST_OUTPUT_PRECISION]);
+		unsigned long long digits = 0;
+
+		//the estimate of the exponent may be one off near powers of ten
+		for (int currentAttempt = 0; currentAttempt < 2; ++currentAttempt) {
+			if (!getScaledDigits(mantissa, binaryExponent, FAST_OUTPUT_PRECISION - 1 - exponent, digits)) {
+				return false;
+			}
+
+			if ((digits < MIN_DIGITS) && (exponent > -4)) {
+				--exponent;
+			} else if ((digits >= MAX_DIGITS) && (exponent < FAST_OUTPUT_PRECISION - 1) && (digits != MAX_DIGITS)) {
+				++exponent;
+			} else {
+				break;
+			}
+		}
+
+		//a value rounded up to the next power of ten
+		if (digits == MAX_DIGITS) {
+			digits = MIN_DIGITS;
+			++exponent;
+		}
+
+		if ((digits < MIN_DIGITS) || (digits >= MAX_DIGITS) || (exponent > FAST_OUTPUT_PRECISION - 1)) {
+			return false;
+		}
+
+		char digitCharacters[FAST_OUTPUT_PRECISION];
+		for (int currentDigit = FAST_OUTPUT_PRECISION - 1; currentDigit >= 0; --currentDigit) {
+			digitCharacters[currentDigit] = static_cast<char>('0' + digits % 10);
+			digits /= 10;
+		}
+
+		int significantDigitsNumber = FAST_OUTPUT_PRECISION;
+		while ((significantDigitsNumber > 1) && (digitCharacters[significantDigitsNumber - 1] == '0')) {
+			--significantDigitsNumber;
+		}
+
+		if (exponent >= 0) {
+			int currentDigit = 0;
+			for (; currentDigit <= exponent; ++currentDigit) {
+				buffer_[size_++] = digitCharacters[currentDigit];
+			}
+			if (significantDigitsNumber > exponent + 1) {
+				buffer_[size_++] = '.';
+				for (; currentDigit < significantDigitsNumber; ++currentDigit) {
+					buffer_[size_++] = digitCharacters[currentDigit];
+				}
+			}
+		} else {
+			buffer_[size_++] = '0';
+			buffer_[size_++] = '.';
+			for (int currentZero = 1; currentZero < -exponent; ++currentZero) {
+				buffer_[size_++] = '0';
+			}
+			for (int currentDigit = 0; currentDigit < significantDigitsNumber; ++currentDigit) {
+				buffer_[size_++] = digitCharacters[currentDigit];
+			}
+		}
+
+		return true;
+	}
+
+public:
+	explicit FastOutput(FILE* file) :
+		file_(file),
+		buffer_(FAST_OUTPUT_BUFFER_SIZE),
+		size_(0) {
+
+		//do nothing
+	}
+
+	~FastOutput() {
+		flush();
+	}
+
+	void flush() {
+		if (size_ > 0) {
+			fwrite(&buffer_[0], 1, size_, file_);
+			size_ = 0;
+		}
+		fflush(file_);
+	}
+
+	void writeChar(char character) {
+		reserve(1);
+		buffer_[size_++] = character;
+	}
+
+	void writeInt(int value) {
+		reserve(16);
+
+		unsigned int absoluteValue = (value < 0 ? 0u - static_cast<unsigned int>(value) : static_cast<unsigned int>(value));
+		if (value < 0) {
+			buffer_[size_++] = '-';
+		}
+
+		char digitCharacters[16];
+		int digitsNumber = 0;
+		do {
+			digitCharacters[digitsNumber++] = static_cast<char>('0' + absoluteValue % 10);
+			absoluteValue /= 10;
+		} while (absoluteValue != 0);
+
+		while (digitsNumber > 0) {
+			buffer_[size_++] = digitCharacters[--digitsNumber];
+		}
+	}
+
+	void writeDouble(double value) {
+		reserve(32);
+
+		if (value == 0) {
+			if (std::signbit(value)) {
+				buffer_[size_++] = '-';
+			}
+			buffer_[size_++] = '0';
+			return;
+		}
+
+		size_t savedSize = size_;
+		double absoluteValue = fabs(value);
+		if ((absoluteValue >= 1e-4) && (absoluteValue < FAST_POWERS_OF_TEN[FAST_OUTPUT_PRECISION])) {
+			if (value < 0) {
+				buffer_[size_++] = '-';
+			}
+			if (writeFixedDouble(absoluteValue)) {
+				return;
+			}
+		}
+
+		size_ = savedSize;
+		size_ += snprintf(&buffer_[size_], buffer_.size() - size_, "%.*g", FAST_OUTPUT_PRECISION, value);
+	}
+};
@@ -0,0 +1,543 @@
+#pragma once
+#include <vector>
+#include <cmath>
+#include <algorithm>
+#include <limits>
+#include <random>
+#include <functional>
+
+#include "KDTree.h"
+
+const int DEFAULT_KDFOREST_TREES_NUMBER = 4;
+//the split coordinate of a node is drawn among this many coordinates of the largest variance
+const int DEFAULT_KDFOREST_SPLIT_CANDIDATES_NUMBER = 5;
+//the variances are estimated over at most this many points of the node
+const int KDFOREST_VARIANCE_SAMPLE_SIZE = 100;
+const unsigned int DEFAULT_KDFOREST_SEED = 2015;
+
+struct KDForestBuildParameters {
+	//when set, the trees are built as separate tasks of the pool
+	ThreadPool* threadPool;
+	int treesNumber;
+	//nodes of at most leafSize points are not split
+	int leafSize;
+	int splitCandidatesNumber;
+	//when set, every tree splits the points turned by a random rotation of its own, so the trees
+	//differ even when only a few coordinates have a large variance
+	bool rotate;
+	//tree number t draws its splits from seed + t, so the forest does not depend on the order of the build
+	unsigned int seed;
+
+	KDForestBuildParameters() :
+		threadPool(NULL),
+		treesNumber(DEFAULT_KDFOREST_TREES_NUMBER),
+		leafSize(DEFAULT_LEAF_SIZE),
+		splitCandidatesNumber(DEFAULT_KDFOREST_SPLIT_CANDIDATES_NUMBER),
+		rotate(false),
+		seed(DEFAULT_KDFOREST_SEED) {
+
+		//do nothing
+	}
+};
+
+//randomized kd-trees over a single copy of the points (Silpa-Anan and Hartley): the trees differ in the split
+//coordinates drawn at random and, optionally, in a random rotation of the space, and keep only their nodes and
+//the order of the points; a search walks all of them with one queue of pending cells ordered by distance,
+//so a leaf budget is spent on the closest cells of whichever tree holds them
+template <int Dimension, typename Scalar>
+class BasicKDForest {
+private:
+	static const int NO_CHILD = -1;
+	static const int NO_OFFSET_CHANGE = -1;
+
+	//the same split as in the nodes of BasicKDTree, along a rotated coordinate when the tree is rotated
+	struct ForestNode {
+		int leftChild;
+		int rightChild;
+		int firstPoint;
+		int lastPoint;
+		int splitCoordinate;
+		Scalar leftUpperBorder;
+		Scalar rightLowerBorder;
+
+		ForestNode() :
+			leftChild(NO_CHILD),
+			rightChild(NO_CHILD),
+			firstPoint(0),
+			lastPoint(0),
+			splitCoordinate(0),
+			leftUpperBorder(0),
+			rightLowerBorder(0) {
+
+			//do nothing
+		}
+
+		bool isLeaf() const {
+			return leftChild == NO_CHILD;
+		}
+	};
+
+	//nodes are stored in preorder, the points of every subtree are the range [firstPoint, lastPoint) of pointNumbers,
+	//which holds numbers of the points of the forest
+	struct RandomizedTree {
+		std::vector<ForestNode> nodes;
+		std::vector<int> pointNumbers;
+		//row-major orthogonal matrix, empty when the tree is not rotated
+		std::vector<Scalar> rotation;
+	};
+
+	//a subtree waiting to be built, the left child always follows its parent, so only right children are linked
+	//to the parent when they are built
+	struct BuildTask {
+		int parentIndex;
+		int firstPoint;
+		int lastPoint;
+
+		BuildTask(int newParentIndex, int newFirstPoint, int newLastPoint) :
+			parentIndex(newParentIndex),
+			firstPoint(newFirstPoint),
+			lastPoint(newLastPoint) {
+
+			//do nothing
+		}
+	};
+
+	//a cell waiting in the queue of a search; its squared offsets differing from zero are the latest changes
+	//of every coordinate on the chain from lastChange back to the root
+	struct PendingCell {
+		Scalar cellDistance;
+		int treeNumber;
+		int nodeIndex;
+		int lastChange;
+
+		PendingCell(Scalar newCellDistance, int newTreeNumber, int newNodeIndex, int newLastChange) :
+			cellDistance(newCellDistance),
+			treeNumber(newTreeNumber),
+			nodeIndex(newNodeIndex),
+			lastChange(newLastChange) {
+
+			//do nothing
+		}
+
+		bool operator>(const PendingCell &other) const {
+			return cellDistance > other.cellDistance;
+		}
+	};
+
+	struct OffsetChange {
+		int coordinate;
+		Scalar offset;
+		int previousChange;
+
+		OffsetChange(int newCoordinate, Scalar newOffset, int newPreviousChange) :
+			coordinate(newCoordinate),
+			offset(newOffset),
+			previousChange(newPreviousChange) {
+
+			//do nothing
+		}
+	};
+
+	int dimension_;
+	int leafSize_;
+	BasicPointSet<Scalar> points_;
+	std::vector<RandomizedTree> trees_;
+
+	BasicKDForest(const BasicKDForest &);
+	BasicKDForest& operator=(const BasicKDForest &);
+
+	//Gram-Schmidt over rows of normally distributed values
+	void getRandomRotation(std::default_random_engine &engine, std::vector<Scalar> &rotation) const {
+		std::normal_distribution<> normalGenerator(0, 1);
+		int dimension = getDimension();
+		std::vector<double> rows(dimension * dimension);
+
+		for (int currentRow = 0; currentRow < dimension; ++currentRow) {
+			double* row = &rows[currentRow * dimension];
+			double norm = 0;
+
+			while (norm < EPS) {
+				for (int currentCoordinate = 0; currentCoordinate < dimension; ++currentCoordinate) {
+					row[currentCoordinate] = normalGenerator(engine);
+				}
+
+				for (int previousRow = 0; previousRow < currentRow; ++previousRow) {
+					const double* otherRow = &rows[previousRow * dimension];
+					double product = 0;
+					for (int currentCoordinate = 0; currentCoordinate < dimension; ++currentCoordinate) {
+						product += row[currentCoordinate] * otherRow[currentCoordinate];
+					}
+					for (int currentCoordinate = 0; currentCoordinate < dimension; ++currentCoordinate) {
+						row[currentCoordinate] -= product * otherRow[currentCoordinate];
+					}
+				}
+
+				norm = 0;
+				for (int currentCoordinate = 0; currentCoordinate < dimension; ++currentCoordinate) {
+					norm += row[currentCoordinate] * row[currentCoordinate];
+				}
+				norm = sqrt(norm);
+			}
+
+			for (int currentCoordinate = 0; currentCoordinate < dimension; ++currentCoordinate) {
+				row[currentCoordinate] /= norm;
+			}
+		}
+
+		rotation.assign(rows.begin(), rows.end());
+	}
+
+	Scalar getRotatedCoordinate(const std::vector<Scalar> &rotation, const Scalar* point, int coordinate) const {
+		const Scalar* row = &rotation[coordinate * getDimension()];
+		Scalar product = 0;
+		for (int currentCoordinate = 0; currentCoordinate < getDimension(); ++currentCoordinate) {
+			product += row[currentCoordinate] * point[currentCoordinate];
+		}
+		return product;
+	}
+
+	void rotatePoint(const std::vector<Scalar> &rotation, const Scalar* point, Scalar* rotatedPoint) const {
+		for (int currentRow = 0; currentRow < getDimension(); ++currentRow) {
+			rotatedPoint[currentRow] = getRotatedCoordinate(rotation, point, currentRow);
+		}
+	}
+
+	//the coordinate of a point of the forest in the space of the tree
+	Scalar getTreeCoordinate(const RandomizedTree &tree, int pointNumber, int coordinate) const {
+		const Scalar* point = points_.getPoint(pointNumber);
+		return (tree.rotation.empty() ? point[coordinate] : getRotatedCoordinate(tree.rotation, point, coordinate));
+	}
+
+	//a coordinate drawn uniformly among the splitCandidatesNumber ones of the largest variance over a sample of the node,
+	//only the sampled points are rotated
+	int getRandomSplitCoordinate(const RandomizedTree &tree, int firstPoint, int lastPoint, int splitCandidatesNumber, 
+		std::default_random_engine &engine) const {
+
+		int sampleStep = std::max(1, (lastPoint - firstPoint) / KDFOREST_VARIANCE_SAMPLE_SIZE);
+		std::vector<double> sums(getDimension(), 0), squaredSums(getDimension(), 0);
+		std::vector<Scalar> rotatedPoint(tree.rotation.empty() ? 0 : getDimension());
+		int sampleSize = 0;
+
+		for (int currentPointPosition = firstPoint; currentPointPosition < lastPoint; currentPointPosition += sampleStep) {
+			const Scalar* point = points_.getPoint(tree.pointNumbers[currentPointPosition]);
+			if (!tree.rotation.empty()) {
+				rotatePoint(tree.rotation, point, &rotatedPoint[0]);
+				point = &rotatedPoint[0];
+			}
+
+			for (int currentCoordinate = 0; currentCoordinate < getDimension(); ++currentCoordinate) {
+				sums[currentCoordinate] += point[currentCoordinate];
+				squaredSums[currentCoordinate] += static_cast<double>(point[currentCoordinate]) * point[currentCoordinate];
+			}
+			++sampleSize;
+		}
+
+		std::vector<std::pair<double, int> > variances(getDimension());
+		for (int currentCoordinate = 0; currentCoordinate < getDimension(); ++currentCoordinate) {
+			double mean = sums[currentCoordinate] / sampleSize;
+			variances[currentCoordinate] = std::make_pair(squaredSums[currentCoordinate] / sampleSize - mean * mean, currentCoordinate);
+		}
+
+		int candidatesNumber = std::max(1, std::min(splitCandidatesNumber, getDimension()));
+		std::partial_sort(variances.begin(), variances.begin() + candidatesNumber, variances.end(), std::greater<std::pair<double, int> >());
+		std::uniform_int_distribution<int> candidateGenerator(0, candidatesNumber - 1);
+
+		return variances[candidateGenerator(engine)].second;
+	}
+
+	//median splits, so every tree is balanced whatever coordinates are drawn
+	void buildTree(int treeNumber, const KDForestBuildParameters &parameters, RandomizedTree &tree) const {
+		std::default_random_engine engine(parameters.seed + treeNumber);
+		if (parameters.rotate) {
+			getRandomRotation(engine, tree.rotation);
+		}
+
+		//a node projects its points on the split coordinate into splitValues, indexed by point number,
+		//so a rotated tree never keeps more than one rotated coordinate of every point
+		std::vector<Scalar> splitValues(getPointsNumber());
+
+		tree.pointNumbers.resize(getPointsNumber());
+		for (int currentPointNumber = 0; currentPointNumber < getPointsNumber(); ++currentPointNumber) {
+			tree.pointNumbers[currentPointNumber] = currentPointNumber;
+		}
+
+		std::vector<BuildTask> buildTasks(1, BuildTask(NO_CHILD, 0, getPointsNumber()));
+		while (!buildTasks.empty()) {
+			BuildTask task = buildTasks.back();
+			buildTasks.pop_back();
+
+			int nodeIndex = tree.nodes.size();
+			tree.nodes.push_back(ForestNode());
+			tree.nodes[nodeIndex].firstPoint = task.firstPoint;
+			tree.nodes[nodeIndex].lastPoint = task.lastPoint;
+			if (task.parentIndex != NO_CHILD) {
+				tree.nodes[task.parentIndex].rightChild = nodeIndex;
+			}
+
+			if (task.lastPoint - task.firstPoint <= leafSize_) {
+				continue;
+			}
+
+			int coordinate = getRandomSplitCoordinate(tree, task.firstPoint, task.lastPoint, parameters.splitCandidatesNumber, engine);
+			int middlePoint = task.firstPoint + (task.lastPoint - task.firstPoint) / 2;
+			for (int currentPointPosition = task.firstPoint; currentPointPosition < task.lastPoint; ++currentPointPosition) {
+				int pointNumber = tree.pointNumbers[currentPointPosition];
+				splitValues[pointNumber] = getTreeCoordinate(tree, pointNumber, coordinate);
+			}
+
+			//ties are broken by number, so the halves do not depend on the library
+			const Scalar* values = &splitValues[0];
+			std::nth_element(tree.pointNumbers.begin() + task.firstPoint, tree.pointNumbers.begin() + middlePoint,
+				tree.pointNumbers.begin() + task.lastPoint, [values](int firstPoint, int secondPoint) {
+
+				return (values[firstPoint] < values[secondPoint]) || ((values[firstPoint] == values[secondPoint]) && (firstPoint < secondPoint));
+			});
+
+			ForestNode &node = tree.nodes[nodeIndex];
+			node.leftChild = nodeIndex + 1;
+			node.splitCoordinate = coordinate;
+			node.rightLowerBorder = splitValues[tree.pointNumbers[middlePoint]];
+			node.leftUpperBorder = splitValues[tree.pointNumbers[task.firstPoint]];
+			for (int currentPointPosition = task.firstPoint + 1; currentPointPosition < middlePoint; ++currentPointPosition) {
+				node.leftUpperBorder = std::max(node.leftUpperBorder, splitValues[tree.pointNumbers[currentPointPosition]]);
+			}
+
+			//the left half is popped first, so it is stored right after its parent
+			buildTasks.push_back(BuildTask(nodeIndex, middlePoint, task.lastPoint));
+			buildTasks.push_back(BuildTask(NO_CHILD, task.firstPoint, middlePoint));
+		}
+	}
+
+	void initialize(const BasicPointSet<Scalar> &sourcePoints, const KDForestBuildParameters &parameters) {
+		assert((Dimension == DYNAMIC_DIMENSION) || (sourcePoints.size() == 0) || (sourcePoints.getDimension() == Dimension));
+		assert((parameters.treesNumber > 0) && (parameters.leafSize > 0));
+
+		points_ = sourcePoints;
+		dimension_ = (Dimension == DYNAMIC_DIMENSION ? sourcePoints.getDimension() : Dimension);
+		leafSize_ = parameters.leafSize;
+		trees_.resize(points_.size() == 0 ? 0 : parameters.treesNumber);
+
+		if (parameters.threadPool == NULL) {
+			for (size_t currentTree = 0; currentTree < trees_.size(); ++currentTree) {
+				buildTree(currentTree, parameters, trees_[currentTree]);
+			}
+			return;
+		}
+
+		parallelFor(*parameters.threadPool, 0, trees_.size(), 1, [&](int firstTree, int lastTree) {
+			for (int currentTree = firstTree; currentTree < lastTree; ++currentTree) {
+				buildTree(currentTree, parameters, trees_[currentTree]);
+			}
+		});
+	}
+
+	//the offsets of the children along the split coordinate, as in BasicKDTree
+	static bool getChildOffsets(const ForestNode &node, const Scalar* point, Scalar parentOffset, Scalar &nearOffset, Scalar &farOffset) {
+		Scalar pointCoordinate = point[node.splitCoordinate];
+		Scalar leftDifference = pointCoordinate - node.leftUpperBorder;
+		Scalar rightDifference = node.rightLowerBorder - pointCoordinate;
+		bool leftIsNear = (leftDifference < rightDifference);
+
+		if (leftIsNear) {
+			nearOffset = (leftDifference > 0 ? leftDifference * leftDifference : parentOffset);
+			farOffset = (rightDifference > 0 ? rightDifference * rightDifference : parentOffset);
+		} else {
+			nearOffset = (rightDifference > 0 ? rightDifference * rightDifference : parentOffset);
+			farOffset = (leftDifference > 0 ? leftDifference * leftDifference : parentOffset);
+		}
+
+		return leftIsNear;
+	}
+
+	//best-bin-first search over all trees: the cell distances are exact, every cell keeps only the offset it changed
+	//and the offsets of a popped cell are gathered from its chain of changes, marked with the number of the cell;
+	//leafScanner(tree, leaf) looks at the points of a leaf and getBound() is the squared distance a cell has to beat;
+	//returns false when a cell which might hold a closer point was skipped
+	template <typename LeafScanner, typename BoundGetter>
+	bool searchTrees(const Scalar* point, const ApproximateSearchParameters &parameters, const LeafScanner &leafScanner,
+		const BoundGetter &getBound) const {
+
+		int dimension = getDimension();
+		std::vector<Scalar> rotatedPoints(trees_.size() * dimension);
+		std::vector<Scalar> offsets(dimension, 0);
+		std::vector<int> offsetCells(dimension, -1);
+		std::vector<OffsetChange> offsetChanges;
+		std::vector<PendingCell> pendingCells;
+		pendingCells.reserve(64);
+
+		Scalar pruningFactor = static_cast<Scalar>((1 + parameters.epsilon) * (1 + parameters.epsilon));
+		int leavesNumber = 0;
+		bool exact = true;
+
+		//every tree is descended once before the queue decides, their roots are all at distance zero
+		for (size_t currentTree = 0; currentTree < trees_.size(); ++currentTree) {
+			if (!trees_[currentTree].rotation.empty()) {
+				rotatePoint(trees_[currentTree].rotation, point, &rotatedPoints[currentTree * dimension]);
+			}
+			pendingCells.push_back(PendingCell(0, currentTree, 0, NO_OFFSET_CHANGE));
+		}
+
+		for (int currentCell = 0; !pendingCells.empty(); ++currentCell) {
+			std::pop_heap(pendingCells.begin(), pendingCells.end(), std::greater<PendingCell>());
+			PendingCell cell = pendingCells.back();
+			pendingCells.pop_back();
+
+			if (cell.cellDistance >= getBound()) {
+				break;
+			}
+
+			if ((cell.cellDistance * pruningFactor >= getBound())
+				|| ((parameters.maxLeavesNumber > 0) && (leavesNumber >= parameters.maxLeavesNumber))) {
+
+				exact = false;
+				break;
+			}
+
+			for (int currentChange = cell.lastChange; currentChange != NO_OFFSET_CHANGE; currentChange = offsetChanges[currentChange].previousChange) {
+				const OffsetChange &change = offsetChanges[currentChange];
+				if (offsetCells[change.coordinate] != currentCell) {
+					offsetCells[change.coordinate] = currentCell;
+					offsets[change.coordinate] = change.offset;
+				}
+			}
+
+			const RandomizedTree &tree = trees_[cell.treeNumber];
+			const Scalar* treePoint = (tree.rotation.empty() ? point : &rotatedPoints[cell.treeNumber * dimension]);
+			Scalar cellDistance = cell.cellDistance;
+			int lastChange = cell.lastChange;
+			int nodeIndex = cell.nodeIndex;
+
+			while (!tree.nodes[nodeIndex].isLeaf()) {
+				const ForestNode &node = tree.nodes[nodeIndex];
+				Scalar parentOffset = (offsetCells[node.splitCoordinate] == currentCell ? offsets[node.splitCoordinate] : 0);
+				Scalar nearOffset, farOffset;
+				bool leftIsNear = getChildOffsets(node, treePoint, parentOffset, nearOffset, farOffset);
+
+				Scalar farCellDistance = cellDistance - parentOffset + farOffset;
+				if (farCellDistance * pruningFactor < getBound()) {
+					offsetChanges.push_back(OffsetChange(node.splitCoordinate, farOffset, lastChange));
+					pendingCells.push_back(PendingCell(farCellDistance, cell.treeNumber, (leftIsNear ? node.rightChild : node.leftChild),
+						offsetChanges.size() - 1));
+					std::push_heap(pendingCells.begin(), pendingCells.end(), std::greater<PendingCell>());
+				} else if (farCellDistance < getBound()) {
+					exact = false;
+				}
+
+				if (nearOffset != parentOffset) {
+					offsetChanges.push_back(OffsetChange(node.splitCoordinate, nearOffset, lastChange));
+					lastChange = offsetChanges.size() - 1;
+					offsetCells[node.splitCoordinate] = currentCell;
+					offsets[node.splitCoordinate] = nearOffset;
+					cellDistance += nearOffset - parentOffset;
+				}
+
+				nodeIndex = (leftIsNear ? node.leftChild : node.rightChild);
+			}
+
+			leafScanner(tree, tree.nodes[nodeIndex]);
+			++leavesNumber;
+		}
+
+		return exact;
+	}
+
+public:
+	BasicKDForest(const BasicPointSet<Scalar> &points) {
+		initialize(points, KDForestBuildParameters());
+	}
+
+	BasicKDForest(const BasicPointSet<Scalar> &points, const KDForestBuildParameters &parameters) {
+		initialize(points, parameters);
+	}
+
+	int getDimension() const {
+		return (Dimension == DYNAMIC_DIMENSION ? dimension_ : Dimension);
+	}
+
+	int getPointsNumber() const {
+		return points_.size();
+	}
+
+	int getTreesNumber() const {
+		return trees_.size();
+	}
+
+	//bytes taken by the shared points and by the nodes, point orders and rotations of all trees
+	size_t getMemoryUsage() const {
+		size_t memoryUsage = static_cast<size_t>(points_.size()) * (points_.getStride() * sizeof(Scalar) + sizeof(int));
+		for (size_t currentTree = 0; currentTree < trees_.size(); ++currentTree) {
+			memoryUsage += trees_[currentTree].nodes.size() * sizeof(ForestNode) + trees_[currentTree].pointNumbers.size() * sizeof(int)
+				+ trees_[currentTree].rotation.size() * sizeof(Scalar);
+		}
+		return memoryUsage;
+	}
+
+	//at most parameters.maxLeavesNumber leaves are checked over all trees, zero means no limit; without a limit
+	//and epsilon the search is exact; exact is false when a cell which might hold a closer point was skipped
+	int getApproximateMinDistanceIdentifier(const Scalar* point, double &distance, const ApproximateSearchParameters &parameters, bool &exact) const {
+		Scalar squaredDistance = std::numeric_limits<Scalar>::max();
+		int resultIdentifier = -1;
+
+		exact = searchTrees(point, parameters, [&](const RandomizedTree &tree, const ForestNode &leaf) {
+			for (int currentPointPosition = leaf.firstPoint; currentPointPosition < leaf.lastPoint; ++currentPointPosition) {
+				int pointNumber = tree.pointNumbers[currentPointPosition];
+				Scalar newDistance = distanceBetweenPoints<Dimension, Scalar>(points_.getPoint(pointNumber), point, getDimension());
+				if (newDistance < squaredDistance + EPS) {
+					resultIdentifier = points_.getIdentifier(pointNumber);
+					squaredDistance = newDistance;
+				}
+			}
+		}, [&]() {
+			return squaredDistance;
+		});
+
+		distance = sqrt(static_cast<double>(squaredDistance));
+		return resultIdentifier;
+	}
+
+	//fills neighbours with at most k points sorted by distance, a point met again in another tree is added once
+	void getApproximateKNearest(const Scalar* point, int k, std::vector<Neighbour> &neighbours, const ApproximateSearchParameters &parameters,
+		bool &exact) const {
+
+		neighbours.clear();
+		exact = true;
+		if (k <= 0) {
+			return;
+		}
+
+		size_t neighboursNumber = k;
+		exact = searchTrees(point, parameters, [&](const RandomizedTree &tree, const ForestNode &leaf) {
+			for (int currentPointPosition = leaf.firstPoint; currentPointPosition < leaf.lastPoint; ++currentPointPosition) {
+				int pointNumber = tree.pointNumbers[currentPointPosition];
+				Neighbour candidate(points_.getIdentifier(pointNumber),
+					distanceBetweenPoints<Dimension, Scalar>(points_.getPoint(pointNumber), point, getDimension()));
+
+				bool isFull = (neighbours.size() == neighboursNumber);
+				if ((isFull && !(candidate < neighbours.front()))
+					|| (std::find_if(neighbours.begin(), neighbours.end(), [&candidate](const Neighbour &neighbour) {
+						return (neighbour.identifier == candidate.identifier) && (neighbour.distance == candidate.distance);
+					}) != neighbours.end())) {
+
+					continue;
+				}
+
+				if (isFull) {
+					std::pop_heap(neighbours.begin(), neighbours.end());
+					neighbours.back() = candidate;
+				} else {
+					neighbours.push_back(candidate);
+				}
+				std::push_heap(neighbours.begin(), neighbours.end());
+			}
+		}, [&]() {
+			return (neighbours.size() < neighboursNumber ? std::numeric_limits<Scalar>::max() : static_cast<Scalar>(neighbours.front().distance));
+		});
+
+		std::sort_heap(neighbours.begin(), neighbours.end());
+		for (size_t currentNeighbour = 0; currentNeighbour < neighbours.size(); ++currentNeighbour) {
+			neighbours[currentNeighbour].distance = sqrt(neighbours[currentNeighbour].distance);
+		}
+	}
+};
+
+typedef BasicKDForest<DYNAMIC_DIMENSION, double> KDForest;
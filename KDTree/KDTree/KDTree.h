@@ -5,9 +5,33 @@
 #include <cmath>
 #include <algorithm>
 #include <iomanip>
+#include <sstream>
+#include <array>
+#include <cassert>
+#include <limits>
+#include <functional>
+#include <memory>
+#include <fstream>
+#include <cstring>
+#include <random>
+#include <chrono>
+#include <type_traits>
+
+#include "PointSet.h"
+#include "ThreadPool.h"
+#include "Span.h"
+#include "MappedFile.h"
+#include "FastIO.h"
+#include "SearchStats.h"
+#include "DistanceKernels.h"
+#include "DistanceMetrics.h"
+#include "SpaceFillingCurve.h"
 
 const double EPS = 1E-7;
 
+//dimension template argument of trees whose dimension is only known at run time
+const int DYNAMIC_DIMENSION = 0;
+
 struct TypePoint {
 	std::vector<double> coordinates;
 	int identifier;
@@ -42,245 +66,2155 @@ double distanceBetweenPoints(const TypePoint &firstPoint, const TypePoint &secon
 	return result;
 }
 
-class KDTree {
+double distanceBetweenPoints(const double* firstPoint, const double* secondPoint, int dimension) {
+	double result = 0;
+
+	for (int currentCoordiateNumber = 0; currentCoordiateNumber < dimension; ++currentCoordiateNumber) {
+		double coordinatesDifference = (firstPoint[currentCoordiateNumber] - secondPoint[currentCoordiateNumber]);
+		result += coordinatesDifference * coordinatesDifference;
+	}
+
+	return result;
+}
+
+//with a fixed Dimension the loop bound is a constant, so the loop is unrolled and vectorized
+template <int Dimension, typename Scalar>
+Scalar distanceBetweenPoints(const Scalar* firstPoint, const Scalar* secondPoint, int dimension) {
+	const int pointDimension = (Dimension == DYNAMIC_DIMENSION ? dimension : Dimension);
+	Scalar result = 0;
+
+	for (int currentCoordiateNumber = 0; currentCoordiateNumber < pointDimension; ++currentCoordiateNumber) {
+		Scalar coordinatesDifference = (firstPoint[currentCoordiateNumber] - secondPoint[currentCoordiateNumber]);
+		result += coordinatesDifference * coordinatesDifference;
+	}
+
+	return result;
+}
+
+//the metric distance between the points in any metric of DistanceMetrics.h
+template <int Dimension, typename Scalar, typename Metric>
+Scalar distanceBetweenPoints(const Metric &metric, const Scalar* firstPoint, const Scalar* secondPoint, int dimension) {
+	const int pointDimension = (Dimension == DYNAMIC_DIMENSION ? dimension : Dimension);
+	Scalar result = 0;
+
+	for (int currentCoordiateNumber = 0; currentCoordiateNumber < pointDimension; ++currentCoordiateNumber) {
+		result = metric.addOffset(result, metric.getOffset(firstPoint[currentCoordiateNumber] - secondPoint[currentCoordiateNumber], currentCoordiateNumber));
+	}
+
+	return result;
+}
+
+template <typename Scalar>
+void convertPoints(const std::vector<TypePoint> &points, BasicPointSet<Scalar>* pointSet) {
+	(*pointSet).changeDimension(points.empty() ? 0 : points[0].getDimension());
+	(*pointSet).resize(0);
+	(*pointSet).reserve(points.size());
+
+	for (size_t currentPointNumber = 0; currentPointNumber < points.size(); ++currentPointNumber) {
+		(*pointSet).addPoint(&points[currentPointNumber].coordinates[0], points[currentPointNumber].identifier);
+	}
+}
+
+struct Neighbour {
+	int identifier;
+	double distance;
+
+	Neighbour() :
+		identifier(0),
+		distance(0) {
+
+		//do nothing
+	}
+
+	Neighbour(int newIdentifier, double newDistance) :
+		identifier(newIdentifier),
+		distance(newDistance) {
+
+		//do nothing
+	}
+
+	bool operator<(const Neighbour &other) const {
+		return (distance < other.distance) || ((distance == other.distance) && (identifier < other.identifier));
+	}
+};
+
+//k nearest neighbours of every point of a tree among the points with other identifiers in compressed sparse rows:
+//the neighbours of the point number i of the set the tree was built from are [rowOffsets[i], rowOffsets[i + 1]) 
+//of identifiers and distances, closest first
+struct KnnGraph {
+	std::vector<int> rowOffsets;
+	std::vector<int> identifiers;
+	std::vector<double> distances;
+};
+
+struct ApproximateSearchParameters {
+	//subtrees are skipped unless they may hold a point closer than distance / (1 + epsilon)
+	double epsilon;
+	//at most maxLeavesNumber leaves are checked, zero means no limit
+	int maxLeavesNumber;
+
+	ApproximateSearchParameters() :
+		epsilon(0),
+		maxLeavesNumber(0) {
+
+		//do nothing
+	}
+
+	ApproximateSearchParameters(double newEpsilon, int newMaxLeavesNumber) :
+		epsilon(newEpsilon),
+		maxLeavesNumber(newMaxLeavesNumber) {
+
+		//do nothing
+	}
+};
+
+struct AllPointsFilter {
+	bool operator()(int) const {
+		return true;
+	}
+};
+
+//lets the searches skip the per-point checks when nothing is filtered out
+template <typename PointFilter>
+bool acceptsAllPoints(const PointFilter &) {
+	return false;
+}
+
+bool acceptsAllPoints(const AllPointsFilter &) {
+	return true;
+}
+
+const int DEFAULT_PARALLEL_GRAIN_SIZE = 16384;
+const int DEFAULT_QUERY_GRAIN_SIZE = 256;
+//number of query subtrees searched by one task of a parallel k nearest neighbours graph build
+const int DEFAULT_KNN_GRAPH_GRAIN_SIZE = 16;
+const int DEFAULT_LEAF_SIZE = 8;
+
+//leaf sizes tried by the tuning, it builds trees over at most KDTREE_TUNING_POINTS_NUMBER sampled points
+//and times KDTREE_TUNING_QUERIES_NUMBER of them searched for among the others
+const int KDTREE_TUNING_LEAF_SIZES[] = {1, 2, 4, 8, 16, 32, 64};
+const int KDTREE_TUNING_POINTS_NUMBER = 1 << 16;
+const int KDTREE_TUNING_QUERIES_NUMBER = 512;
+const int KDTREE_TUNING_REPEATS_NUMBER = 2;
+const unsigned int KDTREE_TUNING_SEED = 2015;
+const int BRUTE_FORCE_PROBE_QUERIES_NUMBER = 32;
+const double BRUTE_FORCE_SCANNED_FRACTION = 0.5;
+//fixed dimensions up to this one are scanned by the inlined loop, no kernel beats it on rows this short
+const int MAX_INLINED_DIMENSION = 4;
+
+enum KDTreeSplitRule {
+	//the coordinate along which the box of the node is widest
+	WIDEST_BOX_SPLIT,
+	//the coordinate along which the points of the node have the largest variance
+	MAX_VARIANCE_SPLIT
+};
+
+struct KDTreeBuildParameters {
+	//when set, subtrees of more than parallelGrainSize points are built as separate tasks of the pool
+	ThreadPool* threadPool;
+	int parallelGrainSize;
+	//nodes of at most leafSize points are not split
+	int leafSize;
+	KDTreeSplitRule splitRule;
+	//when set, leafSize is chosen by timing sample queries, and so is splitRule if tuneSplitRule is set too
+	bool autoTune;
+	bool tuneSplitRule;
+	//when set, a tree in which a few probe queries scan most of the points is searched as one leaf,
+	//a brute force scan, which is what happens with few points or many dimensions
+	bool bruteForceFallback;
+
+	KDTreeBuildParameters() :
+		threadPool(NULL),
+		parallelGrainSize(DEFAULT_PARALLEL_GRAIN_SIZE),
+		leafSize(DEFAULT_LEAF_SIZE),
+		splitRule(WIDEST_BOX_SPLIT),
+		autoTune(false),
+		tuneSplitRule(false),
+		bruteForceFallback(true) {
+
+		//do nothing
+	}
+};
+
+const char KDTREE_FILE_MAGIC[8] = {'K', 'D', 'T', 'R', 'E', 'E', 'I', 'X'};
+const unsigned int KDTREE_FILE_VERSION = 3;
+//read back in a different order on machines with the other byte order
+const unsigned int KDTREE_FILE_BYTE_ORDER = 0x01020304;
+const unsigned long long KDTREE_FILE_ALIGNMENT = 64;
+
+//sections of an index file in the order they are stored
+enum KDTreeFileSection {
+	NODES_SECTION,
+	BORDERS_SECTION,
+	COORDINATES_SECTION,
+	IDENTIFIERS_SECTION,
+	PERMUTATION_SECTION,
+	GROUPS_SECTION,
+	FIRST_GROUPS_SECTION,
+	FILE_SECTIONS_NUMBER
+};
+
+//offsets are counted from the beginning of the file and are multiples of KDTREE_FILE_ALIGNMENT,
+//so the sections can be used in place wherever the file is mapped
+struct KDTreeFileHeader {
+	char magic[8];
+	unsigned int version;
+	unsigned int byteOrder;
+	unsigned int headerSize;
+	unsigned int scalarSize;
+	unsigned int nodeSize;
+	int leafSize;
+	int dimension;
+	int stride;
+	int nodesNumber;
+	int pointsNumber;
+	//the level of the kernel the leaves are scanned by and the number of transposed groups, zero for a row kernel
+	int kernelLevel;
+	int groupsNumber;
+	unsigned long long sectionOffsets[FILE_SECTIONS_NUMBER];
+	unsigned long long fileSize;
+	//checksum of the sections without the padding between them
+	unsigned long long checksum;
+};
+
+//FNV-1a over 64-bit words, the tail shorter than a word is hashed byte by byte
+unsigned long long getFileChecksum(const char* data, unsigned long long size, unsigned long long checksum) {
+	const unsigned long long FNV_PRIME = 1099511628211ULL;
+	unsigned long long currentByte = 0;
+
+	for (; currentByte + sizeof(unsigned long long) <= size; currentByte += sizeof(unsigned long long)) {
+		unsigned long long word;
+		memcpy(&word, data + currentByte, sizeof(word));
+		checksum = (checksum ^ word) * FNV_PRIME;
+	}
+
+	for (; currentByte < size; ++currentByte) {
+		checksum = (checksum ^ static_cast<unsigned char>(data[currentByte])) * FNV_PRIME;
+	}
+
+	return checksum;
+}
+
+template <int Dimension, typename Storage>
+class BasicCompactKDTree;
+
+//distances are measured in Metric, for metrics other than the euclidean one the squared distances
+//of the comments and names below are the metric distances of DistanceMetrics.h
+template <int Dimension, typename Scalar, typename Metric = EuclideanMetric>
+class BasicKDTree {
+public:
+	typedef std::array<Scalar, Dimension> FixedPoint;
+
 private:
+	//copies the structure of a built tree into its reduced precision arrays
+	template <int CompactDimension, typename Storage>
+	friend class BasicCompactKDTree;
+
+	static const int NO_CHILD = -1;
+	//leaves are scanned in blocks of this many points, the distances of a block are computed before they are compared;
+	//it is a multiple of KERNEL_GROUP_SIZE, so the blocks of a leaf begin at its groups
+	static const int LEAF_SCAN_BLOCK_SIZE = 16;
+	//cell offsets of points of at most this dimension are kept on the stack
+	static const int STACK_OFFSETS_DIMENSION = 32;
+	//the subtrees halve on every level, so no path of a tree over at most 2^31 points is this long
+	static const int TRAVERSAL_STACK_SIZE = 64;
+	//the k nearest neighbours graph searches for the points of subtrees of about this size together
+	static const int KNN_GRAPH_GROUP_SIZE = 32;
+
+	//an inner node splits its points along splitCoordinate, the points of the left child are not above
+	//leftUpperBorder and the points of the right child are not below rightLowerBorder
 	struct KDTreeNode {
-		TypePoint leftPoint;
-		TypePoint rightPoint;
-		TypePoint middlePoint;
+		int leftChild;
+		int rightChild;
+		int firstPoint;
+		int lastPoint;
+		int splitCoordinate;
+		Scalar leftUpperBorder;
+		Scalar rightLowerBorder;
+
+		KDTreeNode() :
+			leftChild(NO_CHILD),
+			rightChild(NO_CHILD),
+			firstPoint(0),
+			lastPoint(0),
+			splitCoordinate(0),
+			leftUpperBorder(0),
+			rightLowerBorder(0) {
+
+			//do nothing
+		}
+
+		bool isLeaf() const {
+			return leftChild == NO_CHILD;
+		}
+	};
+
+	Metric metric_;
+	int dimension_;
+	int leafSize_;
+	KDTreeSplitRule splitRule_;
+	int nodesNumber_;
+	int pointsNumber_;
+	int stride_;
 
-		KDTreeNode* leftChild;
-		KDTreeNode* rightChild;
+	//nodes are stored in preorder, node boxes are kept in borders_ as lower corner followed by upper corner,
+	//the points of every subtree form the range [firstPoint, lastPoint) of the points in leaf order,
+	//permutation_ maps that range back to the numbers of the points the tree was built from;
+	//the arrays are read through pointers to the storage below or into a mapped index file
+	const KDTreeNode* nodes_;
+	const Scalar* borders_;
+	const Scalar* coordinates_;
+	const int* identifiers_;
+	const int* permutation_;
 
-		std::vector<TypePoint> points;
+	//the leaves are scanned by kernel_; when it works on transposed groups, the points of every leaf are also kept
+	//in groups_, starting from the group firstGroups_[leaf], so a leaf of up to KERNEL_GROUP_SIZE points is one group;
+	//the groups are saved with the tree and mapped like the other arrays, there are none for row kernels
+	DistanceKernel kernel_;
+	int groupsNumber_;
+	const Scalar* groups_;
+	const int* firstGroups_;
 
-		KDTreeNode(const TypePoint &newLeftPoint, const TypePoint &newRightPoint) :
-			leftChild(NULL),
-			rightChild(NULL),
-			leftPoint(newLeftPoint),
-			rightPoint(newRightPoint) {
+	std::vector<KDTreeNode> nodesStorage_;
+	std::vector<Scalar> bordersStorage_;
+	BasicPointSet<Scalar> pointsStorage_;
+	std::vector<int> permutationStorage_;
+	std::vector<Scalar> groupsStorage_;
+	std::vector<int> firstGroupsStorage_;
+	std::unique_ptr<MappedFile> mappedFile_;
 
-			middlePoint.changeDimension(newLeftPoint.coordinates.size());
-			for (size_t currentCoordinate = 0; currentCoordinate < middlePoint.coordinates.size(); ++currentCoordinate) {
-				middlePoint.coordinates[currentCoordinate] = (leftPoint.coordinates[currentCoordinate] + rightPoint.coordinates[currentCoordinate]) / 2;
+	BasicKDTree(const BasicKDTree &);
+	BasicKDTree& operator=(const BasicKDTree &);
+
+	explicit BasicKDTree(const Metric &metric) :
+		metric_(metric),
+		dimension_(Dimension),
+		leafSize_(DEFAULT_LEAF_SIZE),
+		splitRule_(WIDEST_BOX_SPLIT),
+		kernel_(::getDistanceKernel(SCALAR_KERNEL)),
+		groupsNumber_(0) {
+
+		attachStorage();
+	}
+
+	Scalar* getLowerBorder(int nodeIndex) {
+		return &bordersStorage_[2 * getDimension() * nodeIndex];
+	}
+
+	Scalar* getUpperBorder(int nodeIndex) {
+		return &bordersStorage_[2 * getDimension() * nodeIndex + getDimension()];
+	}
+
+	const Scalar* getLowerBorder(int nodeIndex) const {
+		return borders_ + 2 * getDimension() * nodeIndex;
+	}
+
+	const Scalar* getUpperBorder(int nodeIndex) const {
+		return borders_ + 2 * getDimension() * nodeIndex + getDimension();
+	}
+
+	template <typename Type>
+	static const Type* getDataPointer(const std::vector<Type> &values) {
+		return values.empty() ? NULL : &values[0];
+	}
+
+	void attachStorage() {
+		nodesNumber_ = nodesStorage_.size();
+		pointsNumber_ = pointsStorage_.size();
+		stride_ = pointsStorage_.getStride();
+
+		nodes_ = getDataPointer(nodesStorage_);
+		borders_ = getDataPointer(bordersStorage_);
+		coordinates_ = pointsStorage_.getCoordinates();
+		identifiers_ = pointsStorage_.getIdentifiers();
+		permutation_ = getDataPointer(permutationStorage_);
+		groups_ = getDataPointer(groupsStorage_);
+		firstGroups_ = getDataPointer(firstGroupsStorage_);
+	}
+
+	//copies the points of every leaf into groupsStorage_ transposed, every leaf starting a group of its own
+	void fillGroups() {
+		groupsNumber_ = 0;
+		firstGroupsStorage_.assign(nodesNumber_, 0);
+		for (int currentNode = 0; currentNode < nodesNumber_; ++currentNode) {
+			if (nodes_[currentNode].isLeaf()) {
+				firstGroupsStorage_[currentNode] = groupsNumber_;
+				groupsNumber_ += getGroupsNumber(nodes_[currentNode].lastPoint - nodes_[currentNode].firstPoint);
 			}
 		}
-	};
 
-	KDTreeNode* root_;
+		groupsStorage_.assign(static_cast<size_t>(groupsNumber_) * KERNEL_GROUP_SIZE * dimension_, 0);
+		for (int currentNode = 0; currentNode < nodesNumber_; ++currentNode) {
+			const KDTreeNode &currentLeaf = nodes_[currentNode];
+			if (!currentLeaf.isLeaf()) {
+				continue;
+			}
 
-	void getBorderPoint(const std::vector<TypePoint> &points, bool lowerPoint, TypePoint* answer) const {
-		(*answer) = points[0];
-		for (size_t currentPointNumber = 1; currentPointNumber < points.size(); ++currentPointNumber) {
-			for (int currentCoordinate = 0; currentCoordinate < (*answer).getDimension(); ++currentCoordinate) {
-				if (points[currentPointNumber].coordinates[currentCoordinate] > (*answer).coordinates[currentCoordinate]) {
-					if (!lowerPoint) {
-						(*answer).coordinates[currentCoordinate] = points[currentPointNumber].coordinates[currentCoordinate];
-					}
-				}
-				else {
-					if (lowerPoint) {
-						(*answer).coordinates[currentCoordinate] = points[currentPointNumber].coordinates[currentCoordinate];
-					}
+			for (int currentPointPosition = currentLeaf.firstPoint; currentPointPosition < currentLeaf.lastPoint; ++currentPointPosition) {
+				int leafPosition = currentPointPosition - currentLeaf.firstPoint;
+				Scalar* group = &groupsStorage_[static_cast<size_t>(firstGroupsStorage_[currentNode] + leafPosition / KERNEL_GROUP_SIZE) * KERNEL_GROUP_SIZE * dimension_];
+				for (int currentCoordinate = 0; currentCoordinate < dimension_; ++currentCoordinate) {
+					group[KERNEL_GROUP_SIZE * currentCoordinate + leafPosition % KERNEL_GROUP_SIZE] = getPoint(currentPointPosition)[currentCoordinate];
 				}
 			}
 		}
 	}
 
-	int getMaxDimension(const TypePoint &leftPoint, const TypePoint &rightPoint) const {
-		int dimensionIndex = 0;
-		for (int currentCoordinate = 1; currentCoordinate < leftPoint.getDimension(); ++currentCoordinate) {
-			if (rightPoint.coordinates[dimensionIndex] - leftPoint.coordinates[dimensionIndex] 
-				< rightPoint.coordinates[currentCoordinate] - leftPoint.coordinates[currentCoordinate]) {
+	//fixed short rows are scanned by the inlined loop, other ones by the row kernel measured fastest for the dimension;
+	//rows of doubles shorter than a group are scanned transposed when the leaves fill at least one group, which the
+	//leaf size decides alone; a tree opened from a file takes the kernel and the groups saved with it
+	void chooseDistanceKernel() {
+		kernel_ = ::getDistanceKernel(SCALAR_KERNEL);
+		groupsNumber_ = 0;
+		groupsStorage_.clear();
+		firstGroupsStorage_.clear();
+		attachStorage();
+		if (((Dimension != DYNAMIC_DIMENSION) && (Dimension <= MAX_INLINED_DIMENSION)) || (pointsNumber_ == 0)) {
+			return;
+		}
 
-				dimensionIndex = currentCoordinate;
-			}
+		if (std::is_same<Scalar, double>::value && (dimension_ < KERNEL_GROUP_SIZE) && (leafSize_ >= 2 * KERNEL_GROUP_SIZE)) {
+			kernel_ = ::getDistanceKernel(AVX512_KERNEL, TRANSPOSED_KERNEL_LAYOUT);
+			fillGroups();
+			attachStorage();
+		} else {
+			kernel_ = getMeasuredDistanceKernel(dimension_, ROW_KERNEL_LAYOUT);
 		}
-		return dimensionIndex;
 	}
 
-	void devidePoints(const std::vector<TypePoint> &points, std::vector<TypePoint> &leftPoints, std::vector<TypePoint> &rightPoints, const TypePoint &leftPoint, const TypePoint &rightPoint) const {
-		int maxDimensionIndex = getMaxDimension(leftPoint, rightPoint);
-		std::vector<std::pair<double, int> > sortedPoints(points.size());
+	//squared distances from the point to the nearest and to the farthest point of the node box
+	Scalar distanceToBox(int nodeIndex, const Scalar* point) const {
+		const Scalar* lowerBorder = getLowerBorder(nodeIndex);
+		const Scalar* upperBorder = getUpperBorder(nodeIndex);
+		Scalar result = 0;
 
-		for (size_t currentPointNumber = 0; currentPointNumber < points.size(); ++currentPointNumber) {
-			sortedPoints[currentPointNumber].second = currentPointNumber;
-			sortedPoints[currentPointNumber].first = points[currentPointNumber].coordinates[maxDimensionIndex];
+		for (int currentCoordinate = 0; currentCoordinate < getDimension(); ++currentCoordinate) {
+			Scalar coordinatesDifference = std::max(lowerBorder[currentCoordinate] - point[currentCoordinate], Scalar(0)) 
+				+ std::max(point[currentCoordinate] - upperBorder[currentCoordinate], Scalar(0));
+			result = metric_.addOffset(result, metric_.getOffset(coordinatesDifference, currentCoordinate));
 		}
 
-		sort(sortedPoints.begin(), sortedPoints.end());
+		return result;
+	}
 
-		rightPoints.resize(points.size() - points.size() / 2);
-		for (size_t currentPoint = points.size() / 2; currentPoint < points.size(); ++currentPoint) {
-			rightPoints[currentPoint - points.size() / 2] = points[sortedPoints[currentPoint].second];
-		}
+	Scalar farthestDistanceToBox(int nodeIndex, const Scalar* point) const {
+		const Scalar* lowerBorder = getLowerBorder(nodeIndex);
+		const Scalar* upperBorder = getUpperBorder(nodeIndex);
+		Scalar result = 0;
 
-		leftPoints.resize(points.size() / 2);
-		for (size_t currentPoint = 0; currentPoint < points.size() / 2; ++currentPoint) {
-			leftPoints[currentPoint] = points[sortedPoints[currentPoint].second];
+		for (int currentCoordinate = 0; currentCoordinate < getDimension(); ++currentCoordinate) {
+			Scalar coordinatesDifference = std::max(point[currentCoordinate] - lowerBorder[currentCoordinate], upperBorder[currentCoordinate] - point[currentCoordinate]);
+			result = metric_.addOffset(result, metric_.getOffset(coordinatesDifference, currentCoordinate));
 		}
+
+		return result;
 	}
 
-	KDTreeNode * buildTree(const std::vector<TypePoint> &points) {
-		TypePoint leftPoint;
-		TypePoint rightPoint;
-		getBorderPoint(points, true, &leftPoint);
-		getBorderPoint(points, false, &rightPoint);
+	struct CoordinateComparator {
+		const BasicPointSet<Scalar>* points;
+		int coordinate;
+
+		CoordinateComparator(const BasicPointSet<Scalar>* newPoints, int newCoordinate) :
+			points(newPoints),
+			coordinate(newCoordinate) {
+
+			//do nothing
+		}
+
+		//ties are broken by index, so the left half of every split is uniquely defined
+		bool operator()(int firstPoint, int secondPoint) const {
+			Scalar firstCoordinate = points->getPoint(firstPoint)[coordinate];
+			Scalar secondCoordinate = points->getPoint(secondPoint)[coordinate];
+			return (firstCoordinate < secondCoordinate) || ((firstCoordinate == secondCoordinate) && (firstPoint < secondPoint));
+		}
+	};
 
-		KDTreeNode* newNode = new KDTreeNode(leftPoint, rightPoint);
+	void getBorderPoints(const BasicPointSet<Scalar> &sourcePoints, int firstPoint, int lastPoint, Scalar* lowerBorder, Scalar* upperBorder) const {
+		const Scalar* point = sourcePoints.getPoint(permutationStorage_[firstPoint]);
+		std::copy(point, point + getDimension(), lowerBorder);
+		std::copy(point, point + getDimension(), upperBorder);
 
-		if (points.size() <= 2) {
-			newNode->points = points;
-			return newNode;
+		for (int currentPointPosition = firstPoint + 1; currentPointPosition < lastPoint; ++currentPointPosition) {
+			point = sourcePoints.getPoint(permutationStorage_[currentPointPosition]);
+			for (int currentCoordinate = 0; currentCoordinate < getDimension(); ++currentCoordinate) {
+				lowerBorder[currentCoordinate] = std::min(lowerBorder[currentCoordinate], point[currentCoordinate]);
+				upperBorder[currentCoordinate] = std::max(upperBorder[currentCoordinate], point[currentCoordinate]);
+			}
 		}
+	}
+
+	void getBorderPoints(const BasicPointSet<Scalar> &sourcePoints, int firstPoint, int lastPoint, Scalar* lowerBorder, Scalar* upperBorder, 
+		ThreadPool &threadPool, int grainSize) const {
 
-		std::vector<TypePoint> leftPoints, rightPoints;
-		devidePoints(points, leftPoints, rightPoints, leftPoint, rightPoint);
-		//std::cout << leftPoints.size() << ' ' << rightPoints.size() << std::endl;
+		getBorderPoints(sourcePoints, firstPoint, firstPoint + 1, lowerBorder, upperBorder);
 
-		newNode->leftChild = buildTree(leftPoints);
-		newNode->rightChild = buildTree(rightPoints);
+		std::mutex bordersMutex;
+		parallelFor(threadPool, firstPoint, lastPoint, grainSize, [&](int chunkBegin, int chunkEnd) {
+			std::vector<Scalar> chunkLowerBorder(getDimension()), chunkUpperBorder(getDimension());
+			getBorderPoints(sourcePoints, chunkBegin, chunkEnd, &chunkLowerBorder[0], &chunkUpperBorder[0]);
 
-		return newNode;
+			std::lock_guard<std::mutex> lock(bordersMutex);
+			for (int currentCoordinate = 0; currentCoordinate < getDimension(); ++currentCoordinate) {
+				lowerBorder[currentCoordinate] = std::min(lowerBorder[currentCoordinate], chunkLowerBorder[currentCoordinate]);
+				upperBorder[currentCoordinate] = std::max(upperBorder[currentCoordinate], chunkUpperBorder[currentCoordinate]);
+			}
+		});
 	}
 
-	bool checkSubtree(const TypePoint &leftPoint, const TypePoint &rightPoint, const TypePoint &point, double distance) const {
-		double curDistance = sqrt(distance);
-		for (int currentCoordinate = 0; currentCoordinate < leftPoint.getDimension(); ++currentCoordinate) {
-			if (!((leftPoint.coordinates[currentCoordinate] - curDistance <= point.coordinates[currentCoordinate]) 
-				&& (rightPoint.coordinates[currentCoordinate] + curDistance >= point.coordinates[currentCoordinate]))) {
+	int getMaxDimension(const Scalar* lowerBorder, const Scalar* upperBorder) const {
+		int dimensionIndex = 0;
+		for (int currentCoordinate = 1; currentCoordinate < getDimension(); ++currentCoordinate) {
+			if (upperBorder[dimensionIndex] - lowerBorder[dimensionIndex] 
+				< upperBorder[currentCoordinate] - lowerBorder[currentCoordinate]) {
 
-				return false;
+				dimensionIndex = currentCoordinate;
 			}
 		}
+		return dimensionIndex;
+	}
 
-		return true;
+	int getMaxVarianceDimension(const BasicPointSet<Scalar> &sourcePoints, int firstPoint, int lastPoint) const {
+		std::vector<double> sums(getDimension(), 0), squaredSums(getDimension(), 0);
+		for (int currentPointPosition = firstPoint; currentPointPosition < lastPoint; ++currentPointPosition) {
+			const Scalar* point = sourcePoints.getPoint(permutationStorage_[currentPointPosition]);
+			for (int currentCoordinate = 0; currentCoordinate < getDimension(); ++currentCoordinate) {
+				sums[currentCoordinate] += point[currentCoordinate];
+				squaredSums[currentCoordinate] += static_cast<double>(point[currentCoordinate]) * point[currentCoordinate];
+			}
+		}
+
+		int dimensionIndex = 0;
+		double maxVariance = -1;
+		for (int currentCoordinate = 0; currentCoordinate < getDimension(); ++currentCoordinate) {
+			double mean = sums[currentCoordinate] / (lastPoint - firstPoint);
+			double variance = squaredSums[currentCoordinate] / (lastPoint - firstPoint) - mean * mean;
+			if (variance > maxVariance) {
+				maxVariance = variance;
+				dimensionIndex = currentCoordinate;
+			}
+		}
+		return dimensionIndex;
 	}
-	
-	void getMinDistance(KDTreeNode* currentNode, const TypePoint &point, double &distance, int &identifier) const {
-		if ((currentNode->leftChild == NULL) && (currentNode->rightChild == NULL)) {
-			for (size_t currentPointNumber = 0; currentPointNumber < currentNode->points.size(); ++currentPointNumber) {
-				double newDistance = distanceBetweenPoints(currentNode->points[currentPointNumber], point);
-				if (newDistance < distance + EPS) {
-					identifier = currentNode->points[currentPointNumber].identifier;
-					distance = newDistance;
+
+	//quickselect whose partition steps are spread over the pool, small ranges are finished by nth_element;
+	//leaves [firstPoint, lastPoint) in the same state nth_element would promise
+	void selectMedian(const BasicPointSet<Scalar> &sourcePoints, int firstPoint, int middlePoint, int lastPoint, int coordinate, 
+		ThreadPool &threadPool, int grainSize) {
+
+		CoordinateComparator comparator(&sourcePoints, coordinate);
+		std::vector<int> partitionedPoints;
+
+		while (lastPoint - firstPoint > grainSize) {
+			int pivotCandidates[3] = {permutationStorage_[firstPoint], permutationStorage_[firstPoint + (lastPoint - firstPoint) / 2], permutationStorage_[lastPoint - 1]};
+			std::sort(pivotCandidates, pivotCandidates + 3, comparator);
+			int pivot = pivotCandidates[1];
+
+			int chunksNumber = std::min(threadPool.getThreadsNumber() * 4, (lastPoint - firstPoint + grainSize - 1) / grainSize);
+			std::vector<int> lessNumbers(chunksNumber + 1, 0), greaterNumbers(chunksNumber + 1, 0);
+			int rangeBegin = firstPoint;
+			int rangeSize = lastPoint - firstPoint;
+
+			parallelFor(threadPool, 0, chunksNumber, 1, [&](int firstChunk, int lastChunk) {
+				for (int currentChunk = firstChunk; currentChunk < lastChunk; ++currentChunk) {
+					int chunkBegin = rangeBegin + static_cast<long long>(rangeSize) * currentChunk / chunksNumber;
+					int chunkEnd = rangeBegin + static_cast<long long>(rangeSize) * (currentChunk + 1) / chunksNumber;
+					for (int currentPointPosition = chunkBegin; currentPointPosition < chunkEnd; ++currentPointPosition) {
+						if (comparator(permutationStorage_[currentPointPosition], pivot)) {
+							++lessNumbers[currentChunk + 1];
+						} else if (comparator(pivot, permutationStorage_[currentPointPosition])) {
+							++greaterNumbers[currentChunk + 1];
+						}
+					}
 				}
+			});
+
+			for (int currentChunk = 0; currentChunk < chunksNumber; ++currentChunk) {
+				lessNumbers[currentChunk + 1] += lessNumbers[currentChunk];
+				greaterNumbers[currentChunk + 1] += greaterNumbers[currentChunk];
 			}
 
-			return;
-		}
+			int pivotPosition = lessNumbers[chunksNumber];
+			partitionedPoints.resize(rangeSize);
+			partitionedPoints[pivotPosition] = pivot;
+
+			parallelFor(threadPool, 0, chunksNumber, 1, [&](int firstChunk, int lastChunk) {
+				for (int currentChunk = firstChunk; currentChunk < lastChunk; ++currentChunk) {
+					int chunkBegin = rangeBegin + static_cast<long long>(rangeSize) * currentChunk / chunksNumber;
+					int chunkEnd = rangeBegin + static_cast<long long>(rangeSize) * (currentChunk + 1) / chunksNumber;
+					int lessPosition = lessNumbers[currentChunk];
+					int greaterPosition = pivotPosition + 1 + greaterNumbers[currentChunk];
+
+					for (int currentPointPosition = chunkBegin; currentPointPosition < chunkEnd; ++currentPointPosition) {
+						if (comparator(permutationStorage_[currentPointPosition], pivot)) {
+							partitionedPoints[lessPosition++] = permutationStorage_[currentPointPosition];
+						} else if (comparator(pivot, permutationStorage_[currentPointPosition])) {
+							partitionedPoints[greaterPosition++] = permutationStorage_[currentPointPosition];
+						}
+					}
+				}
+			});
 
-		if (distanceBetweenPoints(currentNode->leftChild->middlePoint, point) < distanceBetweenPoints(currentNode->rightChild->middlePoint, point)) {
-			getMinDistance(currentNode->leftChild, point, distance, identifier);
-			if (checkSubtree(currentNode->rightChild->leftPoint, currentNode->rightChild->rightPoint, point, distance)) {
-				getMinDistance(currentNode->rightChild, point, distance, identifier);
+			parallelFor(threadPool, 0, rangeSize, grainSize, [&](int chunkBegin, int chunkEnd) {
+				std::copy(partitionedPoints.begin() + chunkBegin, partitionedPoints.begin() + chunkEnd, permutationStorage_.begin() + rangeBegin + chunkBegin);
+			});
+
+			pivotPosition += firstPoint;
+			if (middlePoint == pivotPosition) {
+				return;
 			}
-		} else {
-			getMinDistance(currentNode->rightChild, point, distance, identifier);
-			if (checkSubtree(currentNode->leftChild->leftPoint, currentNode->leftChild->rightPoint, point, distance)) {
-				getMinDistance(currentNode->leftChild, point, distance, identifier);
+
+			if (middlePoint < pivotPosition) {
+				lastPoint = pivotPosition;
+			} else {
+				firstPoint = pivotPosition + 1;
 			}
 		}
+
+		std::nth_element(permutationStorage_.begin() + firstPoint, permutationStorage_.begin() + middlePoint, permutationStorage_.begin() + lastPoint, comparator);
 	}
 
-	/*double getFirstDistance(KDTreeNode* currentNode, const TypePoint &point, int &identifier) const {
-		if ((currentNode->leftChild == NULL) && (currentNode->rightChild == NULL)) {
-			identifier = currentNode->points[0].identifier;
-			return distanceBetweenPoints(point, currentNode->points[0]) + EPS;
-		}
+	//splits [firstPoint, lastPoint) of the permutation in place, the lower half goes to [firstPoint, middlePoint);
+	//returns the upper border of the lower half and the lower border of the upper half along the coordinate
+	void devidePoints(const BasicPointSet<Scalar> &sourcePoints, int firstPoint, int middlePoint, int lastPoint, int coordinate, 
+		Scalar &leftUpperBorder, Scalar &rightLowerBorder, ThreadPool* threadPool, int grainSize) {
 
-		if (distanceBetweenPoints(currentNode->leftChild->middlePoint, point) < distanceBetweenPoints(currentNode->rightChild->middlePoint, point)) {
-			return getFirstDistance(currentNode->leftChild, point, identifier);
+		if (threadPool != NULL) {
+			selectMedian(sourcePoints, firstPoint, middlePoint, lastPoint, coordinate, *threadPool, grainSize);
 		} else {
-			return getFirstDistance(currentNode->rightChild, point, identifier);
+			std::nth_element(permutationStorage_.begin() + firstPoint, permutationStorage_.begin() + middlePoint, permutationStorage_.begin() + lastPoint, 
+				CoordinateComparator(&sourcePoints, coordinate));
 		}
-	}
 
-	void getMinDistance(KDTreeNode* currentNode, const TypePoint &point, double &distance, int &identifier) const {
-		if ((currentNode->leftChild == NULL) && (currentNode->rightChild == NULL)) {
-			for (size_t currentPointNumber = 0; currentPointNumber < currentNode->points.size(); ++currentPointNumber) {
-				double newDistance = distanceBetweenPoints(currentNode->points[currentPointNumber], point);
-				if (newDistance < distance) {
-					identifier = currentNode->points[currentPointNumber].identifier;
-					distance = newDistance;
+		rightLowerBorder = sourcePoints.getPoint(permutationStorage_[middlePoint])[coordinate];
+		leftUpperBorder = sourcePoints.getPoint(permutationStorage_[firstPoint])[coordinate];
+
+		if (threadPool != NULL) {
+			std::mutex borderMutex;
+			parallelFor(*threadPool, firstPoint, middlePoint, grainSize, [&](int chunkBegin, int chunkEnd) {
+				Scalar chunkUpperBorder = sourcePoints.getPoint(permutationStorage_[chunkBegin])[coordinate];
+				for (int currentPointPosition = chunkBegin + 1; currentPointPosition < chunkEnd; ++currentPointPosition) {
+					chunkUpperBorder = std::max(chunkUpperBorder, sourcePoints.getPoint(permutationStorage_[currentPointPosition])[coordinate]);
 				}
+
+				std::lock_guard<std::mutex> lock(borderMutex);
+				leftUpperBorder = std::max(leftUpperBorder, chunkUpperBorder);
+			});
+		} else {
+			for (int currentPointPosition = firstPoint + 1; currentPointPosition < middlePoint; ++currentPointPosition) {
+				leftUpperBorder = std::max(leftUpperBorder, sourcePoints.getPoint(permutationStorage_[currentPointPosition])[coordinate]);
 			}
+		}
+	}
 
-			return;
+	//returns the numbers of nodes in the trees over pointsNumber and pointsNumber + 1 points,
+	//the halves of both sizes are again two consecutive sizes, so the recursion is logarithmic
+	std::pair<int, int> getNodesNumbers(int pointsNumber) const {
+		if (pointsNumber + 1 <= leafSize_) {
+			return std::make_pair(1, 1);
 		}
 
-		if (checkSubtree(currentNode->rightChild->leftPoint, currentNode->rightChild->rightPoint, point, distance)) {
-			getMinDistance(currentNode->rightChild, point, distance, identifier);
+		std::pair<int, int> halvesNodesNumbers = getNodesNumbers(pointsNumber / 2);
+		std::pair<int, int> nodesNumbers;
+		if (pointsNumber % 2 == 0) {
+			nodesNumbers.first = 1 + 2 * halvesNodesNumbers.first;
+			nodesNumbers.second = 1 + halvesNodesNumbers.first + halvesNodesNumbers.second;
+		} else {
+			nodesNumbers.first = 1 + halvesNodesNumbers.first + halvesNodesNumbers.second;
+			nodesNumbers.second = 1 + 2 * halvesNodesNumbers.second;
 		}
 
-		if (checkSubtree(currentNode->leftChild->leftPoint, currentNode->leftChild->rightPoint, point, distance)) {
-			getMinDistance(currentNode->leftChild, point, distance, identifier);
+		if (pointsNumber <= leafSize_) {
+			nodesNumbers.first = 1;
 		}
+
+		return nodesNumbers;
 	}
-	*/
 
-	void destroyTree(KDTreeNode* currentNode) {
-		if (currentNode->leftChild != NULL) {
-			destroyTree(currentNode->leftChild);
+	//a subtree waiting to be built, its box is kept in the matching slot of the borders of the build stack
+	struct BuildTask {
+		int nodeIndex;
+		int firstPoint;
+		int lastPoint;
+
+		BuildTask() :
+			nodeIndex(0),
+			firstPoint(0),
+			lastPoint(0) {
+
+			//do nothing
 		}
 
-		if (currentNode->rightChild != NULL) {
-			destroyTree(currentNode->rightChild);
+		BuildTask(int newNodeIndex, int newFirstPoint, int newLastPoint) :
+			nodeIndex(newNodeIndex),
+			firstPoint(newFirstPoint),
+			lastPoint(newLastPoint) {
+
+			//do nothing
 		}
+	};
 
-		delete currentNode;
-	}
+	//builds the subtree of nodeIndex with an explicit stack, subtrees larger than the grain size of a parallel build
+	//are handed to the thread pool; the box passed in is exact along the coordinates split so far and is only used
+	//to choose the split, the exact boxes of the inner nodes are set by setInnerBorders after the build;
+	//the position of every node depends on the subtree sizes only, so a parallel build gives the same tree
+	void buildTree(const BasicPointSet<Scalar> &sourcePoints, int nodeIndex, int firstPoint, int lastPoint, const Scalar* lowerBorder, 
+		const Scalar* upperBorder, const KDTreeBuildParameters &parameters) {
 
-public:
-	KDTree(const std::vector<TypePoint> &points) {
-		root_ = buildTree(points);
+		BuildTask tasks[TRAVERSAL_STACK_SIZE];
+		std::vector<Scalar> tasksBorders(2 * getDimension() * TRAVERSAL_STACK_SIZE);
+		std::unique_ptr<TaskGroup> subtrees;
+		if (parameters.threadPool != NULL) {
+			subtrees.reset(new TaskGroup(*parameters.threadPool));
+		}
+
+		tasks[0] = BuildTask(nodeIndex, firstPoint, lastPoint);
+		std::copy(lowerBorder, lowerBorder + getDimension(), &tasksBorders[0]);
+		std::copy(upperBorder, upperBorder + getDimension(), &tasksBorders[getDimension()]);
+		int tasksNumber = 1;
+
+		while (tasksNumber > 0) {
+			--tasksNumber;
+			BuildTask task = tasks[tasksNumber];
+			Scalar* taskLowerBorder = &tasksBorders[2 * getDimension() * tasksNumber];
+			Scalar* taskUpperBorder = taskLowerBorder + getDimension();
+			int pointsNumber = task.lastPoint - task.firstPoint;
+
+			nodesStorage_[task.nodeIndex].firstPoint = task.firstPoint;
+			nodesStorage_[task.nodeIndex].lastPoint = task.lastPoint;
+
+			if (pointsNumber <= leafSize_) {
+				std::sort(permutationStorage_.begin() + task.firstPoint, permutationStorage_.begin() + task.lastPoint);
+				getBorderPoints(sourcePoints, task.firstPoint, task.lastPoint, getLowerBorder(task.nodeIndex), getUpperBorder(task.nodeIndex));
+				continue;
+			}
+
+			bool parallelBuild = (parameters.threadPool != NULL) && (pointsNumber > parameters.parallelGrainSize);
+			bool parallelDevision = parallelBuild 
+				&& (static_cast<long long>(pointsNumber) * parameters.threadPool->getThreadsNumber() > static_cast<long long>(permutationStorage_.size()));
+
+			int splitCoordinate = (splitRule_ == MAX_VARIANCE_SPLIT ? getMaxVarianceDimension(sourcePoints, task.firstPoint, task.lastPoint) 
+				: getMaxDimension(taskLowerBorder, taskUpperBorder));
+			int middlePoint = task.firstPoint + pointsNumber / 2;
+			Scalar leftUpperBorder, rightLowerBorder;
+			devidePoints(sourcePoints, task.firstPoint, middlePoint, task.lastPoint, splitCoordinate, leftUpperBorder, rightLowerBorder, 
+				parallelDevision ? parameters.threadPool : NULL, parameters.parallelGrainSize);
+
+			int leftChild = task.nodeIndex + 1;
+			int rightChild = leftChild + getNodesNumbers(middlePoint - task.firstPoint).first;
+			KDTreeNode &currentNode = nodesStorage_[task.nodeIndex];
+			currentNode.leftChild = leftChild;
+			currentNode.rightChild = rightChild;
+			currentNode.splitCoordinate = splitCoordinate;
+			currentNode.leftUpperBorder = leftUpperBorder;
+			currentNode.rightLowerBorder = rightLowerBorder;
+
+			//the right subtree takes the slot of the node, the left one goes above it and is built first
+			assert(tasksNumber + 1 < TRAVERSAL_STACK_SIZE);
+			Scalar* leftLowerBorder = taskUpperBorder + getDimension();
+			Scalar* leftUpperBorders = leftLowerBorder + getDimension();
+			std::copy(taskLowerBorder, taskLowerBorder + 2 * getDimension(), leftLowerBorder);
+			leftUpperBorders[splitCoordinate] = leftUpperBorder;
+			taskLowerBorder[splitCoordinate] = rightLowerBorder;
+			tasks[tasksNumber++] = BuildTask(rightChild, middlePoint, task.lastPoint);
+
+			if (parallelBuild) {
+				std::vector<Scalar> leftBorders(leftLowerBorder, leftLowerBorder + 2 * getDimension());
+				int leftFirstPoint = task.firstPoint;
+				subtrees->run([this, &sourcePoints, &parameters, leftChild, leftFirstPoint, middlePoint, leftBorders]() {
+					buildTree(sourcePoints, leftChild, leftFirstPoint, middlePoint, &leftBorders[0], &leftBorders[getDimension()], parameters);
+				});
+			} else {
+				tasks[tasksNumber++] = BuildTask(leftChild, task.firstPoint, middlePoint);
+			}
+		}
 	}
 
-	~KDTree() {
-		destroyTree(root_);
+	//the exact box of an inner node is the union of the boxes of its children, which follow it in preorder
+	void setInnerBorders() {
+		for (int nodeIndex = static_cast<int>(nodesStorage_.size()) - 1; nodeIndex >= 0; --nodeIndex) {
+			const KDTreeNode &currentNode = nodesStorage_[nodeIndex];
+			if (currentNode.isLeaf()) {
+				continue;
+			}
+
+			for (int currentCoordinate = 0; currentCoordinate < getDimension(); ++currentCoordinate) {
+				getLowerBorder(nodeIndex)[currentCoordinate] = std::min(getLowerBorder(currentNode.leftChild)[currentCoordinate], 
+					getLowerBorder(currentNode.rightChild)[currentCoordinate]);
+				getUpperBorder(nodeIndex)[currentCoordinate] = std::max(getUpperBorder(currentNode.leftChild)[currentCoordinate], 
+					getUpperBorder(currentNode.rightChild)[currentCoordinate]);
+			}
+		}
 	}
 
-	int getMinDistanceIdentifier(const TypePoint &point, double &distance) const {
-		int resultIdentifier;
+	//sample queries are points of the tree searched for among the other points, which makes them follow
+	//the distribution of the points without finding themselves
+	struct OtherPointsFilter {
+		const BasicKDTree* tree;
+		int excludedIdentifier;
 
-		distance = 10000000;//getFirstDistance(root_, point, resultIdentifier);
-		getMinDistance(root_, point, distance, resultIdentifier);
+		OtherPointsFilter(const BasicKDTree* newTree, int newExcludedIdentifier) :
+			tree(newTree),
+			excludedIdentifier(newExcludedIdentifier) {
 
-		distance = sqrt(distance);
-		return resultIdentifier;
+			//do nothing
+		}
+
+		bool operator()(int position) const {
+			return tree->getIdentifier(position) != excludedIdentifier;
+		}
+	};
+
+	template <typename Stats>
+	void searchOtherPoints(const Scalar* point, int excludedIdentifier, Stats &stats) const {
+		Scalar squaredDistance = std::numeric_limits<Scalar>::max();
+		int identifier = -1;
+		updateMinDistance(point, squaredDistance, identifier, OtherPointsFilter(this, excludedIdentifier), stats);
 	}
-};
 
-void inputPoints(std::vector<TypePoint>* points) {
-	int pointsNumber;
-	int dimension;
+	//the point a probe query was taken from is left out by its position, the identifiers need not be distinct
+	struct OtherPositionFilter {
+		int excludedPosition;
 
-	std::cin >> pointsNumber >> dimension;
-	(*points).resize(pointsNumber);
+		explicit OtherPositionFilter(int newExcludedPosition) :
+			excludedPosition(newExcludedPosition) {
 
-	for (int currentPointNumber = 0; currentPointNumber < pointsNumber; ++currentPointNumber) {
-		(*points)[currentPointNumber].changeDimension(dimension);
-		(*points)[currentPointNumber].identifier = currentPointNumber;
+			//do nothing
+		}
 
-		for (int currentCoordinate = 0; currentCoordinate < dimension; ++currentCoordinate) {
-			std::cin >> (*points)[currentPointNumber].coordinates[currentCoordinate];
+		bool operator()(int position) const {
+			return position != excludedPosition;
+		}
+	};
+
+	//true when queries for points of the built tree look at more than BRUTE_FORCE_SCANNED_FRACTION of the points,
+	//then a plain scan of the contiguous points beats walking the tree; the probe stops as soon as the answer is known
+	bool isScanCheaper() const {
+		std::default_random_engine engine(KDTREE_TUNING_SEED);
+		std::uniform_int_distribution<int> positionGenerator(0, pointsNumber_ - 1);
+		const double maxDistancesComputed = BRUTE_FORCE_SCANNED_FRACTION * BRUTE_FORCE_PROBE_QUERIES_NUMBER * pointsNumber_;
+		SearchStats stats;
+
+		for (int currentRequestNumber = 0; (currentRequestNumber < BRUTE_FORCE_PROBE_QUERIES_NUMBER) && (stats.distancesComputed <= maxDistancesComputed); 
+			++currentRequestNumber) {
+
+			int requestPosition = positionGenerator(engine);
+			Scalar squaredDistance = std::numeric_limits<Scalar>::max();
+			int identifier = -1;
+			updateMinDistance(getPoint(requestPosition), squaredDistance, identifier, OtherPositionFilter(requestPosition), stats);
 		}
+
+		return stats.distancesComputed > maxDistancesComputed;
 	}
-}
 
-void answerRequests(const KDTree& tree, int dimension) {
-	int requestsNumber;
-	std::cin >> requestsNumber;
+	//leaves only the root of the built tree, a leaf of all points in the order of the former leaves,
+	//and chooses the kernel for that leaf
+	void mergeLeaves() {
+		nodesStorage_.resize(1);
+		nodesStorage_.shrink_to_fit();
+		nodesStorage_[0].leftChild = NO_CHILD;
+		nodesStorage_[0].rightChild = NO_CHILD;
+		bordersStorage_.resize(2 * dimension_);
+		bordersStorage_.shrink_to_fit();
+		leafSize_ = pointsNumber_;
+		attachStorage();
+		chooseDistanceKernel();
+	}
 
-	for (int currentRequestNumber = 0; currentRequestNumber < requestsNumber; ++currentRequestNumber) {
-		TypePoint currentPoint(dimension, 0);
+	//builds trees over a sample of the points with every candidate leaf size and keeps the one answering
+	//the sample queries fastest; the times are measured, so the choice may differ between runs
+	static KDTreeBuildParameters tuneParameters(const BasicPointSet<Scalar> &sourcePoints, const KDTreeBuildParameters &parameters, 
+		const Metric &metric) {
+
+		std::default_random_engine engine(KDTREE_TUNING_SEED);
+		std::uniform_int_distribution<int> pointGenerator(0, sourcePoints.size() - 1);
+
+		BasicPointSet<Scalar> samplePoints(sourcePoints.getDimension());
+		if (sourcePoints.size() <= KDTREE_TUNING_POINTS_NUMBER) {
+			samplePoints = sourcePoints;
+			for (int currentPointNumber = 0; currentPointNumber < samplePoints.size(); ++currentPointNumber) {
+				samplePoints.setIdentifier(currentPointNumber, currentPointNumber);
+			}
+		} else {
+			samplePoints.reserve(KDTREE_TUNING_POINTS_NUMBER);
+			for (int currentPointNumber = 0; currentPointNumber < KDTREE_TUNING_POINTS_NUMBER; ++currentPointNumber) {
+				samplePoints.addPoint(sourcePoints.getPoint(pointGenerator(engine)), currentPointNumber);
+			}
+		}
+
+		std::uniform_int_distribution<int> samplePointGenerator(0, samplePoints.size() - 1);
+		std::vector<int> requestPointNumbers(KDTREE_TUNING_QUERIES_NUMBER);
+		for (int currentRequestNumber = 0; currentRequestNumber < KDTREE_TUNING_QUERIES_NUMBER; ++currentRequestNumber) {
+			requestPointNumbers[currentRequestNumber] = samplePointGenerator(engine);
+		}
+
+		KDTreeBuildParameters bestParameters = parameters;
+		bestParameters.autoTune = false;
+		bestParameters.bruteForceFallback = false;
+		double bestTime = std::numeric_limits<double>::max();
+		int splitRulesNumber = (parameters.tuneSplitRule ? 2 : 1);
+
+		for (int currentSplitRule = 0; currentSplitRule < splitRulesNumber; ++currentSplitRule) {
+			for (size_t currentLeafSize = 0; currentLeafSize < sizeof(KDTREE_TUNING_LEAF_SIZES) / sizeof(int); ++currentLeafSize) {
+				KDTreeBuildParameters candidateParameters = bestParameters;
+				candidateParameters.leafSize = KDTREE_TUNING_LEAF_SIZES[currentLeafSize];
+				if (parameters.tuneSplitRule) {
+					candidateParameters.splitRule = static_cast<KDTreeSplitRule>(currentSplitRule);
+				}
 
-		for (int currentCoordinate = 0; currentCoordinate < currentPoint.getDimension(); ++currentCoordinate) {
-			std::cin >> currentPoint.coordinates[currentCoordinate];
+				//a candidate is dropped as soon as it is slower than the best one so far
+				BasicKDTree candidateTree(samplePoints, candidateParameters, metric);
+				double candidateTime = std::numeric_limits<double>::max();
+				for (int currentRepeat = 0; currentRepeat < KDTREE_TUNING_REPEATS_NUMBER; ++currentRepeat) {
+					std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+					double repeatTime = 0;
+					for (int currentRequestNumber = 0; (currentRequestNumber < KDTREE_TUNING_QUERIES_NUMBER) && (repeatTime < bestTime); ++currentRequestNumber) {
+						NoSearchStats stats;
+						int requestPointNumber = requestPointNumbers[currentRequestNumber];
+						candidateTree.searchOtherPoints(samplePoints.getPoint(requestPointNumber), requestPointNumber, stats);
+						repeatTime = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+					}
+					candidateTime = std::min(candidateTime, repeatTime);
+				}
+
+				if (candidateTime < bestTime) {
+					bestTime = candidateTime;
+					bestParameters = candidateParameters;
+				}
+			}
 		}
 
-		double distance = 0;
-		std::cout << tree.getMinDistanceIdentifier(currentPoint, distance) << ' ';
-		std::cout << std::setprecision(15) << distance << std::endl;
+		bestParameters.bruteForceFallback = parameters.bruteForceFallback;
+		return bestParameters;
 	}
-}
\ No newline at end of file
+
+	void initialize(const BasicPointSet<Scalar> &sourcePoints, const KDTreeBuildParameters &parameters) {
+		dimension_ = sourcePoints.getDimension();
+		assert(Dimension == DYNAMIC_DIMENSION || Dimension == dimension_);
+		assert(parameters.leafSize >= 1);
+
+		if (parameters.autoTune && (sourcePoints.size() > 0)) {
+			initialize(sourcePoints, tuneParameters(sourcePoints, parameters, metric_));
+			return;
+		}
+
+		leafSize_ = parameters.leafSize;
+		splitRule_ = parameters.splitRule;
+
+		pointsStorage_.changeDimension(dimension_);
+		if (sourcePoints.size() == 0) {
+			attachStorage();
+			chooseDistanceKernel();
+			return;
+		}
+
+		permutationStorage_.resize(sourcePoints.size());
+		for (int currentPointNumber = 0; currentPointNumber < sourcePoints.size(); ++currentPointNumber) {
+			permutationStorage_[currentPointNumber] = currentPointNumber;
+		}
+
+		int nodesNumber = getNodesNumbers(sourcePoints.size()).first;
+		nodesStorage_.resize(nodesNumber);
+		bordersStorage_.resize(2 * dimension_ * nodesNumber);
+
+		std::vector<Scalar> lowerBorder(dimension_), upperBorder(dimension_);
+		if (parameters.threadPool != NULL) {
+			getBorderPoints(sourcePoints, 0, sourcePoints.size(), &lowerBorder[0], &upperBorder[0], *parameters.threadPool, parameters.parallelGrainSize);
+		} else {
+			getBorderPoints(sourcePoints, 0, sourcePoints.size(), &lowerBorder[0], &upperBorder[0]);
+		}
+		buildTree(sourcePoints, 0, 0, sourcePoints.size(), &lowerBorder[0], &upperBorder[0], parameters);
+		setInnerBorders();
+
+		pointsStorage_.resize(sourcePoints.size());
+		std::function<void(int, int)> copyPoints = [&](int firstPosition, int lastPosition) {
+			for (int currentPointPosition = firstPosition; currentPointPosition < lastPosition; ++currentPointPosition) {
+				const Scalar* sourcePoint = sourcePoints.getPoint(permutationStorage_[currentPointPosition]);
+				std::copy(sourcePoint, sourcePoint + dimension_, pointsStorage_.getPoint(currentPointPosition));
+				pointsStorage_.setIdentifier(currentPointPosition, sourcePoints.getIdentifier(permutationStorage_[currentPointPosition]));
+			}
+		};
+
+		if (parameters.threadPool != NULL) {
+			parallelFor(*parameters.threadPool, 0, sourcePoints.size(), parameters.parallelGrainSize, copyPoints);
+		} else {
+			copyPoints(0, sourcePoints.size());
+		}
+
+		attachStorage();
+		chooseDistanceKernel();
+		//a tree the queries would mostly walk through is searched as one leaf, whose scan is a plain brute force search
+		if (parameters.bruteForceFallback && (pointsNumber_ > leafSize_) && isScanCheaper()) {
+			mergeLeaves();
+		}
+	}
+
+	//the cell of a node is the root box cut by the split borders of its ancestors, the searches keep the squared
+	//distances from the point to the cell along every coordinate and their sum; going to a child changes
+	//only the split coordinate, so the distance to the cell of a child is found in O(1) (Arya and Mount)
+	class CellOffsets {
+	private:
+		Scalar stackOffsets_[STACK_OFFSETS_DIMENSION];
+		std::vector<Scalar> heapOffsets_;
+
+		CellOffsets(const CellOffsets &);
+		CellOffsets& operator=(const CellOffsets &);
+
+	public:
+		Scalar* offsets;
+
+		explicit CellOffsets(int dimension) :
+			offsets(stackOffsets_) {
+
+			if (dimension > STACK_OFFSETS_DIMENSION) {
+				heapOffsets_.resize(dimension);
+				offsets = &heapOffsets_[0];
+			}
+		}
+	};
+
+	//a far child put aside by a search, changesNumber is the number of offset changes on the path to its parent
+	struct PendingCell {
+		int nodeIndex;
+		int splitCoordinate;
+		Scalar offset;
+		Scalar cellDistance;
+		int changesNumber;
+	};
+
+	//an offset overwritten on the way down, it is restored when the search backtracks above the change
+	struct OffsetChange {
+		int coordinate;
+		Scalar offset;
+	};
+
+	//fills the offsets to the root box and returns the squared distance to it
+	Scalar getRootOffsets(const Scalar* point, Scalar* offsets) const {
+		const Scalar* lowerBorder = getLowerBorder(0);
+		const Scalar* upperBorder = getUpperBorder(0);
+		Scalar result = 0;
+
+		for (int currentCoordinate = 0; currentCoordinate < getDimension(); ++currentCoordinate) {
+			Scalar coordinatesDifference = std::max(lowerBorder[currentCoordinate] - point[currentCoordinate], Scalar(0)) 
+				+ std::max(point[currentCoordinate] - upperBorder[currentCoordinate], Scalar(0));
+			offsets[currentCoordinate] = metric_.getOffset(coordinatesDifference, currentCoordinate);
+			result = metric_.addOffset(result, offsets[currentCoordinate]);
+		}
+
+		return result;
+	}
+
+	//offsets along the split coordinate from the point to the cells of the children of an inner node,
+	//the nearer child is the one whose side of the gap between the children holds the point
+	bool getChildOffsets(const KDTreeNode &node, const Scalar* point, Scalar parentOffset, Scalar &nearOffset, Scalar &farOffset) const {
+		int splitCoordinate = node.splitCoordinate;
+		Scalar pointCoordinate = point[splitCoordinate];
+		Scalar leftDifference = pointCoordinate - node.leftUpperBorder;
+		Scalar rightDifference = node.rightLowerBorder - pointCoordinate;
+		bool leftIsNear = (leftDifference < rightDifference);
+
+		if (leftIsNear) {
+			nearOffset = (leftDifference > 0 ? metric_.getOffset(leftDifference, splitCoordinate) : parentOffset);
+			farOffset = (rightDifference > 0 ? metric_.getOffset(rightDifference, splitCoordinate) : parentOffset);
+		} else {
+			nearOffset = (rightDifference > 0 ? metric_.getOffset(rightDifference, splitCoordinate) : parentOffset);
+			farOffset = (leftDifference > 0 ? metric_.getOffset(leftDifference, splitCoordinate) : parentOffset);
+		}
+
+		return leftIsNear;
+	}
+	
+	//squared distances from the point to the points at positions [firstPosition, lastPosition) of the leaf, at most LEAF_SCAN_BLOCK_SIZE
+	//of them starting a multiple of it into the leaf, returns the position of the nearest of them
+	int getBlockDistances(const KDTreeNode &leaf, int firstPosition, int lastPosition, const Scalar* point, Scalar* distances) const {
+		if ((Dimension != DYNAMIC_DIMENSION) && (Dimension <= MAX_INLINED_DIMENSION)) {
+			int nearestPosition = firstPosition;
+			for (int currentPointPosition = firstPosition; currentPointPosition < lastPosition; ++currentPointPosition) {
+				distances[currentPointPosition - firstPosition] = distanceBetweenPoints<Dimension>(metric_, getPoint(currentPointPosition), point, Dimension);
+				if (distances[currentPointPosition - firstPosition] < distances[nearestPosition - firstPosition]) {
+					nearestPosition = currentPointPosition;
+				}
+			}
+
+			return nearestPosition;
+		}
+
+		if (kernel_.layout == ROW_KERNEL_LAYOUT) {
+			return firstPosition + metric_.getBlockDistances(kernel_, coordinates_ + static_cast<size_t>(stride_) * firstPosition, 
+				lastPosition - firstPosition, stride_, point, dimension_, distances);
+		}
+
+		//distances has room for the whole groups, which the kernel fills
+		int firstGroup = firstGroups_[&leaf - nodes_] + (firstPosition - leaf.firstPoint) / KERNEL_GROUP_SIZE;
+		return firstPosition + metric_.getGroupDistances(kernel_, groups_ + static_cast<size_t>(KERNEL_GROUP_SIZE) * dimension_ * firstGroup, 
+			lastPosition - firstPosition, point, dimension_, distances);
+	}
+
+	//without a filter only the nearest point of a block is looked at
+	template <typename PointFilter, typename Stats>
+	void scanLeaf(const KDTreeNode &leaf, const Scalar* point, Scalar &distance, int &identifier, const PointFilter &filter, Stats &stats) const {
+		Scalar blockDistances[LEAF_SCAN_BLOCK_SIZE];
+
+		for (int blockBegin = leaf.firstPoint; blockBegin < leaf.lastPoint; blockBegin += LEAF_SCAN_BLOCK_SIZE) {
+			int blockEnd = std::min(blockBegin + LEAF_SCAN_BLOCK_SIZE, leaf.lastPoint);
+			int nearestPosition = getBlockDistances(leaf, blockBegin, blockEnd, point, blockDistances);
+			stats.computeDistances(blockEnd - blockBegin);
+
+			if (acceptsAllPoints(filter)) {
+				if (blockDistances[nearestPosition - blockBegin] < distance + EPS) {
+					identifier = getIdentifier(nearestPosition);
+					distance = blockDistances[nearestPosition - blockBegin];
+				}
+				continue;
+			}
+
+			for (int currentPointPosition = blockBegin; currentPointPosition < blockEnd; ++currentPointPosition) {
+				if (!filter(currentPointPosition)) {
+					continue;
+				}
+
+				Scalar newDistance = blockDistances[currentPointPosition - blockBegin];
+				if (newDistance < distance + EPS) {
+					identifier = getIdentifier(currentPointPosition);
+					distance = newDistance;
+				}
+			}
+		}
+	}
+
+	//depth-first search over the cells, the nearer child first; leafScanner(leaf) looks at the points of a leaf
+	//and isCellSearched(cellDistance) tells whether a far cell may still hold a point the search is looking for;
+	//far children wait on a stack together with the offsets to restore when the search backtracks to them
+	template <typename LeafScanner, typename CellCheck, typename Stats>
+	void searchCells(const Scalar* point, Scalar* offsets, const LeafScanner &leafScanner, const CellCheck &isCellSearched, Stats &stats) const {
+		PendingCell pendingCells[TRAVERSAL_STACK_SIZE];
+		OffsetChange changes[TRAVERSAL_STACK_SIZE];
+		int pendingCellsNumber = 0;
+		int changesNumber = 0;
+		int nodeIndex = 0;
+		Scalar cellDistance = getRootOffsets(point, offsets);
+
+		while (true) {
+			while (!nodes_[nodeIndex].isLeaf()) {
+				const KDTreeNode &currentNode = nodes_[nodeIndex];
+				stats.visitNode();
+
+				int splitCoordinate = currentNode.splitCoordinate;
+				Scalar parentOffset = offsets[splitCoordinate];
+				Scalar nearOffset, farOffset;
+				int nearChild = currentNode.leftChild;
+				int farChild = currentNode.rightChild;
+				if (!getChildOffsets(currentNode, point, parentOffset, nearOffset, farOffset)) {
+					std::swap(nearChild, farChild);
+				}
+
+				//the bounds only shrink, so a far cell rejected now is never searched
+				Scalar farCellDistance = metric_.updateCellDistance(cellDistance, parentOffset, farOffset);
+				if (isCellSearched(farCellDistance)) {
+					assert(pendingCellsNumber < TRAVERSAL_STACK_SIZE);
+					PendingCell &farCell = pendingCells[pendingCellsNumber++];
+					farCell.nodeIndex = farChild;
+					farCell.splitCoordinate = splitCoordinate;
+					farCell.offset = farOffset;
+					farCell.cellDistance = farCellDistance;
+					farCell.changesNumber = changesNumber;
+				} else {
+					stats.pruneSubtree();
+				}
+
+				changes[changesNumber].coordinate = splitCoordinate;
+				changes[changesNumber].offset = parentOffset;
+				++changesNumber;
+
+				offsets[splitCoordinate] = nearOffset;
+				cellDistance = metric_.updateCellDistance(cellDistance, parentOffset, nearOffset);
+				nodeIndex = nearChild;
+			}
+
+			stats.visitNode();
+			stats.scanLeaf();
+			leafScanner(nodes_[nodeIndex]);
+
+			while ((pendingCellsNumber > 0) && !isCellSearched(pendingCells[pendingCellsNumber - 1].cellDistance)) {
+				stats.pruneSubtree();
+				--pendingCellsNumber;
+			}
+
+			if (pendingCellsNumber == 0) {
+				return;
+			}
+
+			const PendingCell &farCell = pendingCells[--pendingCellsNumber];
+			for (; changesNumber > farCell.changesNumber; --changesNumber) {
+				offsets[changes[changesNumber - 1].coordinate] = changes[changesNumber - 1].offset;
+			}
+
+			changes[changesNumber].coordinate = farCell.splitCoordinate;
+			changes[changesNumber].offset = offsets[farCell.splitCoordinate];
+			++changesNumber;
+
+			offsets[farCell.splitCoordinate] = farCell.offset;
+			cellDistance = farCell.cellDistance;
+			nodeIndex = farCell.nodeIndex;
+		}
+	}
+
+	template <typename PointFilter, typename Stats>
+	void getMinDistance(const Scalar* point, Scalar* offsets, Scalar &distance, int &identifier, const PointFilter &filter, Stats &stats) const {
+		searchCells(point, offsets, [&](const KDTreeNode &leaf) {
+			scanLeaf(leaf, point, distance, identifier, filter, stats);
+		}, [&](Scalar cellDistance) {
+			return cellDistance < distance + EPS;
+		}, stats);
+	}
+
+	//neighbours is a max-heap of at most k squared distances, its top bounds the search once it is full
+	template <typename PointFilter>
+	void getKNearestNeighbours(const Scalar* point, Scalar* offsets, size_t k, std::vector<Neighbour> &neighbours, const PointFilter &filter) const {
+		NoSearchStats stats;
+
+		searchCells(point, offsets, [&](const KDTreeNode &leaf) {
+			Scalar blockDistances[LEAF_SCAN_BLOCK_SIZE];
+
+			for (int blockBegin = leaf.firstPoint; blockBegin < leaf.lastPoint; blockBegin += LEAF_SCAN_BLOCK_SIZE) {
+				int blockEnd = std::min(blockBegin + LEAF_SCAN_BLOCK_SIZE, leaf.lastPoint);
+				getBlockDistances(leaf, blockBegin, blockEnd, point, blockDistances);
+
+				for (int currentPointPosition = blockBegin; currentPointPosition < blockEnd; ++currentPointPosition) {
+					if (!filter(currentPointPosition)) {
+						continue;
+					}
+
+					Neighbour candidate(getIdentifier(currentPointPosition), blockDistances[currentPointPosition - blockBegin]);
+
+					if (neighbours.size() < k) {
+						neighbours.push_back(candidate);
+						std::push_heap(neighbours.begin(), neighbours.end());
+					} else if (candidate < neighbours.front()) {
+						std::pop_heap(neighbours.begin(), neighbours.end());
+						neighbours.back() = candidate;
+						std::push_heap(neighbours.begin(), neighbours.end());
+					}
+				}
+			}
+		}, [&](Scalar cellDistance) {
+			return (neighbours.size() < k) || (cellDistance <= neighbours.front().distance);
+		}, stats);
+	}
+
+	//subtrees whose box lies inside the ball are reported without looking at the distances of their points
+	template <typename Callback>
+	void searchRadius(const Scalar* point, Scalar squaredRadius, Callback &callback) const {
+		int pendingNodes[TRAVERSAL_STACK_SIZE];
+		int pendingNodesNumber = 0;
+		pendingNodes[pendingNodesNumber++] = 0;
+
+		while (pendingNodesNumber > 0) {
+			int nodeIndex = pendingNodes[--pendingNodesNumber];
+			if (distanceToBox(nodeIndex, point) > squaredRadius) {
+				continue;
+			}
+
+			const KDTreeNode &currentNode = nodes_[nodeIndex];
+			if (farthestDistanceToBox(nodeIndex, point) <= squaredRadius) {
+				for (int currentPointPosition = currentNode.firstPoint; currentPointPosition < currentNode.lastPoint; ++currentPointPosition) {
+					callback(getIdentifier(currentPointPosition));
+				}
+
+				continue;
+			}
+
+			if (currentNode.isLeaf()) {
+				for (int currentPointPosition = currentNode.firstPoint; currentPointPosition < currentNode.lastPoint; ++currentPointPosition) {
+					if (distanceBetweenPoints<Dimension>(metric_, getPoint(currentPointPosition), point, dimension_) <= squaredRadius) {
+						callback(getIdentifier(currentPointPosition));
+					}
+				}
+
+				continue;
+			}
+
+			assert(pendingNodesNumber + 2 <= TRAVERSAL_STACK_SIZE);
+			pendingNodes[pendingNodesNumber++] = currentNode.rightChild;
+			pendingNodes[pendingNodesNumber++] = currentNode.leftChild;
+		}
+	}
+
+	//the neighbours of the point at a position are kept in a max-heap of at most k squared distances at heaps + position * k
+	void addGraphNeighbour(int queryPosition, int k, const Neighbour &candidate, Neighbour* heaps, int* heapSizes) const {
+		Neighbour* heap = heaps + static_cast<size_t>(queryPosition) * k;
+		int &heapSize = heapSizes[queryPosition];
+
+		if (heapSize < k) {
+			heap[heapSize++] = candidate;
+			std::push_heap(heap, heap + heapSize);
+		} else if (candidate < heap[0]) {
+			std::pop_heap(heap, heap + heapSize);
+			heap[heapSize - 1] = candidate;
+			std::push_heap(heap, heap + heapSize);
+		}
+	}
+
+	//true while the node may hold a point closer to the point at the query position than its k-th neighbour so far
+	bool isGraphNodeSearched(int queryPosition, int nodeIndex, int k, const Neighbour* heaps, const int* heapSizes) const {
+		return (heapSizes[queryPosition] < k) 
+			|| (distanceToBox(nodeIndex, getPoint(queryPosition)) <= heaps[static_cast<size_t>(queryPosition) * k].distance);
+	}
+
+	void addGraphNeighbours(const int* queryPositions, int queryPositionsNumber, int referenceLeaf, int k, Neighbour* heaps, int* heapSizes) const {
+		const KDTreeNode &referenceNode = nodes_[referenceLeaf];
+		Scalar blockDistances[LEAF_SCAN_BLOCK_SIZE];
+
+		for (int currentQuery = 0; currentQuery < queryPositionsNumber; ++currentQuery) {
+			int queryPosition = queryPositions[currentQuery];
+			const Scalar* point = getPoint(queryPosition);
+			int queryIdentifier = getIdentifier(queryPosition);
+
+			for (int blockBegin = referenceNode.firstPoint; blockBegin < referenceNode.lastPoint; blockBegin += LEAF_SCAN_BLOCK_SIZE) {
+				int blockEnd = std::min(blockBegin + LEAF_SCAN_BLOCK_SIZE, referenceNode.lastPoint);
+				getBlockDistances(referenceNode, blockBegin, blockEnd, point, blockDistances);
+
+				for (int currentPointPosition = blockBegin; currentPointPosition < blockEnd; ++currentPointPosition) {
+					int identifier = getIdentifier(currentPointPosition);
+					if (identifier != queryIdentifier) {
+						addGraphNeighbour(queryPosition, k, Neighbour(identifier, blockDistances[currentPointPosition - blockBegin]), heaps, heapSizes);
+					}
+				}
+			}
+		}
+	}
+
+	//one walk of the tree for all points of a query node, which is not split further: the reference nodes are walked
+	//depth-first, the child on the side of the center of the query box first; a reference node keeps the query points
+	//it may hold neighbours of, checked point by point, its children only check those and it is pruned when none is
+	//left, a shared walk of single-point searches rather than a dual-tree one; the points kept by the nodes
+	//of depth t - 1 are at activePositions + t * groupSize, the ones of the query node at t = 0,
+	//so the buffer holds getDepth() + 1 levels
+	void searchGraphNeighbours(int queryNodeIndex, int groupSize, int k, Neighbour* heaps, int* heapSizes, int* activePositions) const {
+		typedef std::pair<int, int> PendingNode;
+		PendingNode pendingNodes[TRAVERSAL_STACK_SIZE];
+		int activePositionsNumbers[TRAVERSAL_STACK_SIZE + 1];
+		int pendingNodesNumber = 0;
+
+		const KDTreeNode &queryNode = nodes_[queryNodeIndex];
+		const Scalar* queryLowerBorder = getLowerBorder(queryNodeIndex);
+		const Scalar* queryUpperBorder = getUpperBorder(queryNodeIndex);
+
+		activePositionsNumbers[0] = queryNode.lastPoint - queryNode.firstPoint;
+		for (int queryPosition = queryNode.firstPoint; queryPosition < queryNode.lastPoint; ++queryPosition) {
+			activePositions[queryPosition - queryNode.firstPoint] = queryPosition;
+		}
+		pendingNodes[pendingNodesNumber++] = PendingNode(0, 0);
+
+		while (pendingNodesNumber > 0) {
+			--pendingNodesNumber;
+			int nodeIndex = pendingNodes[pendingNodesNumber].first;
+			int depth = pendingNodes[pendingNodesNumber].second;
+
+			const int* parentPositions = activePositions + static_cast<size_t>(depth) * groupSize;
+			int* nodePositions = activePositions + static_cast<size_t>(depth + 1) * groupSize;
+			int &nodePositionsNumber = activePositionsNumbers[depth + 1];
+			nodePositionsNumber = 0;
+			for (int currentPosition = 0; currentPosition < activePositionsNumbers[depth]; ++currentPosition) {
+				if (isGraphNodeSearched(parentPositions[currentPosition], nodeIndex, k, heaps, heapSizes)) {
+					nodePositions[nodePositionsNumber++] = parentPositions[currentPosition];
+				}
+			}
+
+			const KDTreeNode &currentNode = nodes_[nodeIndex];
+			if (nodePositionsNumber == 0) {
+				continue;
+			}
+
+			if (currentNode.isLeaf()) {
+				addGraphNeighbours(nodePositions, nodePositionsNumber, nodeIndex, k, heaps, heapSizes);
+				continue;
+			}
+
+			Scalar centerCoordinate = (queryLowerBorder[currentNode.splitCoordinate] + queryUpperBorder[currentNode.splitCoordinate]) / 2;
+			int nearChild = currentNode.leftChild;
+			int farChild = currentNode.rightChild;
+			if (centerCoordinate - currentNode.leftUpperBorder >= currentNode.rightLowerBorder - centerCoordinate) {
+				std::swap(nearChild, farChild);
+			}
+
+			assert(pendingNodesNumber + 2 <= TRAVERSAL_STACK_SIZE);
+			pendingNodes[pendingNodesNumber++] = PendingNode(farChild, depth + 1);
+			pendingNodes[pendingNodesNumber++] = PendingNode(nearChild, depth + 1);
+		}
+	}
+
+	//query numbers sorted by the keys of the queries along the curve, the cells of the curve split the root box
+	void getQueryOrder(const BasicPointSet<Scalar> &queries, QueryOrder order, std::vector<int> &queryNumbers) const {
+		queryNumbers.resize(queries.size());
+		if ((order == ARRIVAL_QUERY_ORDER) || (nodesNumber_ == 0)) {
+			for (int currentQueryNumber = 0; currentQueryNumber < queries.size(); ++currentQueryNumber) {
+				queryNumbers[currentQueryNumber] = currentQueryNumber;
+			}
+
+			return;
+		}
+
+		int curveDimension = getCurveDimension(getDimension());
+		int curveBits = getCurveBits(getDimension(), queries.size());
+		double cellsNumber = static_cast<double>(1ULL << curveBits);
+		const Scalar* lowerBorder = getLowerBorder(0);
+		const Scalar* upperBorder = getUpperBorder(0);
+
+		typedef std::pair<unsigned long long, int> QueryKey;
+		std::vector<QueryKey> queryKeys(queries.size());
+		std::vector<unsigned int> cells(curveDimension);
+
+		for (int currentQueryNumber = 0; currentQueryNumber < queries.size(); ++currentQueryNumber) {
+			const Scalar* point = queries.getPoint(currentQueryNumber);
+			for (int currentCoordinate = 0; currentCoordinate < curveDimension; ++currentCoordinate) {
+				double width = static_cast<double>(upperBorder[currentCoordinate]) - lowerBorder[currentCoordinate];
+				double cell = (width > 0 ? (point[currentCoordinate] - lowerBorder[currentCoordinate]) / width * cellsNumber : 0);
+				cells[currentCoordinate] = static_cast<unsigned int>(std::min(std::max(cell, 0.0), cellsNumber - 1));
+			}
+
+			unsigned long long key = (order == MORTON_QUERY_ORDER ? getMortonKey(&cells[0], curveDimension, curveBits) 
+				: getHilbertKey(&cells[0], curveDimension, curveBits));
+			queryKeys[currentQueryNumber] = QueryKey(key, currentQueryNumber);
+		}
+
+		std::sort(queryKeys.begin(), queryKeys.end());
+		for (int currentQueryNumber = 0; currentQueryNumber < queries.size(); ++currentQueryNumber) {
+			queryNumbers[currentQueryNumber] = queryKeys[currentQueryNumber].second;
+		}
+	}
+
+	//the leaf of the previous query of a batch is scanned before the tree is walked, so its points bound the search
+	//from the start; leaf becomes the leaf of the found point, a negative leaf starts a plain search
+	int getMinDistanceIdentifierFromLeaf(const Scalar* point, double &distance, int &leaf) const {
+		Scalar squaredDistance = std::numeric_limits<Scalar>::max();
+		int resultIdentifier = -1;
+
+		if (nodesNumber_ > 0) {
+			NoSearchStats stats;
+			int seedLeaf = leaf;
+			if (seedLeaf >= 0) {
+				scanLeaf(nodes_[seedLeaf], point, squaredDistance, resultIdentifier, AllPointsFilter(), stats);
+			}
+
+			CellOffsets cellOffsets(getDimension());
+			searchCells(point, cellOffsets.offsets, [&](const KDTreeNode &currentLeaf) {
+				int leafIndex = static_cast<int>(&currentLeaf - nodes_);
+				if (leafIndex == seedLeaf) {
+					return;
+				}
+
+				int previousIdentifier = resultIdentifier;
+				Scalar previousDistance = squaredDistance;
+				scanLeaf(currentLeaf, point, squaredDistance, resultIdentifier, AllPointsFilter(), stats);
+				if ((resultIdentifier != previousIdentifier) || (squaredDistance != previousDistance)) {
+					leaf = leafIndex;
+				}
+			}, [&](Scalar cellDistance) {
+				return cellDistance < squaredDistance + EPS;
+			}, stats);
+		}
+
+		distance = metric_.getDistance(static_cast<double>(squaredDistance));
+		return resultIdentifier;
+	}
+
+	//the work is split over query nodes, not over pairs of query and reference nodes; the query nodes are
+	//independent, so they are split between the tasks of the pool when it is given
+	void buildKnnGraph(int k, ThreadPool* threadPool, int grainSize, KnnGraph &graph) const {
+		graph.rowOffsets.assign(pointsNumber_ + 1, 0);
+		graph.identifiers.clear();
+		graph.distances.clear();
+		if ((k <= 0) || (nodesNumber_ == 0)) {
+			return;
+		}
+
+		//the query nodes are the largest subtrees of at most groupSize points, they cover every point once
+		int groupSize = std::max(leafSize_, KNN_GRAPH_GROUP_SIZE);
+		std::vector<int> queryNodes;
+		for (int nodeIndex = 0; nodeIndex < nodesNumber_; ) {
+			const KDTreeNode &currentNode = nodes_[nodeIndex];
+			if (currentNode.lastPoint - currentNode.firstPoint <= groupSize) {
+				queryNodes.push_back(nodeIndex);
+				nodeIndex += getNodesNumbers(currentNode.lastPoint - currentNode.firstPoint).first;
+			} else {
+				++nodeIndex;
+			}
+		}
+
+		std::vector<Neighbour> heaps(static_cast<size_t>(pointsNumber_) * k);
+		std::vector<int> heapSizes(pointsNumber_, 0);
+		std::function<void(int, int)> searchQueryNodes = [&](int firstQueryNode, int lastQueryNode) {
+			std::vector<int> activePositions(static_cast<size_t>(getDepth() + 1) * groupSize);
+			for (int currentQueryNode = firstQueryNode; currentQueryNode < lastQueryNode; ++currentQueryNode) {
+				searchGraphNeighbours(queryNodes[currentQueryNode], groupSize, k, &heaps[0], &heapSizes[0], &activePositions[0]);
+			}
+		};
+
+		if (threadPool != NULL) {
+			parallelFor(*threadPool, 0, static_cast<int>(queryNodes.size()), grainSize, searchQueryNodes);
+		} else {
+			searchQueryNodes(0, static_cast<int>(queryNodes.size()));
+		}
+
+		for (int currentPointPosition = 0; currentPointPosition < pointsNumber_; ++currentPointPosition) {
+			graph.rowOffsets[permutation_[currentPointPosition] + 1] = heapSizes[currentPointPosition];
+		}
+		for (int currentPointNumber = 0; currentPointNumber < pointsNumber_; ++currentPointNumber) {
+			graph.rowOffsets[currentPointNumber + 1] += graph.rowOffsets[currentPointNumber];
+		}
+
+		graph.identifiers.resize(graph.rowOffsets[pointsNumber_]);
+		graph.distances.resize(graph.rowOffsets[pointsNumber_]);
+		for (int currentPointPosition = 0; currentPointPosition < pointsNumber_; ++currentPointPosition) {
+			Neighbour* heap = &heaps[static_cast<size_t>(currentPointPosition) * k];
+			std::sort_heap(heap, heap + heapSizes[currentPointPosition]);
+
+			int rowOffset = graph.rowOffsets[permutation_[currentPointPosition]];
+			for (int currentNeighbour = 0; currentNeighbour < heapSizes[currentPointPosition]; ++currentNeighbour) {
+				graph.identifiers[rowOffset + currentNeighbour] = heap[currentNeighbour].identifier;
+				graph.distances[rowOffset + currentNeighbour] = metric_.getDistance(heap[currentNeighbour].distance);
+			}
+		}
+	}
+
+	const char* getSectionData(int section) const {
+		switch (section) {
+		case NODES_SECTION:
+			return reinterpret_cast<const char*>(nodes_);
+		case BORDERS_SECTION:
+			return reinterpret_cast<const char*>(borders_);
+		case COORDINATES_SECTION:
+			return reinterpret_cast<const char*>(coordinates_);
+		case IDENTIFIERS_SECTION:
+			return reinterpret_cast<const char*>(identifiers_);
+		case PERMUTATION_SECTION:
+			return reinterpret_cast<const char*>(permutation_);
+		case GROUPS_SECTION:
+			return reinterpret_cast<const char*>(groups_);
+		default:
+			return reinterpret_cast<const char*>(firstGroups_);
+		}
+	}
+
+	static unsigned long long getSectionSize(const KDTreeFileHeader &header, int section) {
+		switch (section) {
+		case NODES_SECTION:
+			return static_cast<unsigned long long>(header.nodesNumber) * sizeof(KDTreeNode);
+		case BORDERS_SECTION:
+			return static_cast<unsigned long long>(header.nodesNumber) * 2 * header.dimension * sizeof(Scalar);
+		case COORDINATES_SECTION:
+			return static_cast<unsigned long long>(header.pointsNumber) * header.stride * sizeof(Scalar);
+		case GROUPS_SECTION:
+			return static_cast<unsigned long long>(header.groupsNumber) * KERNEL_GROUP_SIZE * header.dimension * sizeof(Scalar);
+		case FIRST_GROUPS_SECTION:
+			return (header.groupsNumber > 0 ? static_cast<unsigned long long>(header.nodesNumber) * sizeof(int) : 0);
+		default:
+			return static_cast<unsigned long long>(header.pointsNumber) * sizeof(int);
+		}
+	}
+
+	//fills the section offsets and the file size from the numbers of nodes and points
+	static void setFileLayout(KDTreeFileHeader &header) {
+		unsigned long long offset = sizeof(KDTreeFileHeader);
+		for (int currentSection = 0; currentSection < FILE_SECTIONS_NUMBER; ++currentSection) {
+			offset = (offset + KDTREE_FILE_ALIGNMENT - 1) / KDTREE_FILE_ALIGNMENT * KDTREE_FILE_ALIGNMENT;
+			header.sectionOffsets[currentSection] = offset;
+			offset += getSectionSize(header, currentSection);
+		}
+		header.fileSize = offset;
+	}
+
+	KDTreeFileHeader getFileHeader() const {
+		KDTreeFileHeader header;
+		memset(&header, 0, sizeof(header));
+
+		memcpy(header.magic, KDTREE_FILE_MAGIC, sizeof(header.magic));
+		header.version = KDTREE_FILE_VERSION;
+		header.byteOrder = KDTREE_FILE_BYTE_ORDER;
+		header.headerSize = sizeof(KDTreeFileHeader);
+		header.scalarSize = sizeof(Scalar);
+		header.nodeSize = sizeof(KDTreeNode);
+		header.leafSize = leafSize_;
+		header.dimension = getDimension();
+		header.stride = stride_;
+		header.nodesNumber = nodesNumber_;
+		header.pointsNumber = pointsNumber_;
+		header.kernelLevel = kernel_.level;
+		header.groupsNumber = groupsNumber_;
+		setFileLayout(header);
+
+		header.checksum = getSectionsChecksum(header);
+		return header;
+	}
+
+	unsigned long long getSectionsChecksum(const KDTreeFileHeader &header) const {
+		unsigned long long checksum = 14695981039346656037ULL;
+		for (int currentSection = 0; currentSection < FILE_SECTIONS_NUMBER; ++currentSection) {
+			checksum = getFileChecksum(getSectionData(currentSection), getSectionSize(header, currentSection), checksum);
+		}
+		return checksum;
+	}
+
+	//everything but the checksum, which can only be checked once the sections are attached
+	bool checkFileHeader(const KDTreeFileHeader &header, size_t fileSize) const {
+		if ((memcmp(header.magic, KDTREE_FILE_MAGIC, sizeof(header.magic)) != 0) || (header.version != KDTREE_FILE_VERSION) 
+			|| (header.byteOrder != KDTREE_FILE_BYTE_ORDER) || (header.headerSize != sizeof(KDTreeFileHeader))) {
+
+			return false;
+		}
+
+		if ((header.scalarSize != sizeof(Scalar)) || (header.nodeSize != sizeof(KDTreeNode)) || (header.leafSize < 1)) {
+			return false;
+		}
+
+		if ((header.dimension < 0) || ((Dimension != DYNAMIC_DIMENSION) && (header.dimension != Dimension)) 
+			|| (header.stride < header.dimension) || (header.pointsNumber < 0)) {
+
+			return false;
+		}
+
+		if (header.nodesNumber != (header.pointsNumber == 0 ? 0 : getNodesNumbers(header.pointsNumber).first)) {
+			return false;
+		}
+
+		if ((header.kernelLevel < SCALAR_KERNEL) || (header.kernelLevel > AVX512_KERNEL) || (header.groupsNumber < 0)) {
+			return false;
+		}
+
+		KDTreeFileHeader expectedLayout = header;
+		setFileLayout(expectedLayout);
+		return (header.fileSize == fileSize) && (expectedLayout.fileSize == fileSize) 
+			&& (memcmp(header.sectionOffsets, expectedLayout.sectionOffsets, sizeof(header.sectionOffsets)) == 0);
+	}
+
+	int countRadius(const Scalar* point, Scalar squaredRadius) const {
+		int pendingNodes[TRAVERSAL_STACK_SIZE];
+		int pendingNodesNumber = 0;
+		int pointsNumber = 0;
+		pendingNodes[pendingNodesNumber++] = 0;
+
+		while (pendingNodesNumber > 0) {
+			int nodeIndex = pendingNodes[--pendingNodesNumber];
+			if (distanceToBox(nodeIndex, point) > squaredRadius) {
+				continue;
+			}
+
+			const KDTreeNode &currentNode = nodes_[nodeIndex];
+			if (farthestDistanceToBox(nodeIndex, point) <= squaredRadius) {
+				pointsNumber += currentNode.lastPoint - currentNode.firstPoint;
+				continue;
+			}
+
+			if (currentNode.isLeaf()) {
+				for (int currentPointPosition = currentNode.firstPoint; currentPointPosition < currentNode.lastPoint; ++currentPointPosition) {
+					if (distanceBetweenPoints<Dimension>(metric_, getPoint(currentPointPosition), point, dimension_) <= squaredRadius) {
+						++pointsNumber;
+					}
+				}
+
+				continue;
+			}
+
+			assert(pendingNodesNumber + 2 <= TRAVERSAL_STACK_SIZE);
+			pendingNodes[pendingNodesNumber++] = currentNode.rightChild;
+			pendingNodes[pendingNodesNumber++] = currentNode.leftChild;
+		}
+
+		return pointsNumber;
+	}
+
+public:
+	BasicKDTree(const std::vector<TypePoint> &points) :
+		metric_() {
+
+		BasicPointSet<Scalar> sourcePoints;
+		convertPoints(points, &sourcePoints);
+		initialize(sourcePoints, KDTreeBuildParameters());
+	}
+
+	BasicKDTree(const std::vector<FixedPoint> &points) :
+		metric_() {
+
+		BasicPointSet<Scalar> sourcePoints(Dimension);
+		sourcePoints.reserve(points.size());
+
+		for (size_t currentPointNumber = 0; currentPointNumber < points.size(); ++currentPointNumber) {
+			sourcePoints.addPoint(points[currentPointNumber].data(), currentPointNumber);
+		}
+
+		initialize(sourcePoints, KDTreeBuildParameters());
+	}
+
+	BasicKDTree(const BasicPointSet<Scalar> &points) :
+		metric_() {
+
+		initialize(points, KDTreeBuildParameters());
+	}
+
+	BasicKDTree(const BasicPointSet<Scalar> &points, const KDTreeBuildParameters &parameters, const Metric &metric = Metric()) :
+		metric_(metric) {
+
+		initialize(points, parameters);
+	}
+
+	const Metric& getMetric() const {
+		return metric_;
+	}
+
+	int getDimension() const {
+		return (Dimension == DYNAMIC_DIMENSION ? dimension_ : Dimension);
+	}
+
+	int getPointsNumber() const {
+		return pointsNumber_;
+	}
+
+	//the leaf size and split rule the tree was built with, the tuned ones when the build was tuned
+	int getLeafSize() const {
+		return leafSize_;
+	}
+
+	KDTreeSplitRule getSplitRule() const {
+		return splitRule_;
+	}
+
+	//number of nodes on the longest path from the root to a leaf, the right halves are never smaller,
+	//so the rightmost path is the longest
+	int getDepth() const {
+		if (nodesNumber_ == 0) {
+			return 0;
+		}
+
+		int depth = 1;
+		for (int nodeIndex = 0; !nodes_[nodeIndex].isLeaf(); nodeIndex = nodes_[nodeIndex].rightChild) {
+			++depth;
+		}
+
+		return depth;
+	}
+
+	//true when the tree is a single leaf, so every query scans all points
+	bool isBruteForce() const {
+		return nodesNumber_ == 1;
+	}
+
+	//points are numbered in the order of the leaves, positions passed to point filters use the same numbering
+	const Scalar* getPoint(int pointPosition) const {
+		return coordinates_ + static_cast<size_t>(stride_) * pointPosition;
+	}
+
+	int getIdentifier(int pointPosition) const {
+		return identifiers_[pointPosition];
+	}
+
+	//number of the point in the set the tree was built from
+	int getSourcePointNumber(int pointPosition) const {
+		return permutation_[pointPosition];
+	}
+
+	//bytes taken by the nodes, boxes, points, permutation and transposed groups, whether they are owned or mapped
+	size_t getMemoryUsage() const {
+		return nodesNumber_ * sizeof(KDTreeNode) + static_cast<size_t>(nodesNumber_) * 2 * getDimension() * sizeof(Scalar) 
+			+ static_cast<size_t>(pointsNumber_) * (stride_ * sizeof(Scalar) + 2 * sizeof(int)) 
+			+ static_cast<size_t>(groupsNumber_) * KERNEL_GROUP_SIZE * getDimension() * sizeof(Scalar) + (groupsNumber_ > 0 ? nodesNumber_ * sizeof(int) : 0);
+	}
+
+	//the kernel the leaves are scanned by, it is not used when Dimension is fixed to at most MAX_INLINED_DIMENSION
+	const DistanceKernel& getDistanceKernel() const {
+		return kernel_;
+	}
+
+	//writes the tree in the format read by open, returns false if the file could not be written
+	bool save(const std::string &path) const {
+		std::ofstream file(path.c_str(), std::ios::binary);
+		if (!file) {
+			return false;
+		}
+
+		KDTreeFileHeader header = getFileHeader();
+		file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+		for (int currentSection = 0; currentSection < FILE_SECTIONS_NUMBER; ++currentSection) {
+			unsigned long long paddingSize = header.sectionOffsets[currentSection] - static_cast<unsigned long long>(file.tellp());
+			for (unsigned long long currentByte = 0; currentByte < paddingSize; ++currentByte) {
+				file.put(0);
+			}
+			file.write(getSectionData(currentSection), getSectionSize(header, currentSection));
+		}
+
+		file.close();
+		return !file.fail();
+	}
+
+	//maps a file written by save, the tree answers queries straight from the mapping in the given metric,
+	//the file does not record one; returns NULL when the file can not be mapped or is not a valid index for this tree type
+	static std::unique_ptr<BasicKDTree> open(const std::string &path, bool verifyChecksum = true, const Metric &metric = Metric()) {
+		std::unique_ptr<BasicKDTree> tree(new BasicKDTree(metric));
+		std::unique_ptr<MappedFile> mappedFile(new MappedFile());
+
+		KDTreeFileHeader header;
+		if (!mappedFile->open(path.c_str()) || (mappedFile->size() < sizeof(header))) {
+			return std::unique_ptr<BasicKDTree>();
+		}
+
+		memcpy(&header, mappedFile->data(), sizeof(header));
+		tree->leafSize_ = header.leafSize;
+		if (!tree->checkFileHeader(header, mappedFile->size())) {
+			return std::unique_ptr<BasicKDTree>();
+		}
+
+		const char* data = mappedFile->data();
+		tree->dimension_ = header.dimension;
+		tree->nodesNumber_ = header.nodesNumber;
+		tree->pointsNumber_ = header.pointsNumber;
+		tree->stride_ = header.stride;
+		tree->nodes_ = reinterpret_cast<const KDTreeNode*>(data + header.sectionOffsets[NODES_SECTION]);
+		tree->borders_ = reinterpret_cast<const Scalar*>(data + header.sectionOffsets[BORDERS_SECTION]);
+		tree->coordinates_ = reinterpret_cast<const Scalar*>(data + header.sectionOffsets[COORDINATES_SECTION]);
+		tree->identifiers_ = reinterpret_cast<const int*>(data + header.sectionOffsets[IDENTIFIERS_SECTION]);
+		tree->permutation_ = reinterpret_cast<const int*>(data + header.sectionOffsets[PERMUTATION_SECTION]);
+		tree->groupsNumber_ = header.groupsNumber;
+		tree->groups_ = reinterpret_cast<const Scalar*>(data + header.sectionOffsets[GROUPS_SECTION]);
+		tree->firstGroups_ = reinterpret_cast<const int*>(data + header.sectionOffsets[FIRST_GROUPS_SECTION]);
+		tree->mappedFile_ = std::move(mappedFile);
+
+		if (verifyChecksum && (tree->getSectionsChecksum(header) != header.checksum)) {
+			return std::unique_ptr<BasicKDTree>();
+		}
+
+		//the saved kernel is taken as it is, or the widest one below it this processor runs
+		tree->kernel_ = ::getDistanceKernel(static_cast<DistanceKernelLevel>(header.kernelLevel), 
+			header.groupsNumber > 0 ? TRANSPOSED_KERNEL_LAYOUT : ROW_KERNEL_LAYOUT);
+		return tree;
+	}
+
+	//continues a search whose best squared distance so far is squaredDistance,
+	//points whose positions are rejected by filter(position) are skipped
+	template <typename PointFilter>
+	void updateMinDistance(const Scalar* point, Scalar &squaredDistance, int &identifier, const PointFilter &filter) const {
+		NoSearchStats stats;
+		updateMinDistance(point, squaredDistance, identifier, filter, stats);
+	}
+
+	//same search, the work it does is counted in stats
+	template <typename PointFilter, typename Stats>
+	void updateMinDistance(const Scalar* point, Scalar &squaredDistance, int &identifier, const PointFilter &filter, Stats &stats) const {
+		if (nodesNumber_ > 0) {
+			CellOffsets cellOffsets(getDimension());
+			getMinDistance(point, cellOffsets.offsets, squaredDistance, identifier, filter, stats);
+		}
+	}
+
+	//adds candidates to a max-heap of at most k neighbours with squared distances
+	template <typename PointFilter>
+	void updateKNearest(const Scalar* point, int k, std::vector<Neighbour> &neighbours, const PointFilter &filter) const {
+		if (nodesNumber_ > 0) {
+			CellOffsets cellOffsets(getDimension());
+			getKNearestNeighbours(point, cellOffsets.offsets, k, neighbours, filter);
+		}
+	}
+
+	int getMinDistanceIdentifier(const Scalar* point, double &distance) const {
+		int resultIdentifier = -1;
+		Scalar squaredDistance = std::numeric_limits<Scalar>::max();
+
+		updateMinDistance(point, squaredDistance, resultIdentifier, AllPointsFilter());
+
+		distance = metric_.getDistance(static_cast<double>(squaredDistance));
+		return resultIdentifier;
+	}
+
+	int getMinDistanceIdentifier(const Scalar* point, double &distance, SearchStats &stats) const {
+		int resultIdentifier = -1;
+		Scalar squaredDistance = std::numeric_limits<Scalar>::max();
+
+		updateMinDistance(point, squaredDistance, resultIdentifier, AllPointsFilter(), stats);
+
+		distance = metric_.getDistance(static_cast<double>(squaredDistance));
+		return resultIdentifier;
+	}
+
+	int getMinDistanceIdentifier(const FixedPoint &point, double &distance) const {
+		return getMinDistanceIdentifier(point.data(), distance);
+	}
+
+	//the coordinates of a TypePoint are doubles, trees of doubles search for them in place, other trees convert them
+	//on the stack like the cell offsets, so nothing is allocated up to STACK_OFFSETS_DIMENSION coordinates
+	int getMinDistanceIdentifier(const TypePoint &point, double &distance) const {
+		if (std::is_same<Scalar, double>::value) {
+			return getMinDistanceIdentifier(reinterpret_cast<const Scalar*>(point.coordinates.data()), distance);
+		}
+
+		Scalar stackCoordinates[STACK_OFFSETS_DIMENSION];
+		std::vector<Scalar> heapCoordinates;
+		Scalar* coordinates = stackCoordinates;
+		if (point.getDimension() > STACK_OFFSETS_DIMENSION) {
+			heapCoordinates.resize(point.getDimension());
+			coordinates = &heapCoordinates[0];
+		}
+
+		std::copy(point.coordinates.begin(), point.coordinates.end(), coordinates);
+		return getMinDistanceIdentifier(coordinates, distance);
+	}
+
+	//fills neighbours with the k closest points sorted by distance, no memory is allocated when neighbours
+	//already has capacity for k elements and the dimension is at most STACK_OFFSETS_DIMENSION
+	void getKNearest(const Scalar* point, int k, std::vector<Neighbour> &neighbours) const {
+		neighbours.clear();
+		if (k <= 0) {
+			return;
+		}
+
+		updateKNearest(point, k, neighbours, AllPointsFilter());
+		std::sort_heap(neighbours.begin(), neighbours.end());
+
+		for (size_t currentNeighbour = 0; currentNeighbour < neighbours.size(); ++currentNeighbour) {
+			neighbours[currentNeighbour].distance = metric_.getDistance(neighbours[currentNeighbour].distance);
+		}
+	}
+
+	//calls callback(identifier) for every point at distance at most radius, in no particular order
+	template <typename Callback>
+	void radiusSearch(const Scalar* point, double radius, Callback callback) const {
+		if (nodesNumber_ > 0) {
+			searchRadius(point, static_cast<Scalar>(metric_.getMetricDistance(radius)), callback);
+		}
+	}
+
+	void radiusSearch(const Scalar* point, double radius, std::vector<int> &identifiers) const {
+		identifiers.clear();
+		radiusSearch(point, radius, [&identifiers](int identifier) {
+			identifiers.push_back(identifier);
+		});
+	}
+
+	int radiusCount(const Scalar* point, double radius) const {
+		return (nodesNumber_ == 0 ? 0 : countRadius(point, static_cast<Scalar>(metric_.getMetricDistance(radius))));
+	}
+
+	//best-bin-first search: pending subtrees are visited in the order of their distance to the point;
+	//exact is false when a subtree which might hold a closer point was skipped
+	int getApproximateMinDistanceIdentifier(const Scalar* point, double &distance, const ApproximateSearchParameters &parameters, bool &exact) const {
+		typedef std::pair<Scalar, int> PendingNode;
+		std::vector<PendingNode> pendingNodes;
+		pendingNodes.reserve(64);
+
+		Scalar pruningFactor = static_cast<Scalar>(metric_.getMetricDistance(1 + parameters.epsilon));
+		Scalar squaredDistance = std::numeric_limits<Scalar>::max();
+		int resultIdentifier = -1;
+		int leavesNumber = 0;
+		exact = true;
+
+		if (nodesNumber_ > 0) {
+			pendingNodes.push_back(PendingNode(distanceToBox(0, point), 0));
+		}
+
+		while (!pendingNodes.empty()) {
+			std::pop_heap(pendingNodes.begin(), pendingNodes.end(), std::greater<PendingNode>());
+			PendingNode currentPendingNode = pendingNodes.back();
+			pendingNodes.pop_back();
+
+			if (currentPendingNode.first >= squaredDistance) {
+				break;
+			}
+
+			if ((currentPendingNode.first * pruningFactor >= squaredDistance) 
+				|| ((parameters.maxLeavesNumber > 0) && (leavesNumber >= parameters.maxLeavesNumber))) {
+
+				exact = false;
+				break;
+			}
+
+			int nodeIndex = currentPendingNode.second;
+			while (!nodes_[nodeIndex].isLeaf()) {
+				int nearChild = nodes_[nodeIndex].leftChild;
+				int farChild = nodes_[nodeIndex].rightChild;
+				Scalar nearChildDistance = distanceToBox(nearChild, point);
+				Scalar farChildDistance = distanceToBox(farChild, point);
+
+				if (farChildDistance < nearChildDistance) {
+					std::swap(nearChild, farChild);
+					std::swap(nearChildDistance, farChildDistance);
+				}
+
+				if (farChildDistance * pruningFactor < squaredDistance) {
+					pendingNodes.push_back(PendingNode(farChildDistance, farChild));
+					std::push_heap(pendingNodes.begin(), pendingNodes.end(), std::greater<PendingNode>());
+				} else if (farChildDistance < squaredDistance) {
+					exact = false;
+				}
+
+				nodeIndex = nearChild;
+			}
+
+			NoSearchStats stats;
+			scanLeaf(nodes_[nodeIndex], point, squaredDistance, resultIdentifier, AllPointsFilter(), stats);
+			++leavesNumber;
+		}
+
+		distance = metric_.getDistance(static_cast<double>(squaredDistance));
+		return resultIdentifier;
+	}
+
+	//the k nearest neighbours of every point of the tree, points with the identifier of the point itself are skipped
+	void buildKnnGraph(int k, KnnGraph &graph) const {
+		buildKnnGraph(k, NULL, DEFAULT_KNN_GRAPH_GRAIN_SIZE, graph);
+	}
+
+	void buildKnnGraph(int k, KnnGraph &graph, ThreadPool &threadPool, int grainSize = DEFAULT_KNN_GRAPH_GRAIN_SIZE) const {
+		buildKnnGraph(k, &threadPool, grainSize, graph);
+	}
+
+	//answers every query of the set, results go to the same positions of identifiers and distances
+	void queryBatch(const BasicPointSet<Scalar> &queries, Span<int> identifiers, Span<double> distances, ThreadPool &threadPool, 
+		int grainSize = DEFAULT_QUERY_GRAIN_SIZE) const {
+
+		assert((identifiers.size() >= static_cast<size_t>(queries.size())) && (distances.size() >= static_cast<size_t>(queries.size())));
+
+		parallelFor(threadPool, 0, queries.size(), grainSize, [&](int firstQuery, int lastQuery) {
+			for (int currentQueryNumber = firstQuery; currentQueryNumber < lastQuery; ++currentQueryNumber) {
+				identifiers[currentQueryNumber] = getMinDistanceIdentifier(queries.getPoint(currentQueryNumber), distances[currentQueryNumber]);
+			}
+		});
+	}
+
+	//queries ordered along a curve are searched one after another by every task, each search starting
+	//with the leaf of the previous one; the results still go to the positions of the queries, but of points
+	//at tied distances the one reported depends on the searches before, so it may differ from arrival order
+	void queryBatch(const BasicPointSet<Scalar> &queries, Span<int> identifiers, Span<double> distances, ThreadPool &threadPool, 
+		QueryOrder order, int grainSize = DEFAULT_QUERY_GRAIN_SIZE) const {
+
+		if (order == ARRIVAL_QUERY_ORDER) {
+			queryBatch(queries, identifiers, distances, threadPool, grainSize);
+			return;
+		}
+
+		assert((identifiers.size() >= static_cast<size_t>(queries.size())) && (distances.size() >= static_cast<size_t>(queries.size())));
+		std::vector<int> queryNumbers;
+		getQueryOrder(queries, order, queryNumbers);
+
+		parallelFor(threadPool, 0, queries.size(), grainSize, [&](int firstQuery, int lastQuery) {
+			int leaf = -1;
+			for (int currentQuery = firstQuery; currentQuery < lastQuery; ++currentQuery) {
+				int queryNumber = queryNumbers[currentQuery];
+				identifiers[queryNumber] = getMinDistanceIdentifierFromLeaf(queries.getPoint(queryNumber), distances[queryNumber], leaf);
+			}
+		});
+	}
+
+	//same as above, the counters of every query are collected into histogram
+	void queryBatch(const BasicPointSet<Scalar> &queries, Span<int> identifiers, Span<double> distances, ThreadPool &threadPool, 
+		SearchStatsHistogram &histogram, int grainSize = DEFAULT_QUERY_GRAIN_SIZE) const {
+
+		assert((identifiers.size() >= static_cast<size_t>(queries.size())) && (distances.size() >= static_cast<size_t>(queries.size())));
+		std::mutex histogramMutex;
+
+		parallelFor(threadPool, 0, queries.size(), grainSize, [&](int firstQuery, int lastQuery) {
+			SearchStatsHistogram rangeHistogram;
+			for (int currentQueryNumber = firstQuery; currentQueryNumber < lastQuery; ++currentQueryNumber) {
+				SearchStats stats;
+				identifiers[currentQueryNumber] = getMinDistanceIdentifier(queries.getPoint(currentQueryNumber), distances[currentQueryNumber], stats);
+				rangeHistogram.add(stats);
+			}
+
+			std::lock_guard<std::mutex> lock(histogramMutex);
+			histogram.merge(rangeHistogram);
+		});
+	}
+};
+
+//std::max binds KNN_GRAPH_GROUP_SIZE to a reference, which needs its definition
+template <int Dimension, typename Scalar, typename Metric>
+const int BasicKDTree<Dimension, Scalar, Metric>::KNN_GRAPH_GROUP_SIZE;
+
+typedef BasicKDTree<DYNAMIC_DIMENSION, double> KDTree;
+
+//stdin is read through one shared reader, so the functions below can follow each other
+FastInput& getStandardInput() {
+	static FastInput input(stdin);
+	return input;
+}
+
+void inputPoints(FastInput &input, PointSet* points) {
+	int pointsNumber = 0;
+	int dimension = 0;
+
+	input.readInt(pointsNumber);
+	input.readInt(dimension);
+	(*points).changeDimension(dimension);
+	(*points).resize(pointsNumber);
+
+	for (int currentPointNumber = 0; currentPointNumber < pointsNumber; ++currentPointNumber) {
+		(*points).setIdentifier(currentPointNumber, currentPointNumber);
+
+		double* currentPoint = (*points).getPoint(currentPointNumber);
+		for (int currentCoordinate = 0; currentCoordinate < dimension; ++currentCoordinate) {
+			input.readDouble(currentPoint[currentCoordinate]);
+		}
+	}
+}
+
+void inputPoints(PointSet* points) {
+	inputPoints(getStandardInput(), points);
+}
+
+void inputPoints(std::vector<TypePoint>* points) {
+	FastInput &input = getStandardInput();
+	int pointsNumber = 0;
+	int dimension = 0;
+
+	input.readInt(pointsNumber);
+	input.readInt(dimension);
+	(*points).resize(pointsNumber);
+
+	for (int currentPointNumber = 0; currentPointNumber < pointsNumber; ++currentPointNumber) {
+		(*points)[currentPointNumber].changeDimension(dimension);
+		(*points)[currentPointNumber].identifier = currentPointNumber;
+
+		for (int currentCoordinate = 0; currentCoordinate < dimension; ++currentCoordinate) {
+			input.readDouble((*points)[currentPointNumber].coordinates[currentCoordinate]);
+		}
+	}
+}
+
+//arrival order answers every request the same way whatever the threads, a curve order is faster but may report
+//another point of several at tied distances
+void answerRequests(const KDTree& tree, int dimension, FastInput &input, FastOutput &output, ThreadPool &threadPool, 
+	QueryOrder order = ARRIVAL_QUERY_ORDER) {
+
+	int requestsNumber = 0;
+	input.readInt(requestsNumber);
+
+	PointSet requestPoints(dimension);
+	requestPoints.resize(requestsNumber);
+	for (int currentRequestNumber = 0; currentRequestNumber < requestsNumber; ++currentRequestNumber) {
+		double* currentPoint = requestPoints.getPoint(currentRequestNumber);
+		for (int currentCoordinate = 0; currentCoordinate < dimension; ++currentCoordinate) {
+			input.readDouble(currentPoint[currentCoordinate]);
+		}
+	}
+
+	std::vector<int> identifiers(requestsNumber);
+	std::vector<double> distances(requestsNumber);
+	tree.queryBatch(requestPoints, identifiers, distances, threadPool, order);
+
+	for (int currentRequestNumber = 0; currentRequestNumber < requestsNumber; ++currentRequestNumber) {
+		output.writeInt(identifiers[currentRequestNumber]);
+		output.writeChar(' ');
+		output.writeDouble(distances[currentRequestNumber]);
+		output.writeChar('\n');
+	}
+
+	output.flush();
+}
+
+void answerRequests(const KDTree& tree, int dimension, ThreadPool &threadPool) {
+	std::cout.flush();
+	FastOutput output(stdout);
+	answerRequests(tree, dimension, getStandardInput(), output, threadPool);
+}
+
+void answerRequests(const KDTree& tree, int dimension) {
+	ThreadPool threadPool;
+	answerRequests(tree, dimension, threadPool);
+}
@@ -0,0 +1,254 @@
+#pragma once
+#include <vector>
+#include <memory>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <functional>
+#include <limits>
+#include <cassert>
+
+#include "KDTree.h"
+
+//readers hold one of this many slots while they use a snapshot, more readers at once wait for a free slot
+const int KDTREE_HANDLE_READER_SLOTS_NUMBER = 128;
+//every slot is aligned to a cache line of its own, so readers on different cores do not write to the same line
+const int KDTREE_HANDLE_SLOT_SIZE = 64;
+
+//a published tree shared by concurrent readers and replaced as a whole by a writer, for example by a tree rebuilt
+//from fresh data in the background; readers take no lock: a reader writes the current epoch into a free slot,
+//loads the tree and clears the slot when it is done, a writer swaps the tree, advances the epoch and retires
+//the old tree with the epoch it was replaced in; only readers whose slots hold that epoch or an earlier one
+//might have loaded it, so it is deleted as soon as no slot does (epoch based reclamation)
+template <int Dimension, typename Scalar, typename Metric = EuclideanMetric>
+class BasicKDTreeHandle {
+public:
+	typedef BasicKDTree<Dimension, Scalar, Metric> Tree;
+
+private:
+	static const unsigned long long FREE_SLOT = 0;
+
+	struct alignas(KDTREE_HANDLE_SLOT_SIZE) ReaderSlot {
+		std::atomic<unsigned long long> epoch;
+
+		ReaderSlot() :
+			epoch(FREE_SLOT) {
+
+			//do nothing
+		}
+	};
+
+	struct RetiredTree {
+		unsigned long long epoch;
+		std::unique_ptr<const Tree> tree;
+	};
+
+	std::atomic<const Tree*> tree_;
+	std::atomic<unsigned long long> epoch_;
+	mutable ReaderSlot readerSlots_[KDTREE_HANDLE_READER_SLOTS_NUMBER];
+
+	//writers publish one at a time, the retired trees are only touched under this lock
+	mutable std::mutex writerMutex_;
+	std::vector<RetiredTree> retiredTrees_;
+	unsigned long long publishedTreesNumber_;
+
+	std::thread rebuildThread_;
+
+	BasicKDTreeHandle(const BasicKDTreeHandle &);
+	BasicKDTreeHandle& operator=(const BasicKDTreeHandle &);
+
+	//a thread starts looking from the slot it took last time, so it usually finds it free at once
+	ReaderSlot* enterReader() const {
+		static thread_local int slotHint = -1;
+		if (slotHint < 0) {
+			slotHint = std::hash<std::thread::id>()(std::this_thread::get_id()) % KDTREE_HANDLE_READER_SLOTS_NUMBER;
+		}
+
+		while (true) {
+			for (int currentAttempt = 0; currentAttempt < KDTREE_HANDLE_READER_SLOTS_NUMBER; ++currentAttempt) {
+				int slotIndex = (slotHint + currentAttempt) % KDTREE_HANDLE_READER_SLOTS_NUMBER;
+				ReaderSlot &slot = readerSlots_[slotIndex];
+				unsigned long long freeSlot = FREE_SLOT;
+
+				if ((slot.epoch.load(std::memory_order_relaxed) == FREE_SLOT) && slot.epoch.compare_exchange_strong(freeSlot, epoch_.load())) {
+					slotHint = slotIndex;
+					return &slot;
+				}
+			}
+
+			std::this_thread::yield();
+		}
+	}
+
+	static void leaveReader(ReaderSlot* slot) {
+		slot->epoch.store(FREE_SLOT);
+	}
+
+	//the smallest epoch readers entered in, or the largest possible one when no reader is inside
+	unsigned long long getOldestReaderEpoch() const {
+		unsigned long long oldestEpoch = std::numeric_limits<unsigned long long>::max();
+
+		for (int currentSlot = 0; currentSlot < KDTREE_HANDLE_READER_SLOTS_NUMBER; ++currentSlot) {
+			unsigned long long slotEpoch = readerSlots_[currentSlot].epoch.load();
+			if (slotEpoch != FREE_SLOT) {
+				oldestEpoch = std::min(oldestEpoch, slotEpoch);
+			}
+		}
+
+		return oldestEpoch;
+	}
+
+	//deletes the retired trees no reader can hold any more and returns the number of the ones left,
+	//called with writerMutex_ locked
+	int deleteUnreachableTrees() {
+		unsigned long long oldestReaderEpoch = getOldestReaderEpoch();
+		size_t keptTreesNumber = 0;
+
+		for (size_t currentTree = 0; currentTree < retiredTrees_.size(); ++currentTree) {
+			if (retiredTrees_[currentTree].epoch >= oldestReaderEpoch) {
+				retiredTrees_[keptTreesNumber++] = std::move(retiredTrees_[currentTree]);
+			}
+		}
+
+		retiredTrees_.resize(keptTreesNumber);
+		return keptTreesNumber;
+	}
+
+public:
+	//the tree a reader loaded when it was created, it stays valid until the snapshot is destroyed
+	//even when other trees are published meanwhile; a snapshot must not outlive its handle
+	class Snapshot {
+	private:
+		ReaderSlot* slot_;
+		const Tree* tree_;
+
+		Snapshot(const Snapshot &);
+		Snapshot& operator=(const Snapshot &);
+
+	public:
+		explicit Snapshot(const BasicKDTreeHandle &handle) :
+			slot_(handle.enterReader()),
+			tree_(handle.tree_.load()) {
+
+			//do nothing
+		}
+
+		~Snapshot() {
+			leaveReader(slot_);
+		}
+
+		//NULL until the first tree is published
+		const Tree* get() const {
+			return tree_;
+		}
+
+		const Tree& operator*() const {
+			return *tree_;
+		}
+
+		const Tree* operator->() const {
+			return tree_;
+		}
+	};
+
+	BasicKDTreeHandle() :
+		tree_(NULL),
+		epoch_(FREE_SLOT + 1),
+		publishedTreesNumber_(0) {
+
+		//do nothing
+	}
+
+	explicit BasicKDTreeHandle(std::unique_ptr<Tree> tree) :
+		tree_(tree.release()),
+		epoch_(FREE_SLOT + 1),
+		publishedTreesNumber_(1) {
+
+		//do nothing
+	}
+
+	//waits for the rebuild in progress, no snapshot may be alive
+	~BasicKDTreeHandle() {
+		waitForRebuild();
+		assert(getOldestReaderEpoch() == std::numeric_limits<unsigned long long>::max());
+		delete tree_.load();
+	}
+
+	//replaces the tree for the snapshots taken from now on, the old tree is deleted here when no reader holds it,
+	//otherwise by a later publish, waitForRebuild, synchronize or reclaimRetiredTrees
+	void publish(std::unique_ptr<Tree> tree) {
+		std::lock_guard<std::mutex> lock(writerMutex_);
+
+		RetiredTree retiredTree;
+		retiredTree.tree.reset(tree_.exchange(tree.release()));
+		retiredTree.epoch = epoch_.fetch_add(1);
+		++publishedTreesNumber_;
+
+		if (retiredTree.tree) {
+			retiredTrees_.push_back(std::move(retiredTree));
+		}
+		deleteUnreachableTrees();
+	}
+
+	//deletes the retired trees whose readers are gone, returns the number of the ones still held
+	int reclaimRetiredTrees() {
+		std::lock_guard<std::mutex> lock(writerMutex_);
+		return deleteUnreachableTrees();
+	}
+
+	//waits until every tree replaced so far is deleted, that is until the snapshots taken before are destroyed;
+	//it must not be called by a thread holding a snapshot
+	void synchronize() {
+		while (reclaimRetiredTrees() > 0) {
+			std::this_thread::yield();
+		}
+	}
+
+	//builds a tree over a copy of the points on a thread of its own and publishes it, a rebuild started earlier
+	//is finished first; the builder never waits for readers, so a thread holding a snapshot may start and wait
+	//for rebuilds, the old tree is deleted by a later publish, waitForRebuild or reclaimRetiredTrees once
+	//its readers are gone; rebuilds are started and waited for by one thread
+	void rebuildAsync(const BasicPointSet<Scalar> &points, const KDTreeBuildParameters &parameters, const Metric &metric = Metric()) {
+		waitForRebuild();
+
+		rebuildThread_ = std::thread([this, points, parameters, metric]() {
+			publish(std::unique_ptr<Tree>(new Tree(points, parameters, metric)));
+		});
+	}
+
+	void waitForRebuild() {
+		if (rebuildThread_.joinable()) {
+			rebuildThread_.join();
+			reclaimRetiredTrees();
+		}
+	}
+
+	//the number of trees published so far, the one the handle was created with included
+	unsigned long long getPublishedTreesNumber() const {
+		std::lock_guard<std::mutex> lock(writerMutex_);
+		return publishedTreesNumber_;
+	}
+
+	//the search of KDTree on a snapshot, -1 when no tree is published yet
+	int getMinDistanceIdentifier(const Scalar* point, double &distance) const {
+		Snapshot snapshot(*this);
+		if (snapshot.get() == NULL) {
+			distance = std::numeric_limits<double>::max();
+			return -1;
+		}
+
+		return snapshot->getMinDistanceIdentifier(point, distance);
+	}
+
+	void getKNearest(const Scalar* point, int k, std::vector<Neighbour> &neighbours) const {
+		Snapshot snapshot(*this);
+		if (snapshot.get() == NULL) {
+			neighbours.clear();
+			return;
+		}
+
+		snapshot->getKNearest(point, k, neighbours);
+	}
+};
+
+typedef BasicKDTreeHandle<DYNAMIC_DIMENSION, double> KDTreeHandle;
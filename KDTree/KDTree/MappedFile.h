@@ -0,0 +1,127 @@
+#pragma once
+#include <cstddef>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+//read-only view of a whole file mapped into memory, the mapping lives as long as the object
+class MappedFile {
+private:
+	const char* data_;
+	size_t size_;
+
+#ifdef _WIN32
+	HANDLE file_;
+	HANDLE mapping_;
+#endif
+
+	MappedFile(const MappedFile &);
+	MappedFile& operator=(const MappedFile &);
+
+public:
+	MappedFile() :
+		data_(NULL),
+		size_(0) {
+
+#ifdef _WIN32
+		file_ = INVALID_HANDLE_VALUE;
+		mapping_ = NULL;
+#endif
+	}
+
+	~MappedFile() {
+		close();
+	}
+
+	bool open(const char* path) {
+		close();
+
+#ifdef _WIN32
+		file_ = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+		if (file_ == INVALID_HANDLE_VALUE) {
+			return false;
+		}
+
+		LARGE_INTEGER fileSize;
+		if (!GetFileSizeEx(file_, &fileSize) || (fileSize.QuadPart == 0)) {
+			close();
+			return false;
+		}
+
+		mapping_ = CreateFileMappingA(file_, NULL, PAGE_READONLY, 0, 0, NULL);
+		if (mapping_ == NULL) {
+			close();
+			return false;
+		}
+
+		data_ = static_cast<const char*>(MapViewOfFile(mapping_, FILE_MAP_READ, 0, 0, 0));
+		if (data_ == NULL) {
+			close();
+			return false;
+		}
+		size_ = static_cast<size_t>(fileSize.QuadPart);
+#else
+		int file = ::open(path, O_RDONLY);
+		if (file < 0) {
+			return false;
+		}
+
+		struct stat fileStatus;
+		if ((fstat(file, &fileStatus) != 0) || (fileStatus.st_size == 0)) {
+			::close(file);
+			return false;
+		}
+
+		void* mapping = mmap(NULL, fileStatus.st_size, PROT_READ, MAP_SHARED, file, 0);
+		::close(file);
+		if (mapping == MAP_FAILED) {
+			return false;
+		}
+
+		data_ = static_cast<const char*>(mapping);
+		size_ = fileStatus.st_size;
+#endif
+
+		return true;
+	}
+
+	void close() {
+#ifdef _WIN32
+		if (data_ != NULL) {
+			UnmapViewOfFile(data_);
+		}
+		if (mapping_ != NULL) {
+			CloseHandle(mapping_);
+		}
+		if (file_ != INVALID_HANDLE_VALUE) {
+			CloseHandle(file_);
+		}
+		file_ = INVALID_HANDLE_VALUE;
+		mapping_ = NULL;
+#else
+		if (data_ != NULL) {
+			munmap(const_cast<char*>(data_), size_);
+		}
+#endif
+
+		data_ = NULL;
+		size_ = 0;
+	}
+
+	const char* data() const {
+		return data_;
+	}
+
+	size_t size() const {
+		return size_;
+	}
+};
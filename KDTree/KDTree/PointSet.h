@@ -0,0 +1,179 @@
+#pragma once
+#include <cstdlib>
+#include <cstddef>
+#include <new>
+#include <vector>
+
+//rows are padded to a whole number of AVX registers, so vector code never needs a scalar tail
+const int POINT_SET_SIMD_BYTES = 32;
+const size_t POINT_SET_ALIGNMENT = 64;
+
+template <typename Type, size_t Alignment>
+class AlignedAllocator {
+public:
+	typedef Type value_type;
+
+	template <typename OtherType>
+	struct rebind {
+		typedef AlignedAllocator<OtherType, Alignment> other;
+	};
+
+	AlignedAllocator() {
+		//do nothing
+	}
+
+	template <typename OtherType>
+	AlignedAllocator(const AlignedAllocator<OtherType, Alignment> &) {
+		//do nothing
+	}
+
+	Type* allocate(size_t elementsNumber) {
+		//the distance to the block returned by malloc is kept right before the aligned block
+		size_t bytesNumber = elementsNumber * sizeof(Type) + Alignment + sizeof(void*);
+		char* block = static_cast<char*>(malloc(bytesNumber));
+		if (block == NULL) {
+			throw std::bad_alloc();
+		}
+
+		size_t address = reinterpret_cast<size_t>(block + sizeof(void*));
+		char* alignedBlock = reinterpret_cast<char*>((address + Alignment - 1) & ~(Alignment - 1));
+		reinterpret_cast<void**>(alignedBlock)[-1] = block;
+
+		return reinterpret_cast<Type*>(alignedBlock);
+	}
+
+	void deallocate(Type* alignedBlock, size_t) {
+		free(reinterpret_cast<void**>(alignedBlock)[-1]);
+	}
+
+	bool operator==(const AlignedAllocator &) const {
+		return true;
+	}
+
+	bool operator!=(const AlignedAllocator &) const {
+		return false;
+	}
+};
+
+template <typename Scalar>
+class BasicPointSet {
+public:
+	typedef std::vector<Scalar, AlignedAllocator<Scalar, POINT_SET_ALIGNMENT> > AlignedCoordinates;
+
+private:
+	int dimension_;
+	int stride_;
+
+	//row-major coordinates, every row holds stride_ values and the padding is kept zero
+	AlignedCoordinates coordinates_;
+	std::vector<int> identifiers_;
+
+	//column-major copy, built only on request
+	AlignedCoordinates columns_;
+
+	static int getPaddedDimension(int dimension) {
+		const int simdWidth = POINT_SET_SIMD_BYTES / sizeof(Scalar);
+		return (dimension + simdWidth - 1) / simdWidth * simdWidth;
+	}
+
+public:
+	BasicPointSet() :
+		dimension_(0),
+		stride_(0) {
+
+		//do nothing
+	}
+
+	explicit BasicPointSet(int dimension) :
+		dimension_(dimension),
+		stride_(getPaddedDimension(dimension)) {
+
+		//do nothing
+	}
+
+	void changeDimension(int newDimension) {
+		dimension_ = newDimension;
+		stride_ = getPaddedDimension(newDimension);
+		coordinates_.assign(stride_ * identifiers_.size(), 0);
+		columns_.clear();
+	}
+
+	void reserve(int pointsNumber) {
+		coordinates_.reserve(static_cast<size_t>(stride_) * pointsNumber);
+		identifiers_.reserve(pointsNumber);
+	}
+
+	void resize(int pointsNumber) {
+		coordinates_.resize(static_cast<size_t>(stride_) * pointsNumber, 0);
+		identifiers_.resize(pointsNumber, 0);
+		columns_.clear();
+	}
+
+	template <typename SourceScalar>
+	void addPoint(const SourceScalar* coordinates, int identifier) {
+		coordinates_.resize(coordinates_.size() + stride_, 0);
+		Scalar* point = &coordinates_[coordinates_.size() - stride_];
+		for (int currentCoordinate = 0; currentCoordinate < dimension_; ++currentCoordinate) {
+			point[currentCoordinate] = static_cast<Scalar>(coordinates[currentCoordinate]);
+		}
+
+		identifiers_.push_back(identifier);
+		columns_.clear();
+	}
+
+	int size() const {
+		return identifiers_.size();
+	}
+
+	int getDimension() const {
+		return dimension_;
+	}
+
+	int getStride() const {
+		return stride_;
+	}
+
+	Scalar* getPoint(int pointNumber) {
+		return &coordinates_[static_cast<size_t>(stride_) * pointNumber];
+	}
+
+	const Scalar* getPoint(int pointNumber) const {
+		return &coordinates_[static_cast<size_t>(stride_) * pointNumber];
+	}
+
+	int getIdentifier(int pointNumber) const {
+		return identifiers_[pointNumber];
+	}
+
+	void setIdentifier(int pointNumber, int identifier) {
+		identifiers_[pointNumber] = identifier;
+	}
+
+	const Scalar* getCoordinates() const {
+		return coordinates_.empty() ? NULL : &coordinates_[0];
+	}
+
+	const int* getIdentifiers() const {
+		return identifiers_.empty() ? NULL : &identifiers_[0];
+	}
+
+	void buildColumnView() {
+		columns_.resize(dimension_ * identifiers_.size());
+		for (size_t currentPointNumber = 0; currentPointNumber < identifiers_.size(); ++currentPointNumber) {
+			for (int currentCoordinate = 0; currentCoordinate < dimension_; ++currentCoordinate) {
+				columns_[currentCoordinate * identifiers_.size() + currentPointNumber] = coordinates_[stride_ * currentPointNumber + currentCoordinate];
+			}
+		}
+	}
+
+	bool hasColumnView() const {
+		return !identifiers_.empty() && columns_.size() == dimension_ * identifiers_.size();
+	}
+
+	//valid until the set is modified, buildColumnView must be called first
+	const Scalar* getColumn(int coordinate) const {
+		return &columns_[coordinate * identifiers_.size()];
+	}
+};
+
+typedef BasicPointSet<double> PointSet;
@@ -0,0 +1,158 @@
+#pragma once
+#include <vector>
+#include <algorithm>
+
+//search statistics are passed to the searches as a template argument, the empty sink below
+//leaves no trace in the generated code, so plain searches pay nothing for them
+
+struct NoSearchStats {
+	void visitNode() {
+		//do nothing
+	}
+
+	void scanLeaf() {
+		//do nothing
+	}
+
+	void computeDistances(int) {
+		//do nothing
+	}
+
+	void pruneSubtree() {
+		//do nothing
+	}
+};
+
+//counters of one query
+struct SearchStats {
+	int nodesVisited;
+	int leavesScanned;
+	int distancesComputed;
+	//far subtrees rejected by the box check
+	int subtreesPruned;
+
+	SearchStats() :
+		nodesVisited(0),
+		leavesScanned(0),
+		distancesComputed(0),
+		subtreesPruned(0) {
+
+		//do nothing
+	}
+
+	void visitNode() {
+		++nodesVisited;
+	}
+
+	void scanLeaf() {
+		++leavesScanned;
+	}
+
+	void computeDistances(int number) {
+		distancesComputed += number;
+	}
+
+	void pruneSubtree() {
+		++subtreesPruned;
+	}
+};
+
+const int STATS_HISTOGRAM_BUCKETS_NUMBER = 32;
+
+//bucket 0 counts zeros, bucket b counts values in [2^(b - 1), 2^b)
+class CounterHistogram {
+private:
+	std::vector<long long> buckets_;
+	long long valuesNumber_;
+	long long total_;
+	int maximum_;
+
+	static int getBucket(int value) {
+		int bucket = 0;
+		while ((value > 0) && (bucket + 1 < STATS_HISTOGRAM_BUCKETS_NUMBER)) {
+			value >>= 1;
+			++bucket;
+		}
+
+		return bucket;
+	}
+
+public:
+	CounterHistogram() :
+		buckets_(STATS_HISTOGRAM_BUCKETS_NUMBER, 0),
+		valuesNumber_(0),
+		total_(0),
+		maximum_(0) {
+
+		//do nothing
+	}
+
+	void add(int value) {
+		++buckets_[getBucket(value)];
+		++valuesNumber_;
+		total_ += value;
+		maximum_ = std::max(maximum_, value);
+	}
+
+	void merge(const CounterHistogram &other) {
+		for (int currentBucket = 0; currentBucket < STATS_HISTOGRAM_BUCKETS_NUMBER; ++currentBucket) {
+			buckets_[currentBucket] += other.buckets_[currentBucket];
+		}
+		valuesNumber_ += other.valuesNumber_;
+		total_ += other.total_;
+		maximum_ = std::max(maximum_, other.maximum_);
+	}
+
+	long long getBucketCount(int bucket) const {
+		return buckets_[bucket];
+	}
+
+	long long getValuesNumber() const {
+		return valuesNumber_;
+	}
+
+	double getMean() const {
+		return (valuesNumber_ == 0 ? 0 : static_cast<double>(total_) / valuesNumber_);
+	}
+
+	int getMaximum() const {
+		return maximum_;
+	}
+
+	//upper bound of the bucket holding the given fraction of the values, exact up to a factor of two
+	int getPercentile(double fraction) const {
+		long long rank = static_cast<long long>(fraction * valuesNumber_);
+		long long counted = 0;
+
+		for (int currentBucket = 0; currentBucket < STATS_HISTOGRAM_BUCKETS_NUMBER; ++currentBucket) {
+			counted += buckets_[currentBucket];
+			if (counted > rank) {
+				return static_cast<int>(std::min<long long>(maximum_, (1LL << currentBucket) - 1));
+			}
+		}
+
+		return maximum_;
+	}
+};
+
+//distribution of the counters over a batch of queries
+struct SearchStatsHistogram {
+	CounterHistogram nodesVisited;
+	CounterHistogram leavesScanned;
+	CounterHistogram distancesComputed;
+	CounterHistogram subtreesPruned;
+
+	void add(const SearchStats &stats) {
+		nodesVisited.add(stats.nodesVisited);
+		leavesScanned.add(stats.leavesScanned);
+		distancesComputed.add(stats.distancesComputed);
+		subtreesPruned.add(stats.subtreesPruned);
+	}
+
+	void merge(const SearchStatsHistogram &other) {
+		nodesVisited.merge(other.nodesVisited);
+		leavesScanned.merge(other.leavesScanned);
+		distancesComputed.merge(other.distancesComputed);
+		subtreesPruned.merge(other.subtreesPruned);
+	}
+};
@@ -0,0 +1,78 @@
+#pragma once
+#include <algorithm>
+
+//order in which a batch of queries is searched, queries close on a curve are close in space,
+//so consecutive searches walk the same parts of the tree
+enum QueryOrder {
+	ARRIVAL_QUERY_ORDER,
+	MORTON_QUERY_ORDER,
+	HILBERT_QUERY_ORDER
+};
+
+const int CURVE_KEY_BITS = 64;
+const int MAX_CURVE_CELL_BITS = 32;
+//bits of a key beyond the ones needed to tell the points apart, so close points still get ordered
+const int EXTRA_CURVE_KEY_BITS = 4;
+
+//keys have CURVE_KEY_BITS bits shared by the coordinates, coordinates beyond CURVE_KEY_BITS are left out
+int getCurveDimension(int dimension) {
+	return std::min(dimension, CURVE_KEY_BITS);
+}
+
+//a finer grid than the points fill only makes the keys slower to compute
+int getCurveBits(int dimension, int pointsNumber) {
+	int keyBits = EXTRA_CURVE_KEY_BITS;
+	while ((keyBits < CURVE_KEY_BITS) && ((1LL << (keyBits - EXTRA_CURVE_KEY_BITS)) < pointsNumber)) {
+		++keyBits;
+	}
+
+	int curveDimension = getCurveDimension(dimension);
+	return std::max(1, std::min((keyBits + curveDimension - 1) / curveDimension, std::min(CURVE_KEY_BITS / curveDimension, MAX_CURVE_CELL_BITS)));
+}
+
+//cells are numbers in [0, 2^bits) along every coordinate, the key takes the highest bits of all of them first
+unsigned long long getMortonKey(const unsigned int* cells, int dimension, int bits) {
+	unsigned long long key = 0;
+
+	for (int currentBit = bits - 1; currentBit >= 0; --currentBit) {
+		for (int currentCoordinate = 0; currentCoordinate < dimension; ++currentCoordinate) {
+			key = (key << 1) | ((cells[currentCoordinate] >> currentBit) & 1);
+		}
+	}
+
+	return key;
+}
+
+//Skilling's transform ("Programming the Hilbert curve", 2004) turns the cells into the transposed Hilbert index,
+//whose bits are interleaved the same way as the ones of a Morton key; the cells are overwritten
+unsigned long long getHilbertKey(unsigned int* cells, int dimension, int bits) {
+	unsigned int highestBit = 1U << (bits - 1);
+
+	for (unsigned int currentBit = highestBit; currentBit > 1; currentBit >>= 1) {
+		unsigned int lowerBits = currentBit - 1;
+		for (int currentCoordinate = 0; currentCoordinate < dimension; ++currentCoordinate) {
+			//a set bit inverts the lower bits of the first cell, otherwise they are exchanged with the ones of this cell;
+			//both are done with masks, the bits are close to random and a branch would be mispredicted half of the time
+			unsigned int setMask = 0U - ((cells[currentCoordinate] & currentBit) != 0 ? 1U : 0U);
+			unsigned int exchangedBits = (cells[0] ^ cells[currentCoordinate]) & lowerBits & ~setMask;
+			cells[0] ^= (lowerBits & setMask) | exchangedBits;
+			cells[currentCoordinate] ^= exchangedBits;
+		}
+	}
+
+	for (int currentCoordinate = 1; currentCoordinate < dimension; ++currentCoordinate) {
+		cells[currentCoordinate] ^= cells[currentCoordinate - 1];
+	}
+
+	unsigned int grayBits = 0;
+	for (unsigned int currentBit = highestBit; currentBit > 1; currentBit >>= 1) {
+		if ((cells[dimension - 1] & currentBit) != 0) {
+			grayBits ^= currentBit - 1;
+		}
+	}
+	for (int currentCoordinate = 0; currentCoordinate < dimension; ++currentCoordinate) {
+		cells[currentCoordinate] ^= grayBits;
+	}
+
+	return getMortonKey(cells, dimension, bits);
+}
@@ -0,0 +1,46 @@
+#pragma once
+#include <cstddef>
+#include <vector>
+
+//non-owning view of a contiguous array, the caller keeps the storage alive
+template <typename Type>
+class Span {
+private:
+	Type* data_;
+	size_t size_;
+
+public:
+	Span() :
+		data_(NULL),
+		size_(0) {
+
+		//do nothing
+	}
+
+	Span(Type* data, size_t size) :
+		data_(data),
+		size_(size) {
+
+		//do nothing
+	}
+
+	template <typename Allocator>
+	Span(std::vector<Type, Allocator> &values) :
+		data_(values.empty() ? NULL : &values[0]),
+		size_(values.size()) {
+
+		//do nothing
+	}
+
+	Type* data() const {
+		return data_;
+	}
+
+	size_t size() const {
+		return size_;
+	}
+
+	Type& operator[](size_t index) const {
+		return data_[index];
+	}
+};
@@ -0,0 +1,217 @@
+#pragma once
+#include <vector>
+#include <algorithm>
+#include <deque>
+#include <memory>
+#include <functional>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+
+//every worker owns a deque, it takes its own tasks from the back and steals from the front of the others
+class ThreadPool {
+private:
+	struct TaskQueue {
+		std::mutex mutex;
+		std::deque<std::function<void()> > tasks;
+	};
+
+	struct WorkerContext {
+		const ThreadPool* pool;
+		int queueIndex;
+	};
+
+	std::vector<std::thread> threads_;
+
+	//the last queue takes tasks submitted by threads which do not belong to the pool
+	std::vector<std::unique_ptr<TaskQueue> > queues_;
+	std::atomic<int> pendingTasks_;
+	std::atomic<int> nextExternalQueue_;
+	std::atomic<bool> stopping_;
+
+	std::mutex sleepMutex_;
+	std::condition_variable wakeUp_;
+
+	static WorkerContext& getWorkerContext() {
+		static thread_local WorkerContext context = {NULL, 0};
+		return context;
+	}
+
+	int getCurrentQueueIndex() const {
+		const WorkerContext &context = getWorkerContext();
+		return (context.pool == this ? context.queueIndex : -1);
+	}
+
+	bool popTask(int queueIndex, bool fromBack, std::function<void()> &task) {
+		TaskQueue &queue = *queues_[queueIndex];
+		std::lock_guard<std::mutex> lock(queue.mutex);
+		if (queue.tasks.empty()) {
+			return false;
+		}
+
+		if (fromBack) {
+			task.swap(queue.tasks.back());
+			queue.tasks.pop_back();
+		} else {
+			task.swap(queue.tasks.front());
+			queue.tasks.pop_front();
+		}
+		--pendingTasks_;
+
+		return true;
+	}
+
+	void workerLoop(int queueIndex) {
+		getWorkerContext().pool = this;
+		getWorkerContext().queueIndex = queueIndex;
+
+		while (!stopping_) {
+			if (runPendingTask()) {
+				continue;
+			}
+
+			std::unique_lock<std::mutex> lock(sleepMutex_);
+			wakeUp_.wait(lock, [this]() {
+				return (pendingTasks_ > 0) || stopping_;
+			});
+		}
+	}
+
+public:
+	explicit ThreadPool(int threadsNumber = std::thread::hardware_concurrency()) :
+		pendingTasks_(0),
+		nextExternalQueue_(0),
+		stopping_(false) {
+
+		if (threadsNumber < 1) {
+			threadsNumber = 1;
+		}
+
+		for (int currentQueue = 0; currentQueue <= threadsNumber; ++currentQueue) {
+			queues_.push_back(std::unique_ptr<TaskQueue>(new TaskQueue()));
+		}
+
+		for (int currentThread = 0; currentThread < threadsNumber; ++currentThread) {
+			threads_.push_back(std::thread(&ThreadPool::workerLoop, this, currentThread));
+		}
+	}
+
+	~ThreadPool() {
+		{
+			std::lock_guard<std::mutex> lock(sleepMutex_);
+			stopping_ = true;
+		}
+		wakeUp_.notify_all();
+
+		for (size_t currentThread = 0; currentThread < threads_.size(); ++currentThread) {
+			threads_[currentThread].join();
+		}
+	}
+
+	int getThreadsNumber() const {
+		return threads_.size();
+	}
+
+	void submit(const std::function<void()> &task) {
+		int queueIndex = getCurrentQueueIndex();
+		if (queueIndex < 0) {
+			queueIndex = queues_.size() - 1;
+		}
+
+		{
+			std::lock_guard<std::mutex> lock(queues_[queueIndex]->mutex);
+			queues_[queueIndex]->tasks.push_back(task);
+		}
+		++pendingTasks_;
+
+		{
+			std::lock_guard<std::mutex> lock(sleepMutex_);
+		}
+		wakeUp_.notify_one();
+	}
+
+	//runs one queued task in the calling thread, returns false if there was nothing to run
+	bool runPendingTask() {
+		std::function<void()> task;
+		int ownQueue = getCurrentQueueIndex();
+
+		if ((ownQueue >= 0) && popTask(ownQueue, true, task)) {
+			task();
+			return true;
+		}
+
+		int firstVictim = (ownQueue >= 0 ? ownQueue + 1 : nextExternalQueue_++);
+		for (size_t currentVictim = 0; currentVictim < queues_.size(); ++currentVictim) {
+			int victimIndex = (firstVictim + currentVictim) % queues_.size();
+			if ((victimIndex != ownQueue) && popTask(victimIndex, false, task)) {
+				task();
+				return true;
+			}
+		}
+
+		return false;
+	}
+};
+
+//tracks a set of tasks, a waiting thread keeps running queued tasks instead of blocking
+class TaskGroup {
+private:
+	ThreadPool &pool_;
+	std::atomic<int> unfinishedTasks_;
+
+	TaskGroup(const TaskGroup &);
+	TaskGroup& operator=(const TaskGroup &);
+
+public:
+	explicit TaskGroup(ThreadPool &pool) :
+		pool_(pool),
+		unfinishedTasks_(0) {
+
+		//do nothing
+	}
+
+	~TaskGroup() {
+		wait();
+	}
+
+	void run(const std::function<void()> &task) {
+		++unfinishedTasks_;
+		pool_.submit([this, task]() {
+			task();
+			--unfinishedTasks_;
+		});
+	}
+
+	void wait() {
+		while (unfinishedTasks_ > 0) {
+			if (!pool_.runPendingTask()) {
+				std::this_thread::yield();
+			}
+		}
+	}
+};
+
+//calls body(chunkBegin, chunkEnd) for consecutive chunks of [begin, end) of at least grainSize elements,
+//a grain size below one is taken as one
+template <typename Body>
+void parallelFor(ThreadPool &pool, int begin, int end, int grainSize, const Body &body) {
+	grainSize = std::max(grainSize, 1);
+	int chunksNumber = std::min(pool.getThreadsNumber() * 4, (end - begin + grainSize - 1) / grainSize);
+	if (chunksNumber <= 1) {
+		body(begin, end);
+		return;
+	}
+
+	TaskGroup group(pool);
+	for (int currentChunk = 1; currentChunk < chunksNumber; ++currentChunk) {
+		int chunkBegin = begin + static_cast<long long>(end - begin) * currentChunk / chunksNumber;
+		int chunkEnd = begin + static_cast<long long>(end - begin) * (currentChunk + 1) / chunksNumber;
+		group.run([&body, chunkBegin, chunkEnd]() {
+			body(chunkBegin, chunkEnd);
+		});
+	}
+
+	body(begin, begin + (end - begin) / chunksNumber);
+	group.wait();
+}
@@ -1,14 +1,54 @@
 #include "KDTree.h"
+#include "DynamicKDTree.h"
+#include "CompactKDTree.h"
+#include "BruteForce.h"
+#include "KDForest.h"
+#include "BallTree.h"
+#include "KDTreeHandle.h"
 
 #include <iostream>
 #include <random>
 #include <ctime>
 #include <cmath>
 #include <vector>
+#include <algorithm>
+#include <fstream>
+#include <cstdio>
+#include <sstream>
+#include <iomanip>
+#include <thread>
+#include <atomic>
 
 const int POINTS_NUMBER = 10000;
 const int REQUESTS_NUMBER = 10000;
 const int DIMENSION = 10;
+const int PARALLEL_GRAIN_SIZE = 256;
+const int THREADS_NUMBER = 4;
+const int K_NEAREST_NUMBER = 10;
+const int K_NEAREST_REQUESTS_NUMBER = 1000;
+const int RADIUS_REQUESTS_NUMBER = 1000;
+const double SEARCH_RADIUS = 120.0;
+const double APPROXIMATION_EPSILON = 0.5;
+const int MAX_LEAVES_NUMBER = 32;
+const int DYNAMIC_REQUESTS_NUMBER = 1000;
+const char* const INDEX_FILE_NAME = "test_index.kdt";
+const char* const NUMBERS_FILE_NAME = "test_numbers.txt";
+const char* const EXACT_TREE_FILE_NAME = "test_exact.kdt";
+const int FAST_IO_NUMBERS_NUMBER = 100000;
+const int LEAF_SIZE_REQUESTS_NUMBER = 1000;
+const int CHECKED_LEAF_SIZES[] = {1, 5, 32};
+const int KERNEL_BLOCKS_NUMBER = 1000;
+const int MAX_KERNEL_BLOCK_SIZE = 40;
+const int MAX_KERNEL_DIMENSION = 24;
+const int BRUTE_FORCE_POINTS_NUMBER = 300;
+const int KNN_GRAPH_CHECKED_POINTS_NUMBER = 1000;
+const int FOREST_REQUESTS_NUMBER = 1000;
+const int METRIC_REQUESTS_NUMBER = 1000;
+const double MAX_METRIC_WEIGHT = 2.0;
+const int HANDLE_REQUESTS_NUMBER = 1000;
+const int TIED_GRID_SIZE = 16;
+const int TIED_REQUESTS_NUMBER = 2000;
+const int HANDLE_REBUILDS_NUMBER = 8;
 
 const double MIN_COORDINATE_VALUE = -100.0;
 const double MAX_COORDINATE_VALUE = 100.0;
@@ -16,30 +56,28 @@ const double MAX_COORDINATE_VALUE = 100.0;
 std::default_random_engine engine(time(NULL));
 std::uniform_real_distribution<> randomGenerator(MIN_COORDINATE_VALUE, MAX_COORDINATE_VALUE);
 
-void genPoints(std::vector<TypePoint>* points, int pointsNumber) {
+void genPoints(PointSet* points, int pointsNumber) {
+	(*points).changeDimension(DIMENSION);
 	(*points).resize(pointsNumber);
 
 	for (int currentPointNumber = 0; currentPointNumber < pointsNumber; ++currentPointNumber) {
-		(*points)[currentPointNumber].changeDimension(DIMENSION);
-		(*points)[currentPointNumber].identifier = currentPointNumber;
+		(*points).setIdentifier(currentPointNumber, currentPointNumber);
 
+		double* currentPoint = (*points).getPoint(currentPointNumber);
 		for (int currentCoordinate = 0; currentCoordinate < DIMENSION; ++currentCoordinate) {
-			(*points)[currentPointNumber].coordinates[currentCoordinate] = randomGenerator(engine);
+			currentPoint[currentCoordinate] = randomGenerator(engine);
 		}
 	}
 }
 
-double simpleAlgoritm(const std::vector<TypePoint> &points, const TypePoint &requestPoint) {
-	double distance = distanceBetweenPoints(points[0], requestPoint);
-
-	for (int currentPointNumber = 1; currentPointNumber < POINTS_NUMBER; ++currentPointNumber) {
-		double newDistance = distanceBetweenPoints(points[currentPointNumber], requestPoint);
-		if (newDistance + EPS < distance) {
-			distance = newDistance;
-		}
+void simpleKNearest(const PointSet &points, const double* requestPoint, int k, std::vector<double>* distances) {
+	(*distances).resize(points.size());
+	for (int currentPointNumber = 0; currentPointNumber < points.size(); ++currentPointNumber) {
+		(*distances)[currentPointNumber] = sqrt(distanceBetweenPoints(points.getPoint(currentPointNumber), requestPoint, DIMENSION));
 	}
 
-	return sqrt(distance);
+	std::sort((*distances).begin(), (*distances).end());
+	(*distances).resize(std::min(k, points.size()));
 }
 
 bool checkDistances(double firstDistance, double secondDistance) {
@@ -50,18 +88,18 @@ bool checkDistances(double firstDistance, double secondDistance) {
 	}
 }
 
-void processRequests(const KDTree& tree, const std::vector<TypePoint> &points, const std::vector<TypePoint> &requestPoints) {
+//the batches searched along the curves must give the same results in the order of the requests
+void processRequests(const KDTree& tree, const PointSet &points, const PointSet &requestPoints, ThreadPool &threadPool) {
+	std::vector<int> KDTReeResultIdentifiers(REQUESTS_NUMBER);
 	std::vector<double> KDTReeResultDistances(REQUESTS_NUMBER);
+	std::vector<int> orderedResultIdentifiers(REQUESTS_NUMBER);
+	std::vector<double> orderedResultDistances(REQUESTS_NUMBER);
 	bool resultsCorrect = true;
 
-	for (size_t currentRequestNumber = 0; currentRequestNumber < requestPoints.size(); ++currentRequestNumber) {
-		double curKDTReeResultDistance = 0;
-		tree.getMinDistanceIdentifier(requestPoints[currentRequestNumber], curKDTReeResultDistance);
-		KDTReeResultDistances[currentRequestNumber] = curKDTReeResultDistance;
-	}
+	tree.queryBatch(requestPoints, KDTReeResultIdentifiers, KDTReeResultDistances, threadPool);
 
-	for (size_t currentRequestNumber = 0; currentRequestNumber < requestPoints.size(); ++currentRequestNumber) {
-		double simpleAlgoritmResult = simpleAlgoritm(points, requestPoints[currentRequestNumber]);
+	for (int currentRequestNumber = 0; currentRequestNumber < requestPoints.size(); ++currentRequestNumber) {
+		double simpleAlgoritmResult = simpleAlgoritm(points, requestPoints.getPoint(currentRequestNumber));
 
 		if (!checkDistances(simpleAlgoritmResult, KDTReeResultDistances[currentRequestNumber])) {
 			std::cout << std::setprecision(15) << simpleAlgoritmResult << ' ';
@@ -70,6 +108,14 @@ void processRequests(const KDTree& tree, const std::vector<TypePoint> &points, c
 		}
 	}
 
+	for (int currentOrder = MORTON_QUERY_ORDER; currentOrder <= HILBERT_QUERY_ORDER; ++currentOrder) {
+		tree.queryBatch(requestPoints, orderedResultIdentifiers, orderedResultDistances, threadPool, static_cast<QueryOrder>(currentOrder));
+		resultsCorrect = resultsCorrect && (orderedResultIdentifiers == KDTReeResultIdentifiers);
+
+		for (int currentRequestNumber = 0; currentRequestNumber < requestPoints.size(); ++currentRequestNumber) {
+			resultsCorrect = resultsCorrect && checkDistances(orderedResultDistances[currentRequestNumber], KDTReeResultDistances[currentRequestNumber]);
+		}
+	}
 
 	if (resultsCorrect) {
 		std::cout << "results are correct" << std::endl;
@@ -78,16 +124,937 @@ void processRequests(const KDTree& tree, const std::vector<TypePoint> &points, c
 	}
 }
 
+//points of an integer grid searched from half-integer points are at tied distances, arrival order batches
+//must answer them as the single searches do with any number of threads
+void processTiedRequests() {
+	const int tiedDimension = 3;
+	PointSet points(tiedDimension);
+	for (int currentPointNumber = 0; currentPointNumber < TIED_GRID_SIZE * TIED_GRID_SIZE * TIED_GRID_SIZE; ++currentPointNumber) {
+		double point[tiedDimension] = {static_cast<double>(currentPointNumber % TIED_GRID_SIZE), 
+			static_cast<double>(currentPointNumber / TIED_GRID_SIZE % TIED_GRID_SIZE), static_cast<double>(currentPointNumber / TIED_GRID_SIZE / TIED_GRID_SIZE)};
+		points.addPoint(point, currentPointNumber);
+	}
+
+	std::uniform_int_distribution<int> cellGenerator(0, 2 * TIED_GRID_SIZE - 2);
+	PointSet requestPoints(tiedDimension);
+	requestPoints.resize(TIED_REQUESTS_NUMBER);
+	for (int currentRequestNumber = 0; currentRequestNumber < TIED_REQUESTS_NUMBER; ++currentRequestNumber) {
+		for (int currentCoordinate = 0; currentCoordinate < tiedDimension; ++currentCoordinate) {
+			requestPoints.getPoint(currentRequestNumber)[currentCoordinate] = cellGenerator(engine) / 2.0;
+		}
+	}
+
+	KDTree tree(points);
+	std::vector<int> expectedIdentifiers(TIED_REQUESTS_NUMBER);
+	for (int currentRequestNumber = 0; currentRequestNumber < TIED_REQUESTS_NUMBER; ++currentRequestNumber) {
+		double distance = 0;
+		expectedIdentifiers[currentRequestNumber] = tree.getMinDistanceIdentifier(requestPoints.getPoint(currentRequestNumber), distance);
+	}
+
+	bool resultsCorrect = true;
+	for (int threadsNumber = 1; threadsNumber <= THREADS_NUMBER; threadsNumber *= 2) {
+		ThreadPool threadPool(threadsNumber);
+		std::vector<int> identifiers(TIED_REQUESTS_NUMBER);
+		std::vector<double> distances(TIED_REQUESTS_NUMBER);
+		tree.queryBatch(requestPoints, identifiers, distances, threadPool, ARRIVAL_QUERY_ORDER, 1);
+		resultsCorrect = resultsCorrect && (identifiers == expectedIdentifiers);
+	}
+
+	if (resultsCorrect) {
+		std::cout << "tied results are correct" << std::endl;
+	} else {
+		std::cout << "tied results are incorrect" << std::endl;
+	}
+}
+
+void processKNearestRequests(const KDTree& tree, const PointSet &points, const PointSet &requestPoints) {
+	std::vector<Neighbour> neighbours;
+	std::vector<double> simpleAlgoritmDistances;
+	bool resultsCorrect = true;
+
+	for (int currentRequestNumber = 0; currentRequestNumber < K_NEAREST_REQUESTS_NUMBER; ++currentRequestNumber) {
+		tree.getKNearest(requestPoints.getPoint(currentRequestNumber), K_NEAREST_NUMBER, neighbours);
+		simpleKNearest(points, requestPoints.getPoint(currentRequestNumber), K_NEAREST_NUMBER, &simpleAlgoritmDistances);
+
+		if (neighbours.size() != simpleAlgoritmDistances.size()) {
+			resultsCorrect = false;
+			continue;
+		}
+
+		for (size_t currentNeighbour = 0; currentNeighbour < neighbours.size(); ++currentNeighbour) {
+			const double* neighbourPoint = points.getPoint(neighbours[currentNeighbour].identifier);
+			double neighbourDistance = sqrt(distanceBetweenPoints(neighbourPoint, requestPoints.getPoint(currentRequestNumber), DIMENSION));
+
+			if (!checkDistances(simpleAlgoritmDistances[currentNeighbour], neighbours[currentNeighbour].distance)
+				|| !checkDistances(neighbourDistance, neighbours[currentNeighbour].distance)) {
+
+				resultsCorrect = false;
+			}
+		}
+	}
+
+	if (resultsCorrect) {
+		std::cout << "k nearest results are correct" << std::endl;
+	} else {
+		std::cout << "k nearest results are incorrect" << std::endl;
+	}
+}
+
+void processRadiusRequests(const KDTree& tree, const PointSet &points, const PointSet &requestPoints) {
+	std::vector<int> identifiers;
+	std::vector<int> simpleAlgoritmIdentifiers;
+	bool resultsCorrect = true;
+
+	for (int currentRequestNumber = 0; currentRequestNumber < RADIUS_REQUESTS_NUMBER; ++currentRequestNumber) {
+		const double* requestPoint = requestPoints.getPoint(currentRequestNumber);
+
+		simpleAlgoritmIdentifiers.clear();
+		for (int currentPointNumber = 0; currentPointNumber < points.size(); ++currentPointNumber) {
+			if (distanceBetweenPoints(points.getPoint(currentPointNumber), requestPoint, DIMENSION) <= SEARCH_RADIUS * SEARCH_RADIUS) {
+				simpleAlgoritmIdentifiers.push_back(points.getIdentifier(currentPointNumber));
+			}
+		}
+
+		tree.radiusSearch(requestPoint, SEARCH_RADIUS, identifiers);
+		std::sort(identifiers.begin(), identifiers.end());
+
+		if ((identifiers != simpleAlgoritmIdentifiers) || (tree.radiusCount(requestPoint, SEARCH_RADIUS) != static_cast<int>(identifiers.size()))) {
+			resultsCorrect = false;
+		}
+	}
+
+	if (resultsCorrect) {
+		std::cout << "radius results are correct" << std::endl;
+	} else {
+		std::cout << "radius results are incorrect" << std::endl;
+	}
+}
+
+void processApproximateRequests(const KDTree& tree, const PointSet &requestPoints) {
+	bool resultsCorrect = true;
+
+	for (int currentRequestNumber = 0; currentRequestNumber < requestPoints.size(); ++currentRequestNumber) {
+		const double* requestPoint = requestPoints.getPoint(currentRequestNumber);
+		double distance = 0, approximateDistance = 0, budgetDistance = 0;
+		bool exact = false, approximateExact = false, budgetExact = false;
+
+		tree.getMinDistanceIdentifier(requestPoint, distance);
+		tree.getApproximateMinDistanceIdentifier(requestPoint, approximateDistance, ApproximateSearchParameters(), exact);
+		if (!exact || !checkDistances(distance, approximateDistance)) {
+			resultsCorrect = false;
+		}
+
+		tree.getApproximateMinDistanceIdentifier(requestPoint, approximateDistance, ApproximateSearchParameters(APPROXIMATION_EPSILON, 0), approximateExact);
+		if ((approximateDistance > (1 + APPROXIMATION_EPSILON) * distance + EPS) || (approximateExact && !checkDistances(distance, approximateDistance))) {
+			resultsCorrect = false;
+		}
+
+		tree.getApproximateMinDistanceIdentifier(requestPoint, budgetDistance, ApproximateSearchParameters(0, MAX_LEAVES_NUMBER), budgetExact);
+		if ((budgetDistance + EPS < distance) || (budgetExact && !checkDistances(distance, budgetDistance))) {
+			resultsCorrect = false;
+		}
+	}
+
+	if (resultsCorrect) {
+		std::cout << "approximate results are correct" << std::endl;
+	} else {
+		std::cout << "approximate results are incorrect" << std::endl;
+	}
+}
+
+void checkDynamicTree(const PointSet &points, const PointSet &requestPoints) {
+	DynamicKDTree dynamicTree(DIMENSION);
+	std::vector<char> livePoints(points.size(), 0);
+
+	for (int currentPointNumber = 0; currentPointNumber < points.size(); ++currentPointNumber) {
+		dynamicTree.insert(points.getPoint(currentPointNumber), points.getIdentifier(currentPointNumber));
+		livePoints[currentPointNumber] = 1;
+
+		if (currentPointNumber % 3 == 2) {
+			livePoints[currentPointNumber - 1] = 0;
+			livePoints[currentPointNumber / 2] = 0;
+			dynamicTree.erase(points.getIdentifier(currentPointNumber - 1));
+			dynamicTree.erase(points.getIdentifier(currentPointNumber / 2));
+		}
+	}
+
+	bool resultsCorrect = (dynamicTree.size() == std::count(livePoints.begin(), livePoints.end(), 1));
+
+	for (int currentRequestNumber = 0; currentRequestNumber < DYNAMIC_REQUESTS_NUMBER; ++currentRequestNumber) {
+		const double* requestPoint = requestPoints.getPoint(currentRequestNumber);
+		double simpleAlgoritmResult = std::numeric_limits<double>::max();
+
+		for (int currentPointNumber = 0; currentPointNumber < points.size(); ++currentPointNumber) {
+			if (livePoints[currentPointNumber]) {
+				simpleAlgoritmResult = std::min(simpleAlgoritmResult, distanceBetweenPoints(points.getPoint(currentPointNumber), requestPoint, DIMENSION));
+			}
+		}
+
+		double distance = 0;
+		int identifier = dynamicTree.getMinDistanceIdentifier(requestPoint, distance);
+		if (!livePoints[identifier] || !checkDistances(sqrt(simpleAlgoritmResult), distance)) {
+			resultsCorrect = false;
+		}
+	}
+
+	if (resultsCorrect) {
+		std::cout << "dynamic tree results are correct" << std::endl;
+	} else {
+		std::cout << "dynamic tree results are incorrect" << std::endl;
+	}
+}
+
+void checkParallelBuild(const KDTree& tree, const PointSet &points, const PointSet &requestPoints, ThreadPool &threadPool) {
+	KDTreeBuildParameters parameters;
+	parameters.threadPool = &threadPool;
+	parameters.parallelGrainSize = PARALLEL_GRAIN_SIZE;
+
+	KDTree parallelTree(points, parameters);
+
+	//a grain size of zero is taken as one, the chunks still cover every position once
+	std::vector<int> visits(points.size(), 0);
+	parallelFor(threadPool, 0, points.size(), 0, [&visits](int chunkBegin, int chunkEnd) {
+		for (int currentPosition = chunkBegin; currentPosition < chunkEnd; ++currentPosition) {
+			++visits[currentPosition];
+		}
+	});
+	bool resultsCorrect = (std::count(visits.begin(), visits.end(), 1) == points.size());
+
+	for (int currentRequestNumber = 0; currentRequestNumber < requestPoints.size(); ++currentRequestNumber) {
+		double distance = 0, parallelTreeDistance = 0;
+		int identifier = tree.getMinDistanceIdentifier(requestPoints.getPoint(currentRequestNumber), distance);
+		int parallelTreeIdentifier = parallelTree.getMinDistanceIdentifier(requestPoints.getPoint(currentRequestNumber), parallelTreeDistance);
+
+		if ((identifier != parallelTreeIdentifier) || (distance != parallelTreeDistance)) {
+			resultsCorrect = false;
+		}
+	}
+
+	if (resultsCorrect) {
+		std::cout << "parallel build is correct" << std::endl;
+	} else {
+		std::cout << "parallel build is incorrect" << std::endl;
+	}
+}
+
+//the file opened back has to answer exactly like the tree, a damaged file must be rejected
+void checkIndexFile(const KDTree& tree, const PointSet &requestPoints) {
+	bool resultsCorrect = tree.save(INDEX_FILE_NAME);
+	std::unique_ptr<KDTree> openedTree = KDTree::open(INDEX_FILE_NAME);
+	resultsCorrect = resultsCorrect && openedTree && (openedTree->getPointsNumber() == tree.getPointsNumber());
+
+	for (int currentRequestNumber = 0; resultsCorrect && (currentRequestNumber < requestPoints.size()); ++currentRequestNumber) {
+		double distance = 0, openedTreeDistance = 0;
+		int identifier = tree.getMinDistanceIdentifier(requestPoints.getPoint(currentRequestNumber), distance);
+		int openedTreeIdentifier = openedTree->getMinDistanceIdentifier(requestPoints.getPoint(currentRequestNumber), openedTreeDistance);
+
+		if ((identifier != openedTreeIdentifier) || (distance != openedTreeDistance)) {
+			resultsCorrect = false;
+		}
+	}
+	openedTree.reset();
+
+	{
+		std::fstream file(INDEX_FILE_NAME, std::ios::in | std::ios::out | std::ios::binary);
+		file.seekg(0, std::ios::end);
+		file.seekp(static_cast<long long>(file.tellg()) - 1);
+		file.put(1);
+	}
+	resultsCorrect = resultsCorrect && !KDTree::open(INDEX_FILE_NAME);
+	remove(INDEX_FILE_NAME);
+
+	if (resultsCorrect) {
+		std::cout << "index file is correct" << std::endl;
+	} else {
+		std::cout << "index file is incorrect" << std::endl;
+	}
+}
+
+//answers written by FastOutput have to match the ostream format, FastInput has to read back what operator>> reads
+void checkFastIO() {
+	std::ostringstream expectedOutput;
+	expectedOutput << std::setprecision(15);
+	std::vector<double> numbers(FAST_IO_NUMBERS_NUMBER);
+
+	FILE* file = fopen(NUMBERS_FILE_NAME, "wb");
+	{
+		FastOutput output(file);
+		for (int currentNumber = 0; currentNumber < FAST_IO_NUMBERS_NUMBER; ++currentNumber) {
+			numbers[currentNumber] = (currentNumber % 2 == 0 ? randomGenerator(engine) : sqrt(fabs(randomGenerator(engine))) * pow(10.0, currentNumber % 19 - 9));
+			output.writeInt(currentNumber - FAST_IO_NUMBERS_NUMBER / 2);
+			output.writeChar(' ');
+			output.writeDouble(numbers[currentNumber]);
+			output.writeChar('\n');
+
+			expectedOutput << currentNumber - FAST_IO_NUMBERS_NUMBER / 2 << ' ' << numbers[currentNumber] << '\n';
+		}
+	}
+	fclose(file);
+
+	std::ifstream writtenFile(NUMBERS_FILE_NAME);
+	std::ostringstream writtenOutput;
+	writtenOutput << writtenFile.rdbuf();
+	writtenFile.close();
+	bool resultsCorrect = (writtenOutput.str() == expectedOutput.str());
+
+	{
+		FastInput input(NUMBERS_FILE_NAME);
+		std::istringstream expectedInput(expectedOutput.str());
+		for (int currentNumber = 0; resultsCorrect && (currentNumber < FAST_IO_NUMBERS_NUMBER); ++currentNumber) {
+			int identifier = 0, expectedIdentifier = 0;
+			double number = 0, expectedNumber = 0;
+			expectedInput >> expectedIdentifier >> expectedNumber;
+
+			if (!input.readInt(identifier) || !input.readDouble(number) || (identifier != expectedIdentifier) || (number != expectedNumber)) {
+				resultsCorrect = false;
+			}
+		}
+	}
+	remove(NUMBERS_FILE_NAME);
+
+	if (resultsCorrect) {
+		std::cout << "fast input and output are correct" << std::endl;
+	} else {
+		std::cout << "fast input and output are incorrect" << std::endl;
+	}
+}
+
+template <typename CompactTree>
+bool checkCompactTree(const PointSet &points, const PointSet &requestPoints) {
+	if (!typename CompactTree::ExactTree(points).save(EXACT_TREE_FILE_NAME)) {
+		return false;
+	}
+
+	//the file was just written, reading it all again for the checksum would defeat the mapping
+	std::unique_ptr<CompactTree> tree = CompactTree::create(CompactTree::ExactTree::open(EXACT_TREE_FILE_NAME, false));
+	if (!tree) {
+		remove(EXACT_TREE_FILE_NAME);
+		return false;
+	}
+
+	typename CompactTree::SearchBuffers buffers;
+	std::vector<Neighbour> neighbours;
+	std::vector<double> expectedDistances;
+	bool resultsCorrect = true;
+
+	for (int currentRequestNumber = 0; currentRequestNumber < K_NEAREST_REQUESTS_NUMBER; ++currentRequestNumber) {
+		const double* requestPoint = requestPoints.getPoint(currentRequestNumber);
+		double distance = 0;
+		int identifier = tree->getMinDistanceIdentifier(requestPoint, distance);
+
+		if ((identifier < 0) || !checkDistances(distance, simpleAlgoritm(points, requestPoint)) 
+			|| !checkDistances(distance, sqrt(distanceBetweenPoints(points.getPoint(identifier), requestPoint, DIMENSION)))) {
+
+			resultsCorrect = false;
+		}
+
+		tree->getKNearest(requestPoint, K_NEAREST_NUMBER, neighbours, buffers);
+		simpleKNearest(points, requestPoint, K_NEAREST_NUMBER, &expectedDistances);
+		if (neighbours.size() != expectedDistances.size()) {
+			resultsCorrect = false;
+			continue;
+		}
+
+		for (size_t currentNeighbour = 0; currentNeighbour < neighbours.size(); ++currentNeighbour) {
+			if (!checkDistances(neighbours[currentNeighbour].distance, expectedDistances[currentNeighbour])) {
+				resultsCorrect = false;
+			}
+		}
+	}
+
+	//the exact file belongs to the caller, the tree only unmaps it
+	tree.reset();
+	resultsCorrect = resultsCorrect && std::ifstream(EXACT_TREE_FILE_NAME);
+	remove(EXACT_TREE_FILE_NAME);
+	return resultsCorrect;
+}
+
+void processCompactRequests(const PointSet &points, const PointSet &requestPoints) {
+	if (checkCompactTree<FloatKDTree>(points, requestPoints) && checkCompactTree<Int16KDTree>(points, requestPoints)) {
+		std::cout << "compact tree results are correct" << std::endl;
+	} else {
+		std::cout << "compact tree results are incorrect" << std::endl;
+	}
+}
+
+bool checkLeafSizeTree(const KDTree& tree, const PointSet &points, const PointSet &requestPoints) {
+	for (int currentRequestNumber = 0; currentRequestNumber < LEAF_SIZE_REQUESTS_NUMBER; ++currentRequestNumber) {
+		double distance = 0;
+		tree.getMinDistanceIdentifier(requestPoints.getPoint(currentRequestNumber), distance);
+
+		if (!checkDistances(distance, simpleAlgoritm(points, requestPoints.getPoint(currentRequestNumber)))) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+//the right half of every split is the larger one
+int getExpectedDepth(int pointsNumber, int leafSize) {
+	return (pointsNumber <= leafSize ? 1 : 1 + getExpectedDepth(pointsNumber - pointsNumber / 2, leafSize));
+}
+
+void checkLeafSizes(const PointSet &points, const PointSet &requestPoints) {
+	bool resultsCorrect = true;
+
+	for (size_t currentLeafSize = 0; currentLeafSize < sizeof(CHECKED_LEAF_SIZES) / sizeof(int); ++currentLeafSize) {
+		KDTreeBuildParameters parameters;
+		parameters.leafSize = CHECKED_LEAF_SIZES[currentLeafSize];
+		parameters.splitRule = (currentLeafSize % 2 == 0 ? WIDEST_BOX_SPLIT : MAX_VARIANCE_SPLIT);
+		parameters.bruteForceFallback = false;
+
+		KDTree tree(points, parameters);
+		resultsCorrect = resultsCorrect && (tree.getLeafSize() == parameters.leafSize) && checkLeafSizeTree(tree, points, requestPoints)
+			&& (tree.getDepth() == getExpectedDepth(points.size(), parameters.leafSize));
+
+		resultsCorrect = resultsCorrect && tree.save(INDEX_FILE_NAME);
+		std::unique_ptr<KDTree> openedTree = KDTree::open(INDEX_FILE_NAME);
+		resultsCorrect = resultsCorrect && openedTree && (openedTree->getLeafSize() == parameters.leafSize) 
+			&& checkLeafSizeTree(*openedTree, points, requestPoints);
+		remove(INDEX_FILE_NAME);
+	}
+
+	KDTreeBuildParameters parameters;
+	parameters.autoTune = true;
+	parameters.tuneSplitRule = true;
+	KDTree tunedTree(points, parameters);
+	const int* tuningLeafSizesEnd = KDTREE_TUNING_LEAF_SIZES + sizeof(KDTREE_TUNING_LEAF_SIZES) / sizeof(int);
+	resultsCorrect = resultsCorrect && (std::find(KDTREE_TUNING_LEAF_SIZES, tuningLeafSizesEnd, tunedTree.getLeafSize()) != tuningLeafSizesEnd) 
+		&& checkLeafSizeTree(tunedTree, points, requestPoints);
+
+	if (resultsCorrect) {
+		std::cout << "leaf sizes are correct" << std::endl;
+	} else {
+		std::cout << "leaf sizes are incorrect" << std::endl;
+	}
+}
+
+bool checkKernelDistances(const std::vector<double> &distances, int minPosition, const std::vector<double> &kernelDistances, int kernelMinPosition, 
+	int pointsNumber) {
+
+	bool resultsCorrect = checkDistances(kernelDistances[kernelMinPosition], distances[minPosition]);
+	for (int currentPointNumber = 0; currentPointNumber < pointsNumber; ++currentPointNumber) {
+		resultsCorrect = resultsCorrect && checkDistances(kernelDistances[currentPointNumber], distances[currentPointNumber]) 
+			&& (kernelDistances[kernelMinPosition] <= kernelDistances[currentPointNumber]);
+	}
+
+	return resultsCorrect;
+}
+
+//the distances a transposed kernel fills for the groups of the points and the position of the nearest it returns
+int getGroupKernelDistances(const DistanceKernel &kernel, const PointSet &points, const double* point, const double* weights, int metricNumber, 
+	std::vector<double> &distances) {
+
+	int dimension = points.getDimension();
+	int groupsNumber = getGroupsNumber(points.size());
+	std::vector<double> groups(static_cast<size_t>(groupsNumber) * KERNEL_GROUP_SIZE * dimension, 0);
+	for (int currentPointNumber = 0; currentPointNumber < points.size(); ++currentPointNumber) {
+		for (int currentCoordinate = 0; currentCoordinate < dimension; ++currentCoordinate) {
+			groups[static_cast<size_t>(currentPointNumber / KERNEL_GROUP_SIZE) * KERNEL_GROUP_SIZE * dimension + KERNEL_GROUP_SIZE * currentCoordinate 
+				+ currentPointNumber % KERNEL_GROUP_SIZE] = points.getPoint(currentPointNumber)[currentCoordinate];
+		}
+	}
+
+	distances.resize(static_cast<size_t>(groupsNumber) * KERNEL_GROUP_SIZE);
+	if (metricNumber == 0) {
+		return kernel.getGroupDistances(&groups[0], points.size(), point, dimension, &distances[0]);
+	} else if (metricNumber == 1) {
+		return kernel.getGroupManhattanDistances(&groups[0], points.size(), point, dimension, &distances[0]);
+	} else if (metricNumber == 2) {
+		return kernel.getGroupChebyshevDistances(&groups[0], points.size(), point, dimension, &distances[0]);
+	} else {
+		return kernel.getGroupWeightedDistances(&groups[0], points.size(), point, weights, dimension, &distances[0]);
+	}
+}
+
+//every kernel this processor runs must agree with the plain loop up to the order of the additions
+void checkDistanceKernels() {
+	std::uniform_real_distribution<> weightGenerator(0, MAX_METRIC_WEIGHT);
+	bool resultsCorrect = true;
+	std::vector<double> distances(MAX_KERNEL_BLOCK_SIZE), kernelDistances(MAX_KERNEL_BLOCK_SIZE), groupDistances;
+
+	for (int currentBlockNumber = 0; currentBlockNumber < KERNEL_BLOCKS_NUMBER; ++currentBlockNumber) {
+		int dimension = 1 + currentBlockNumber % MAX_KERNEL_DIMENSION;
+		int pointsNumber = 1 + currentBlockNumber % MAX_KERNEL_BLOCK_SIZE;
+		PointSet points(dimension);
+		points.resize(pointsNumber);
+		std::vector<double> point(dimension), weights(dimension);
+
+		for (int currentPointNumber = 0; currentPointNumber < pointsNumber; ++currentPointNumber) {
+			for (int currentCoordinate = 0; currentCoordinate < dimension; ++currentCoordinate) {
+				points.getPoint(currentPointNumber)[currentCoordinate] = randomGenerator(engine);
+			}
+		}
+		for (int currentCoordinate = 0; currentCoordinate < dimension; ++currentCoordinate) {
+			point[currentCoordinate] = randomGenerator(engine);
+			weights[currentCoordinate] = weightGenerator(engine);
+		}
+
+		for (int currentLevel = SSE2_KERNEL; currentLevel <= AVX512_KERNEL; ++currentLevel) {
+			DistanceKernel kernel = getDistanceKernel(static_cast<DistanceKernelLevel>(currentLevel));
+
+			int minPosition = getBlockDistancesScalar(points.getPoint(0), pointsNumber, points.getStride(), &point[0], dimension, &distances[0]);
+			int kernelMinPosition = kernel.getBlockDistances(points.getPoint(0), pointsNumber, points.getStride(), &point[0], dimension, &kernelDistances[0]);
+			resultsCorrect = resultsCorrect && checkKernelDistances(distances, minPosition, kernelDistances, kernelMinPosition, pointsNumber);
+
+			minPosition = getBlockManhattanDistancesScalar(points.getPoint(0), pointsNumber, points.getStride(), &point[0], dimension, &distances[0]);
+			kernelMinPosition = kernel.getBlockManhattanDistances(points.getPoint(0), pointsNumber, points.getStride(), &point[0], dimension, 
+				&kernelDistances[0]);
+			resultsCorrect = resultsCorrect && checkKernelDistances(distances, minPosition, kernelDistances, kernelMinPosition, pointsNumber);
+
+			minPosition = getBlockChebyshevDistancesScalar(points.getPoint(0), pointsNumber, points.getStride(), &point[0], dimension, &distances[0]);
+			kernelMinPosition = kernel.getBlockChebyshevDistances(points.getPoint(0), pointsNumber, points.getStride(), &point[0], dimension, 
+				&kernelDistances[0]);
+			resultsCorrect = resultsCorrect && checkKernelDistances(distances, minPosition, kernelDistances, kernelMinPosition, pointsNumber);
+
+			minPosition = getBlockWeightedDistancesScalar(points.getPoint(0), pointsNumber, points.getStride(), &point[0], &weights[0], dimension, 
+				&distances[0]);
+			kernelMinPosition = kernel.getBlockWeightedDistances(points.getPoint(0), pointsNumber, points.getStride(), &point[0], &weights[0], dimension, 
+				&kernelDistances[0]);
+			resultsCorrect = resultsCorrect && checkKernelDistances(distances, minPosition, kernelDistances, kernelMinPosition, pointsNumber);
+		}
+
+		for (int currentLevel = SCALAR_KERNEL; currentLevel <= AVX512_KERNEL; ++currentLevel) {
+			DistanceKernel kernel = getDistanceKernel(static_cast<DistanceKernelLevel>(currentLevel), TRANSPOSED_KERNEL_LAYOUT);
+
+			for (int currentMetric = 0; currentMetric < 4; ++currentMetric) {
+				int minPosition = 0;
+				if (currentMetric == 0) {
+					minPosition = getBlockDistancesScalar(points.getPoint(0), pointsNumber, points.getStride(), &point[0], dimension, &distances[0]);
+				} else if (currentMetric == 1) {
+					minPosition = getBlockManhattanDistancesScalar(points.getPoint(0), pointsNumber, points.getStride(), &point[0], dimension, &distances[0]);
+				} else if (currentMetric == 2) {
+					minPosition = getBlockChebyshevDistancesScalar(points.getPoint(0), pointsNumber, points.getStride(), &point[0], dimension, &distances[0]);
+				} else {
+					minPosition = getBlockWeightedDistancesScalar(points.getPoint(0), pointsNumber, points.getStride(), &point[0], &weights[0], dimension, 
+						&distances[0]);
+				}
+
+				int kernelMinPosition = getGroupKernelDistances(kernel, points, &point[0], &weights[0], currentMetric, groupDistances);
+				resultsCorrect = resultsCorrect && checkKernelDistances(distances, minPosition, groupDistances, kernelMinPosition, pointsNumber);
+			}
+		}
+	}
+
+	PointSet points;
+	genPoints(&points, BRUTE_FORCE_POINTS_NUMBER);
+	KDTreeBuildParameters parameters;
+	parameters.bruteForceFallback = false;
+	KDTree scanTree(points);
+	KDTree tree(points, parameters);
+	resultsCorrect = resultsCorrect && scanTree.isBruteForce() && !tree.isBruteForce();
+
+	PointSet requestPoints;
+	genPoints(&requestPoints, LEAF_SIZE_REQUESTS_NUMBER);
+	resultsCorrect = resultsCorrect && checkLeafSizeTree(scanTree, points, requestPoints);
+
+	//a fixed dimension of at most MAX_INLINED_DIMENSION is scanned by the inlined loop, other ones by the kernels,
+	//short rows in leaves filling a group by the transposed ones
+	PointSet shortPoints(MAX_INLINED_DIMENSION);
+	for (int currentPointNumber = 0; currentPointNumber < points.size(); ++currentPointNumber) {
+		shortPoints.addPoint(points.getPoint(currentPointNumber), points.getIdentifier(currentPointNumber));
+	}
+
+	BasicKDTree<DIMENSION, double> fixedTree(points);
+	KDTreeBuildParameters shortParameters;
+	shortParameters.leafSize = 2 * KERNEL_GROUP_SIZE;
+	KDTree shortTree(shortPoints, shortParameters);
+	resultsCorrect = resultsCorrect && (shortTree.getDistanceKernel().layout == TRANSPOSED_KERNEL_LAYOUT);
+	BasicKDTree<MAX_INLINED_DIMENSION, double> fixedShortTree(shortPoints);
+
+	//the groups are saved with the tree, the opened tree maps them and scans them with the same kernel
+	resultsCorrect = resultsCorrect && shortTree.save(INDEX_FILE_NAME);
+	std::unique_ptr<KDTree> openedShortTree = KDTree::open(INDEX_FILE_NAME);
+	resultsCorrect = resultsCorrect && openedShortTree && (openedShortTree->getDistanceKernel().level == shortTree.getDistanceKernel().level)
+		&& (openedShortTree->getDistanceKernel().layout == TRANSPOSED_KERNEL_LAYOUT)
+		&& (openedShortTree->getMemoryUsage() == shortTree.getMemoryUsage());
+
+	for (int currentRequestNumber = 0; currentRequestNumber < requestPoints.size(); ++currentRequestNumber) {
+		double distance = 0, fixedDistance = 0, shortDistance = 0, fixedShortDistance = 0, openedShortDistance = 0;
+		int identifier = tree.getMinDistanceIdentifier(requestPoints.getPoint(currentRequestNumber), distance);
+		int fixedIdentifier = fixedTree.getMinDistanceIdentifier(requestPoints.getPoint(currentRequestNumber), fixedDistance);
+		int shortIdentifier = shortTree.getMinDistanceIdentifier(requestPoints.getPoint(currentRequestNumber), shortDistance);
+		int fixedShortIdentifier = fixedShortTree.getMinDistanceIdentifier(requestPoints.getPoint(currentRequestNumber), fixedShortDistance);
+		resultsCorrect = resultsCorrect && checkDistances(distance, fixedDistance) && (identifier >= 0) && (fixedIdentifier >= 0)
+			&& checkDistances(shortDistance, fixedShortDistance) && (shortIdentifier >= 0) && (fixedShortIdentifier >= 0);
+
+		if (openedShortTree) {
+			int openedShortIdentifier = openedShortTree->getMinDistanceIdentifier(requestPoints.getPoint(currentRequestNumber), openedShortDistance);
+			resultsCorrect = resultsCorrect && (openedShortIdentifier == shortIdentifier) && (openedShortDistance == shortDistance);
+		}
+	}
+
+	openedShortTree.reset();
+	remove(INDEX_FILE_NAME);
+
+	if (resultsCorrect) {
+		std::cout << "distance kernels are correct (" << tree.getDistanceKernel().name << ")" << std::endl;
+	} else {
+		std::cout << "distance kernels are incorrect (" << tree.getDistanceKernel().name << ")" << std::endl;
+	}
+}
+
+//every visited inner node sends the search to its near child and either to its far child or to a prune
+bool checkSearchStats(const SearchStats &stats) {
+	int innerNodesVisited = stats.nodesVisited - stats.leavesScanned;
+	return (stats.leavesScanned > 0) && (stats.distancesComputed >= stats.leavesScanned)
+		&& (stats.nodesVisited == 2 * innerNodesVisited - stats.subtreesPruned + 1);
+}
+
+void processStatsRequests(const KDTree& tree, const PointSet &requestPoints, ThreadPool &threadPool) {
+	std::vector<int> identifiers(REQUESTS_NUMBER), statsIdentifiers(REQUESTS_NUMBER);
+	std::vector<double> distances(REQUESTS_NUMBER), statsDistances(REQUESTS_NUMBER);
+	SearchStatsHistogram histogram;
+	bool resultsCorrect = true;
+
+	tree.queryBatch(requestPoints, identifiers, distances, threadPool);
+	tree.queryBatch(requestPoints, statsIdentifiers, statsDistances, threadPool, histogram);
+	resultsCorrect = (identifiers == statsIdentifiers) && (distances == statsDistances);
+
+	SearchStatsHistogram expectedHistogram;
+	for (int currentRequestNumber = 0; currentRequestNumber < requestPoints.size(); ++currentRequestNumber) {
+		SearchStats stats;
+		double distance;
+		tree.getMinDistanceIdentifier(requestPoints.getPoint(currentRequestNumber), distance, stats);
+
+		resultsCorrect = resultsCorrect && checkSearchStats(stats);
+		expectedHistogram.add(stats);
+	}
+
+	for (int currentBucket = 0; currentBucket < STATS_HISTOGRAM_BUCKETS_NUMBER; ++currentBucket) {
+		resultsCorrect = resultsCorrect 
+			&& (histogram.nodesVisited.getBucketCount(currentBucket) == expectedHistogram.nodesVisited.getBucketCount(currentBucket))
+			&& (histogram.distancesComputed.getBucketCount(currentBucket) == expectedHistogram.distancesComputed.getBucketCount(currentBucket));
+	}
+	resultsCorrect = resultsCorrect && (histogram.subtreesPruned.getValuesNumber() == requestPoints.size())
+		&& (histogram.leavesScanned.getMean() == expectedHistogram.leavesScanned.getMean())
+		&& (histogram.nodesVisited.getPercentile(0.99) <= histogram.nodesVisited.getMaximum());
+
+	if (resultsCorrect) {
+		std::cout << "search stats are correct" << std::endl;
+	} else {
+		std::cout << "search stats are incorrect" << std::endl;
+	}
+}
+
+//rows of the parallel graph must match the sequential one and hold the nearest other points
+void checkKnnGraph(const KDTree& tree, const PointSet &points, ThreadPool &threadPool) {
+	KnnGraph graph, parallelGraph;
+	tree.buildKnnGraph(K_NEAREST_NUMBER, graph);
+	tree.buildKnnGraph(K_NEAREST_NUMBER, parallelGraph, threadPool);
+
+	bool resultsCorrect = (graph.rowOffsets.size() == static_cast<size_t>(points.size()) + 1) 
+		&& (graph.rowOffsets == parallelGraph.rowOffsets) && (graph.identifiers == parallelGraph.identifiers);
+	std::vector<double> simpleAlgoritmDistances;
+
+	for (int currentPointNumber = 0; resultsCorrect && (currentPointNumber < KNN_GRAPH_CHECKED_POINTS_NUMBER); ++currentPointNumber) {
+		const double* point = points.getPoint(currentPointNumber);
+		simpleKNearest(points, point, K_NEAREST_NUMBER + 1, &simpleAlgoritmDistances);
+
+		int rowBegin = graph.rowOffsets[currentPointNumber];
+		if (graph.rowOffsets[currentPointNumber + 1] - rowBegin != K_NEAREST_NUMBER) {
+			resultsCorrect = false;
+			continue;
+		}
+
+		for (int currentNeighbour = 0; currentNeighbour < K_NEAREST_NUMBER; ++currentNeighbour) {
+			int neighbourIdentifier = graph.identifiers[rowBegin + currentNeighbour];
+			double neighbourDistance = sqrt(distanceBetweenPoints(points.getPoint(neighbourIdentifier), point, DIMENSION));
+
+			if ((neighbourIdentifier == points.getIdentifier(currentPointNumber)) 
+				|| !checkDistances(simpleAlgoritmDistances[currentNeighbour + 1], graph.distances[rowBegin + currentNeighbour])
+				|| !checkDistances(neighbourDistance, graph.distances[rowBegin + currentNeighbour])) {
+
+				resultsCorrect = false;
+			}
+		}
+	}
+
+	if (resultsCorrect) {
+		std::cout << "k nearest neighbours graph is correct" << std::endl;
+	} else {
+		std::cout << "k nearest neighbours graph is incorrect" << std::endl;
+	}
+}
+
+//without a budget the forest is exact, with one it may only return farther points;
+//the trees are drawn from the seed, so a parallel build answers the same
+bool checkForest(const KDForest &forest, const KDForest &parallelForest, const KDTree &tree, const PointSet &points, const PointSet &requestPoints) {
+	std::vector<Neighbour> neighbours;
+	std::vector<double> simpleAlgoritmDistances;
+
+	for (int currentRequestNumber = 0; currentRequestNumber < FOREST_REQUESTS_NUMBER; ++currentRequestNumber) {
+		const double* requestPoint = requestPoints.getPoint(currentRequestNumber);
+		double distance = 0, forestDistance = 0, budgetDistance = 0, parallelDistance = 0;
+		bool exact = false, budgetExact = false, parallelExact = false;
+
+		tree.getMinDistanceIdentifier(requestPoint, distance);
+		forest.getApproximateMinDistanceIdentifier(requestPoint, forestDistance, ApproximateSearchParameters(), exact);
+		if (!exact || !checkDistances(distance, forestDistance)) {
+			return false;
+		}
+
+		int identifier = forest.getApproximateMinDistanceIdentifier(requestPoint, budgetDistance, ApproximateSearchParameters(0, MAX_LEAVES_NUMBER), budgetExact);
+		int parallelIdentifier = parallelForest.getApproximateMinDistanceIdentifier(requestPoint, parallelDistance, 
+			ApproximateSearchParameters(0, MAX_LEAVES_NUMBER), parallelExact);
+		if ((budgetDistance + EPS < distance) || (budgetExact && !checkDistances(distance, budgetDistance)) || (identifier != parallelIdentifier)
+			|| !checkDistances(sqrt(distanceBetweenPoints(points.getPoint(identifier), requestPoint, DIMENSION)), budgetDistance)) {
+
+			return false;
+		}
+
+		forest.getApproximateKNearest(requestPoint, K_NEAREST_NUMBER, neighbours, ApproximateSearchParameters(), exact);
+		simpleKNearest(points, requestPoint, K_NEAREST_NUMBER, &simpleAlgoritmDistances);
+		if (!exact || (neighbours.size() != static_cast<size_t>(K_NEAREST_NUMBER))) {
+			return false;
+		}
+		for (int currentNeighbour = 0; currentNeighbour < K_NEAREST_NUMBER; ++currentNeighbour) {
+			if (!checkDistances(simpleAlgoritmDistances[currentNeighbour], neighbours[currentNeighbour].distance)) {
+				return false;
+			}
+		}
+	}
+
+	return true;
+}
+
+void processForestRequests(const KDTree &tree, const PointSet &points, const PointSet &requestPoints, ThreadPool &threadPool) {
+	bool resultsCorrect = true;
+
+	for (int rotate = 0; rotate < 2; ++rotate) {
+		KDForestBuildParameters parameters;
+		parameters.rotate = (rotate == 1);
+		KDForest forest(points, parameters);
+
+		parameters.threadPool = &threadPool;
+		KDForest parallelForest(points, parameters);
+
+		resultsCorrect = resultsCorrect && (forest.getTreesNumber() == parameters.treesNumber) 
+			&& checkForest(forest, parallelForest, tree, points, requestPoints);
+	}
+
+	if (resultsCorrect) {
+		std::cout << "forest results are correct" << std::endl;
+	} else {
+		std::cout << "forest results are incorrect" << std::endl;
+	}
+}
+
+//nearest, k nearest and radius queries of the ball tree against the kd-tree, which the checks above hold to the full scan
+void processBallTreeRequests(const KDTree &tree, const PointSet &points, const PointSet &requestPoints) {
+	BallTree ballTree(points);
+	std::vector<Neighbour> neighbours, ballTreeNeighbours;
+	std::vector<int> identifiers, ballTreeIdentifiers;
+	bool resultsCorrect = (ballTree.getPointsNumber() == points.size());
+
+	for (int currentRequestNumber = 0; currentRequestNumber < K_NEAREST_REQUESTS_NUMBER; ++currentRequestNumber) {
+		const double* requestPoint = requestPoints.getPoint(currentRequestNumber);
+		double distance = 0, ballTreeDistance = 0;
+
+		tree.getMinDistanceIdentifier(requestPoint, distance);
+		int identifier = ballTree.getMinDistanceIdentifier(requestPoint, ballTreeDistance);
+		if (!checkDistances(distance, ballTreeDistance) || !checkDistances(sqrt(distanceBetweenPoints(points.getPoint(identifier), requestPoint, DIMENSION)), distance)) {
+			resultsCorrect = false;
+		}
+
+		tree.getKNearest(requestPoint, K_NEAREST_NUMBER, neighbours);
+		ballTree.getKNearest(requestPoint, K_NEAREST_NUMBER, ballTreeNeighbours);
+		if (neighbours.size() != ballTreeNeighbours.size()) {
+			resultsCorrect = false;
+			continue;
+		}
+		for (size_t currentNeighbour = 0; currentNeighbour < neighbours.size(); ++currentNeighbour) {
+			resultsCorrect = resultsCorrect && checkDistances(neighbours[currentNeighbour].distance, ballTreeNeighbours[currentNeighbour].distance);
+		}
+
+		tree.radiusSearch(requestPoint, SEARCH_RADIUS, identifiers);
+		ballTree.radiusSearch(requestPoint, SEARCH_RADIUS, ballTreeIdentifiers);
+		std::sort(identifiers.begin(), identifiers.end());
+		std::sort(ballTreeIdentifiers.begin(), ballTreeIdentifiers.end());
+		if ((identifiers != ballTreeIdentifiers) || (ballTree.radiusCount(requestPoint, SEARCH_RADIUS) != static_cast<int>(identifiers.size()))) {
+			resultsCorrect = false;
+		}
+	}
+
+	if (resultsCorrect) {
+		std::cout << "ball tree results are correct" << std::endl;
+	} else {
+		std::cout << "ball tree results are incorrect" << std::endl;
+	}
+}
+
+//nearest, k nearest and radius queries of a tree in another metric against the full scan in that metric,
+//the radius lies halfway between the distances of two neighbours, so no point is on the sphere
+template <typename Metric>
+bool checkMetric(const Metric &metric, const PointSet &points, const PointSet &requestPoints) {
+	KDTreeBuildParameters parameters;
+	parameters.bruteForceFallback = false;
+	BasicKDTree<DYNAMIC_DIMENSION, double, Metric> tree(points, parameters, metric);
+	std::vector<Neighbour> neighbours;
+	std::vector<double> simpleAlgoritmDistances(points.size());
+	std::vector<int> identifiers, simpleAlgoritmIdentifiers;
+	bool resultsCorrect = true;
+
+	for (int currentRequestNumber = 0; currentRequestNumber < METRIC_REQUESTS_NUMBER; ++currentRequestNumber) {
+		const double* requestPoint = requestPoints.getPoint(currentRequestNumber);
+		for (int currentPointNumber = 0; currentPointNumber < points.size(); ++currentPointNumber) {
+			simpleAlgoritmDistances[currentPointNumber] = metric.getDistance(distanceBetweenPoints<DYNAMIC_DIMENSION>(metric, points.getPoint(currentPointNumber), 
+				requestPoint, DIMENSION));
+		}
+
+		double distance = 0;
+		int identifier = tree.getMinDistanceIdentifier(requestPoint, distance);
+		resultsCorrect = resultsCorrect && checkDistances(simpleAlgoritmDistances[identifier], distance) 
+			&& checkDistances(*std::min_element(simpleAlgoritmDistances.begin(), simpleAlgoritmDistances.end()), distance);
+
+		std::vector<double> sortedDistances = simpleAlgoritmDistances;
+		std::sort(sortedDistances.begin(), sortedDistances.end());
+		tree.getKNearest(requestPoint, K_NEAREST_NUMBER, neighbours);
+		if (neighbours.size() != static_cast<size_t>(K_NEAREST_NUMBER)) {
+			resultsCorrect = false;
+			continue;
+		}
+		for (size_t currentNeighbour = 0; currentNeighbour < neighbours.size(); ++currentNeighbour) {
+			resultsCorrect = resultsCorrect && checkDistances(sortedDistances[currentNeighbour], neighbours[currentNeighbour].distance) 
+				&& checkDistances(simpleAlgoritmDistances[neighbours[currentNeighbour].identifier], neighbours[currentNeighbour].distance);
+		}
+		double radius = (sortedDistances[K_NEAREST_NUMBER - 1] + sortedDistances[K_NEAREST_NUMBER]) / 2;
+
+		simpleAlgoritmIdentifiers.clear();
+		for (int currentPointNumber = 0; currentPointNumber < points.size(); ++currentPointNumber) {
+			if (simpleAlgoritmDistances[currentPointNumber] <= radius) {
+				simpleAlgoritmIdentifiers.push_back(points.getIdentifier(currentPointNumber));
+			}
+		}
+
+		tree.radiusSearch(requestPoint, radius, identifiers);
+		std::sort(identifiers.begin(), identifiers.end());
+		if ((identifiers != simpleAlgoritmIdentifiers) || (tree.radiusCount(requestPoint, radius) != static_cast<int>(identifiers.size()))) {
+			resultsCorrect = false;
+		}
+	}
+
+	return resultsCorrect;
+}
+
+void processMetricRequests(const PointSet &points, const PointSet &requestPoints) {
+	std::uniform_real_distribution<> weightGenerator(0, MAX_METRIC_WEIGHT);
+	std::vector<double> weights(DIMENSION);
+	for (int currentCoordinate = 0; currentCoordinate < DIMENSION; ++currentCoordinate) {
+		weights[currentCoordinate] = weightGenerator(engine);
+	}
+
+	bool resultsCorrect = checkMetric(ManhattanMetric(), points, requestPoints) && checkMetric(ChebyshevMetric(), points, requestPoints) 
+		&& checkMetric(WeightedEuclideanMetric(weights), points, requestPoints);
+
+	if (resultsCorrect) {
+		std::cout << "metric results are correct" << std::endl;
+	} else {
+		std::cout << "metric results are incorrect" << std::endl;
+	}
+}
+
+//readers search snapshots while trees over two point sets are published in turn, the identifiers of the second set
+//are shifted by the size of the first one, so every answer tells which tree it came from and is checked against it
+void checkTreeHandle(const KDTree &tree, const PointSet &points, ThreadPool &threadPool) {
+	PointSet otherPoints;
+	genPoints(&otherPoints, POINTS_NUMBER);
+	for (int currentPointNumber = 0; currentPointNumber < otherPoints.size(); ++currentPointNumber) {
+		otherPoints.setIdentifier(currentPointNumber, POINTS_NUMBER + currentPointNumber);
+	}
+
+	PointSet requestPoints;
+	genPoints(&requestPoints, HANDLE_REQUESTS_NUMBER);
+	KDTree otherTree(otherPoints);
+	std::vector<double> distances(HANDLE_REQUESTS_NUMBER), otherDistances(HANDLE_REQUESTS_NUMBER);
+	for (int currentRequestNumber = 0; currentRequestNumber < HANDLE_REQUESTS_NUMBER; ++currentRequestNumber) {
+		tree.getMinDistanceIdentifier(requestPoints.getPoint(currentRequestNumber), distances[currentRequestNumber]);
+		otherTree.getMinDistanceIdentifier(requestPoints.getPoint(currentRequestNumber), otherDistances[currentRequestNumber]);
+	}
+
+	KDTreeHandle handle;
+	double distance = 0;
+	std::atomic<bool> resultsCorrect((handle.getMinDistanceIdentifier(requestPoints.getPoint(0), distance) == -1));
+	std::atomic<bool> stopping(false);
+	handle.publish(std::unique_ptr<KDTree>(new KDTree(points)));
+
+	std::vector<std::thread> readers;
+	for (int currentReader = 0; currentReader < THREADS_NUMBER; ++currentReader) {
+		readers.push_back(std::thread([&, currentReader]() {
+			for (int currentRequestNumber = currentReader; !stopping; currentRequestNumber = (currentRequestNumber + 1) % HANDLE_REQUESTS_NUMBER) {
+				KDTreeHandle::Snapshot snapshot(handle);
+				double snapshotDistance = 0;
+				int identifier = snapshot->getMinDistanceIdentifier(requestPoints.getPoint(currentRequestNumber), snapshotDistance);
+				double expectedDistance = (identifier < POINTS_NUMBER ? distances : otherDistances)[currentRequestNumber];
+
+				if ((identifier < 0) || (snapshotDistance != expectedDistance)) {
+					resultsCorrect = false;
+				}
+			}
+		}));
+	}
+
+	KDTreeBuildParameters parameters;
+	parameters.threadPool = &threadPool;
+	for (int currentRebuild = 0; currentRebuild < HANDLE_REBUILDS_NUMBER; ++currentRebuild) {
+		handle.rebuildAsync(currentRebuild % 2 == 0 ? otherPoints : points, parameters);
+		handle.waitForRebuild();
+	}
+
+	//a thread holding a snapshot may rebuild, the tree it holds stays valid until the snapshot is destroyed
+	{
+		KDTreeHandle::Snapshot snapshot(handle);
+		handle.rebuildAsync(points, parameters);
+		handle.waitForRebuild();
+		resultsCorrect = resultsCorrect && (snapshot->getMinDistanceIdentifier(requestPoints.getPoint(0), distance) >= 0);
+	}
+
+	stopping = true;
+	for (size_t currentReader = 0; currentReader < readers.size(); ++currentReader) {
+		readers[currentReader].join();
+	}
+
+	//the last rebuild was over the first set
+	int identifier = handle.getMinDistanceIdentifier(requestPoints.getPoint(0), distance);
+	resultsCorrect = resultsCorrect && (identifier >= 0) && (identifier < POINTS_NUMBER) && (distance == distances[0]) 
+		&& (handle.getPublishedTreesNumber() == HANDLE_REBUILDS_NUMBER + 2) && (handle.reclaimRetiredTrees() == 0);
+
+	if (resultsCorrect) {
+		std::cout << "tree handle results are correct" << std::endl;
+	} else {
+		std::cout << "tree handle results are incorrect" << std::endl;
+	}
+}
+
 int main() {
-	std::vector<TypePoint> points;
+	PointSet points;
 	genPoints(&points, POINTS_NUMBER);
 
 	KDTree tree(points);
 
-	std::vector<TypePoint> requestPoints;
+	PointSet requestPoints;
 	genPoints(&requestPoints, REQUESTS_NUMBER);
 
-	processRequests(tree, points, requestPoints);
+	ThreadPool threadPool(THREADS_NUMBER);
+	processRequests(tree, points, requestPoints, threadPool);
+	processTiedRequests();
+	processKNearestRequests(tree, points, requestPoints);
+	processRadiusRequests(tree, points, requestPoints);
+	processApproximateRequests(tree, requestPoints);
+	checkDynamicTree(points, requestPoints);
+	checkParallelBuild(tree, points, requestPoints, threadPool);
+	checkIndexFile(tree, requestPoints);
+	checkFastIO();
+	processCompactRequests(points, requestPoints);
+	processStatsRequests(tree, requestPoints, threadPool);
+	checkLeafSizes(points, requestPoints);
+	checkDistanceKernels();
+	checkKnnGraph(tree, points, threadPool);
+	processForestRequests(tree, points, requestPoints, threadPool);
+	processBallTreeRequests(tree, points, requestPoints);
+	processMetricRequests(points, requestPoints);
+	checkTreeHandle(tree, points, threadPool);
 
 	return 0;
 }
\ No newline at end of file
@@ -0,0 +1,621 @@
+#include "../KDTree/KDTree.h"
+#include "../KDTree/DynamicKDTree.h"
+#include "../KDTree/CompactKDTree.h"
+#include "../KDTree/KDForest.h"
+#include "../KDTree/KDTreeHandle.h"
+
+#include <iostream>
+#include <iomanip>
+#include <random>
+#include <chrono>
+#include <vector>
+#include <algorithm>
+#include <thread>
+#include <atomic>
+#include <functional>
+#include <fstream>
+#include <sstream>
+#include <cstdio>
+
+const int POINTS_NUMBER = 10000;
+const int REQUESTS_NUMBER = 10000;
+const int PARALLEL_BUILD_POINTS_NUMBER = 2000000;
+const int PARALLEL_BUILD_DIMENSION = 3;
+const int APPROXIMATE_SEARCH_DIMENSION = 10;
+const int FOREST_SEARCH_POINTS_NUMBER = 100000;
+const int FOREST_SEARCH_REQUESTS_NUMBER = 2000;
+const int FOREST_SEARCH_DIMENSION = 16;
+const int DYNAMIC_TREE_POINTS_NUMBER = 200000;
+const int DYNAMIC_TREE_DIMENSION = 3;
+const int COMPACT_STORAGE_POINTS_NUMBER = 500000;
+const int COMPACT_STORAGE_DIMENSION = 10;
+const int TREE_HANDLE_POINTS_NUMBER = 20000;
+const int TREE_HANDLE_DIMENSION = 3;
+const int TREE_HANDLE_WINDOWS_NUMBER = 50;
+const int TREE_HANDLE_WINDOW_MILLISECONDS = 20;
+//the counters of the readers are this many apart, so they do not share cache lines
+const int READER_COUNTERS_STRIDE = 16;
+const int TEXT_IO_NUMBERS_NUMBER = 3000000;
+const char* const TEXT_IO_INPUT_FILE_NAME = "benchmark_input.txt";
+const char* const TEXT_IO_OUTPUT_FILE_NAME = "benchmark_output.txt";
+const char* const EXACT_TREE_FILE_NAME = "benchmark_exact.kdt";
+const unsigned int RANDOM_SEED = 2015;
+
+const double MIN_COORDINATE_VALUE = -100.0;
+const double MAX_COORDINATE_VALUE = 100.0;
+
+typedef std::chrono::steady_clock BenchmarkClock;
+
+struct WorkloadResult {
+	double buildTime;
+	double queriesTime;
+	std::vector<int> identifiers;
+};
+
+double getElapsedMilliseconds(BenchmarkClock::time_point start) {
+	return std::chrono::duration<double, std::milli>(BenchmarkClock::now() - start).count();
+}
+
+void genPoints(PointSet* points, int pointsNumber, int dimension, std::default_random_engine &engine) {
+	std::uniform_real_distribution<> randomGenerator(MIN_COORDINATE_VALUE, MAX_COORDINATE_VALUE);
+
+	(*points).changeDimension(dimension);
+	(*points).resize(pointsNumber);
+
+	for (int currentPointNumber = 0; currentPointNumber < pointsNumber; ++currentPointNumber) {
+		(*points).setIdentifier(currentPointNumber, currentPointNumber);
+
+		double* currentPoint = (*points).getPoint(currentPointNumber);
+		for (int currentCoordinate = 0; currentCoordinate < dimension; ++currentCoordinate) {
+			currentPoint[currentCoordinate] = randomGenerator(engine);
+		}
+	}
+}
+
+template <typename Tree>
+WorkloadResult runWorkload(const PointSet &points, const PointSet &requestPoints) {
+	WorkloadResult result;
+
+	BenchmarkClock::time_point start = BenchmarkClock::now();
+	Tree tree(points);
+	result.buildTime = getElapsedMilliseconds(start);
+
+	result.identifiers.resize(requestPoints.size());
+	start = BenchmarkClock::now();
+	for (int currentRequestNumber = 0; currentRequestNumber < requestPoints.size(); ++currentRequestNumber) {
+		double distance = 0;
+		result.identifiers[currentRequestNumber] = tree.getMinDistanceIdentifier(requestPoints.getPoint(currentRequestNumber), distance);
+	}
+	result.queriesTime = getElapsedMilliseconds(start);
+
+	return result;
+}
+
+void printWorkloadResult(const char* treeName, const WorkloadResult &result) {
+	std::cout << "  " << std::setw(8) << std::left << treeName << std::right;
+	std::cout << " build " << std::setw(9) << result.buildTime << " ms";
+	std::cout << ", queries " << std::setw(9) << result.queriesTime << " ms" << std::endl;
+}
+
+template <int Dimension>
+void compareDimensionSpecialization() {
+	std::default_random_engine engine(RANDOM_SEED);
+
+	PointSet points;
+	genPoints(&points, POINTS_NUMBER, Dimension, engine);
+
+	PointSet requestPoints;
+	genPoints(&requestPoints, REQUESTS_NUMBER, Dimension, engine);
+
+	WorkloadResult dynamicResult = runWorkload<KDTree>(points, requestPoints);
+	WorkloadResult fixedResult = runWorkload<BasicKDTree<Dimension, double> >(points, requestPoints);
+
+	std::cout << "dimension " << Dimension << ", " << POINTS_NUMBER << " points, " << REQUESTS_NUMBER << " requests" << std::endl;
+	printWorkloadResult("dynamic", dynamicResult);
+	printWorkloadResult("fixed", fixedResult);
+	std::cout << "  queries speedup " << dynamicResult.queriesTime / fixedResult.queriesTime;
+	std::cout << (dynamicResult.identifiers == fixedResult.identifiers ? ", answers match" : ", ANSWERS DIFFER") << std::endl;
+}
+
+void measureParallelBuild() {
+	std::default_random_engine engine(RANDOM_SEED);
+
+	PointSet points;
+	genPoints(&points, PARALLEL_BUILD_POINTS_NUMBER, PARALLEL_BUILD_DIMENSION, engine);
+
+	PointSet requestPoints;
+	genPoints(&requestPoints, REQUESTS_NUMBER, PARALLEL_BUILD_DIMENSION, engine);
+
+	std::cout << "parallel build, dimension " << PARALLEL_BUILD_DIMENSION << ", " << PARALLEL_BUILD_POINTS_NUMBER << " points" << std::endl;
+
+	BenchmarkClock::time_point start = BenchmarkClock::now();
+	KDTree serialTree(points);
+	double serialBuildTime = getElapsedMilliseconds(start);
+	std::cout << "  serial     build " << std::setw(9) << serialBuildTime << " ms" << std::endl;
+
+	int maxThreadsNumber = std::max(1u, std::thread::hardware_concurrency());
+	for (int threadsNumber = 1; threadsNumber <= maxThreadsNumber; threadsNumber *= 2) {
+		ThreadPool threadPool(threadsNumber);
+		KDTreeBuildParameters parameters;
+		parameters.threadPool = &threadPool;
+
+		start = BenchmarkClock::now();
+		KDTree parallelTree(points, parameters);
+		double parallelBuildTime = getElapsedMilliseconds(start);
+
+		bool answersMatch = true;
+		for (int currentRequestNumber = 0; currentRequestNumber < requestPoints.size(); ++currentRequestNumber) {
+			double serialDistance = 0, parallelDistance = 0;
+			int serialIdentifier = serialTree.getMinDistanceIdentifier(requestPoints.getPoint(currentRequestNumber), serialDistance);
+			int parallelIdentifier = parallelTree.getMinDistanceIdentifier(requestPoints.getPoint(currentRequestNumber), parallelDistance);
+			answersMatch = answersMatch && (serialIdentifier == parallelIdentifier) && (serialDistance == parallelDistance);
+		}
+
+		std::cout << "  " << std::setw(2) << threadsNumber << " threads build " << std::setw(9) << parallelBuildTime << " ms";
+		std::cout << ", speedup " << serialBuildTime / parallelBuildTime << (answersMatch ? ", answers match" : ", ANSWERS DIFFER") << std::endl;
+	}
+}
+
+double getPercentile(std::vector<double> values, double percentile) {
+	std::sort(values.begin(), values.end());
+	return values[std::min(values.size() - 1, static_cast<size_t>(percentile * values.size()))];
+}
+
+void measureApproximateSearch() {
+	std::default_random_engine engine(RANDOM_SEED);
+
+	PointSet points;
+	genPoints(&points, POINTS_NUMBER, APPROXIMATE_SEARCH_DIMENSION, engine);
+
+	PointSet requestPoints;
+	genPoints(&requestPoints, REQUESTS_NUMBER, APPROXIMATE_SEARCH_DIMENSION, engine);
+
+	KDTree tree(points);
+	std::vector<int> exactIdentifiers(requestPoints.size());
+	for (int currentRequestNumber = 0; currentRequestNumber < requestPoints.size(); ++currentRequestNumber) {
+		double distance = 0;
+		exactIdentifiers[currentRequestNumber] = tree.getMinDistanceIdentifier(requestPoints.getPoint(currentRequestNumber), distance);
+	}
+
+	const ApproximateSearchParameters searchParameters[] = {
+		ApproximateSearchParameters(0, 0), 
+		ApproximateSearchParameters(0.5, 0), 
+		ApproximateSearchParameters(1, 0), 
+		ApproximateSearchParameters(0, 256), 
+		ApproximateSearchParameters(0, 32), 
+		ApproximateSearchParameters(0.5, 32)
+	};
+
+	std::cout << "approximate search, dimension " << APPROXIMATE_SEARCH_DIMENSION << ", " << POINTS_NUMBER << " points" << std::endl;
+	for (size_t currentParameters = 0; currentParameters < sizeof(searchParameters) / sizeof(searchParameters[0]); ++currentParameters) {
+		std::vector<double> latencies(requestPoints.size());
+		int foundNumber = 0, exactNumber = 0;
+
+		for (int currentRequestNumber = 0; currentRequestNumber < requestPoints.size(); ++currentRequestNumber) {
+			double distance = 0;
+			bool exact = false;
+
+			BenchmarkClock::time_point start = BenchmarkClock::now();
+			int identifier = tree.getApproximateMinDistanceIdentifier(requestPoints.getPoint(currentRequestNumber), distance, 
+				searchParameters[currentParameters], exact);
+			latencies[currentRequestNumber] = getElapsedMilliseconds(start) * 1000;
+
+			foundNumber += (identifier == exactIdentifiers[currentRequestNumber]);
+			exactNumber += exact;
+		}
+
+		std::cout << "  epsilon " << searchParameters[currentParameters].epsilon << ", leaves " << std::setw(3) << searchParameters[currentParameters].maxLeavesNumber;
+		std::cout << ": recall " << 100.0 * foundNumber / requestPoints.size() << "%, guaranteed " << 100.0 * exactNumber / requestPoints.size() << "%";
+		std::cout << ", p50 " << getPercentile(latencies, 0.5) << " us, p99 " << getPercentile(latencies, 0.99) << " us" << std::endl;
+	}
+}
+
+template <typename Index>
+void measureLeafBudgets(const char* indexName, const Index &index, const PointSet &requestPoints, const std::vector<int> &exactIdentifiers) {
+	const int leafBudgets[] = {16, 64, 256};
+
+	for (size_t currentBudget = 0; currentBudget < sizeof(leafBudgets) / sizeof(leafBudgets[0]); ++currentBudget) {
+		std::vector<double> latencies(requestPoints.size());
+		int foundNumber = 0;
+
+		for (int currentRequestNumber = 0; currentRequestNumber < requestPoints.size(); ++currentRequestNumber) {
+			double distance = 0;
+			bool exact = false;
+
+			BenchmarkClock::time_point start = BenchmarkClock::now();
+			int identifier = index.getApproximateMinDistanceIdentifier(requestPoints.getPoint(currentRequestNumber), distance, 
+				ApproximateSearchParameters(0, leafBudgets[currentBudget]), exact);
+			latencies[currentRequestNumber] = getElapsedMilliseconds(start) * 1000;
+
+			foundNumber += (identifier == exactIdentifiers[currentRequestNumber]);
+		}
+
+		std::cout << "  " << std::setw(16) << indexName << ", leaves " << std::setw(3) << leafBudgets[currentBudget];
+		std::cout << ": recall " << 100.0 * foundNumber / requestPoints.size() << "%, p50 " << getPercentile(latencies, 0.5) << " us" << std::endl;
+	}
+}
+
+//the same total leaf budget spent on one tree and on forests of randomized trees
+void measureForestSearch() {
+	std::default_random_engine engine(RANDOM_SEED);
+
+	PointSet points;
+	genPoints(&points, FOREST_SEARCH_POINTS_NUMBER, FOREST_SEARCH_DIMENSION, engine);
+
+	PointSet requestPoints;
+	genPoints(&requestPoints, FOREST_SEARCH_REQUESTS_NUMBER, FOREST_SEARCH_DIMENSION, engine);
+
+	KDTree tree(points);
+	std::vector<int> exactIdentifiers(requestPoints.size());
+	for (int currentRequestNumber = 0; currentRequestNumber < requestPoints.size(); ++currentRequestNumber) {
+		double distance = 0;
+		exactIdentifiers[currentRequestNumber] = tree.getMinDistanceIdentifier(requestPoints.getPoint(currentRequestNumber), distance);
+	}
+
+	ThreadPool threadPool;
+	KDForestBuildParameters parameters;
+	parameters.threadPool = &threadPool;
+
+	BenchmarkClock::time_point start = BenchmarkClock::now();
+	KDForest forest(points, parameters);
+	double forestBuildTime = getElapsedMilliseconds(start);
+
+	parameters.rotate = true;
+	start = BenchmarkClock::now();
+	KDForest rotatedForest(points, parameters);
+	double rotatedForestBuildTime = getElapsedMilliseconds(start);
+
+	std::cout << "forest search, dimension " << FOREST_SEARCH_DIMENSION << ", " << FOREST_SEARCH_POINTS_NUMBER << " points, ";
+	std::cout << parameters.treesNumber << " trees built in " << forestBuildTime << " ms, rotated in " << rotatedForestBuildTime << " ms" << std::endl;
+	measureLeafBudgets("tree", tree, requestPoints, exactIdentifiers);
+	measureLeafBudgets("forest", forest, requestPoints, exactIdentifiers);
+	measureLeafBudgets("rotated forest", rotatedForest, requestPoints, exactIdentifiers);
+}
+
+struct ReadThroughput {
+	double meanQueriesPerSecond;
+	double minQueriesPerSecond;
+	unsigned long long swapsNumber;
+};
+
+//readers search the handle through snapshots while writer(stopping) runs on a thread of its own,
+//the queries done in every window are counted, so a stall at a swap shows up as a slow window
+ReadThroughput measureReads(KDTreeHandle &handle, const PointSet &requestPoints, int readersNumber, 
+	const std::function<void(const std::atomic<bool>&)> &writer) {
+
+	std::unique_ptr<std::atomic<long long>[]> queriesNumbers(new std::atomic<long long>[readersNumber * READER_COUNTERS_STRIDE]);
+	std::atomic<bool> stopping(false);
+	unsigned long long firstPublishedTreesNumber = handle.getPublishedTreesNumber();
+
+	std::vector<std::thread> readers;
+	for (int currentReader = 0; currentReader < readersNumber; ++currentReader) {
+		queriesNumbers[currentReader * READER_COUNTERS_STRIDE] = 0;
+		readers.push_back(std::thread([&, currentReader]() {
+			std::atomic<long long> &queriesNumber = queriesNumbers[currentReader * READER_COUNTERS_STRIDE];
+			for (int currentRequestNumber = currentReader; !stopping; currentRequestNumber = (currentRequestNumber + 1) % requestPoints.size()) {
+				double distance = 0;
+				handle.getMinDistanceIdentifier(requestPoints.getPoint(currentRequestNumber), distance);
+				queriesNumber.store(queriesNumber.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+			}
+		}));
+	}
+	std::thread writerThread([&]() {
+		writer(stopping);
+	});
+
+	std::vector<double> windowRates;
+	long long previousQueriesNumber = 0;
+	BenchmarkClock::time_point windowEnd = BenchmarkClock::now();
+	for (int currentWindow = 0; currentWindow < TREE_HANDLE_WINDOWS_NUMBER; ++currentWindow) {
+		windowEnd += std::chrono::milliseconds(TREE_HANDLE_WINDOW_MILLISECONDS);
+		std::this_thread::sleep_until(windowEnd);
+
+		long long queriesNumber = 0;
+		for (int currentReader = 0; currentReader < readersNumber; ++currentReader) {
+			queriesNumber += queriesNumbers[currentReader * READER_COUNTERS_STRIDE].load(std::memory_order_relaxed);
+		}
+		windowRates.push_back(1000.0 * (queriesNumber - previousQueriesNumber) / TREE_HANDLE_WINDOW_MILLISECONDS);
+		previousQueriesNumber = queriesNumber;
+	}
+
+	stopping = true;
+	writerThread.join();
+	for (size_t currentReader = 0; currentReader < readers.size(); ++currentReader) {
+		readers[currentReader].join();
+	}
+
+	ReadThroughput result;
+	result.meanQueriesPerSecond = 1000.0 * previousQueriesNumber / (TREE_HANDLE_WINDOWS_NUMBER * TREE_HANDLE_WINDOW_MILLISECONDS);
+	result.minQueriesPerSecond = *std::min_element(windowRates.begin(), windowRates.end());
+	result.swapsNumber = handle.getPublishedTreesNumber() - firstPublishedTreesNumber;
+	return result;
+}
+
+void printReadThroughput(const char* writerName, const ReadThroughput &result, const ReadThroughput &baseline) {
+	std::cout << "  " << std::setw(18) << std::left << writerName << std::right << std::setw(4) << result.swapsNumber << " swaps";
+	std::cout << ", reads " << std::setw(10) << result.meanQueriesPerSecond << " per second, slowest window " << std::setw(10) << result.minQueriesPerSecond;
+	std::cout << ", " << 100 * result.meanQueriesPerSecond / baseline.meanQueriesPerSecond << "% of no swaps" << std::endl;
+}
+
+//the readers leave a core to the writer, prebuilt trees show the cost of the swaps alone,
+//background rebuilds that of a writer building the trees as well
+void measureTreeHandle() {
+	std::default_random_engine engine(RANDOM_SEED);
+
+	PointSet points;
+	genPoints(&points, TREE_HANDLE_POINTS_NUMBER, TREE_HANDLE_DIMENSION, engine);
+
+	PointSet requestPoints;
+	genPoints(&requestPoints, REQUESTS_NUMBER, TREE_HANDLE_DIMENSION, engine);
+
+	std::vector<std::unique_ptr<KDTree> > prebuiltTrees;
+	for (int currentTree = 0; currentTree < TREE_HANDLE_WINDOWS_NUMBER; ++currentTree) {
+		prebuiltTrees.push_back(std::unique_ptr<KDTree>(new KDTree(points)));
+	}
+
+	int readersNumber = std::max(1, static_cast<int>(std::thread::hardware_concurrency()) - 1);
+	std::cout << "tree handle, dimension " << TREE_HANDLE_DIMENSION << ", " << TREE_HANDLE_POINTS_NUMBER << " points, ";
+	std::cout << readersNumber << " readers, " << TREE_HANDLE_WINDOW_MILLISECONDS << " ms windows" << std::endl;
+
+	KDTreeHandle handle(std::unique_ptr<KDTree>(new KDTree(points)));
+	ReadThroughput baseline = measureReads(handle, requestPoints, readersNumber, [](const std::atomic<bool> &) {
+		//do nothing
+	});
+	printReadThroughput("no swaps", baseline, baseline);
+
+	//one prebuilt tree is published every window
+	ReadThroughput swapsResult = measureReads(handle, requestPoints, readersNumber, [&](const std::atomic<bool> &stopping) {
+		BenchmarkClock::time_point nextSwap = BenchmarkClock::now();
+		for (size_t currentTree = 0; (currentTree < prebuiltTrees.size()) && !stopping; ++currentTree) {
+			handle.publish(std::move(prebuiltTrees[currentTree]));
+			handle.synchronize();
+
+			nextSwap += std::chrono::milliseconds(TREE_HANDLE_WINDOW_MILLISECONDS);
+			std::this_thread::sleep_until(nextSwap);
+		}
+	});
+	printReadThroughput("prebuilt trees", swapsResult, baseline);
+
+	ReadThroughput rebuildsResult = measureReads(handle, requestPoints, readersNumber, [&](const std::atomic<bool> &stopping) {
+		while (!stopping) {
+			handle.rebuildAsync(points, KDTreeBuildParameters());
+			handle.waitForRebuild();
+		}
+	});
+	printReadThroughput("background rebuilds", rebuildsResult, baseline);
+}
+
+void measureDynamicTree() {
+	std::default_random_engine engine(RANDOM_SEED);
+
+	PointSet points;
+	genPoints(&points, DYNAMIC_TREE_POINTS_NUMBER, DYNAMIC_TREE_DIMENSION, engine);
+
+	PointSet requestPoints;
+	genPoints(&requestPoints, REQUESTS_NUMBER, DYNAMIC_TREE_DIMENSION, engine);
+
+	std::cout << "dynamic tree, dimension " << DYNAMIC_TREE_DIMENSION << ", " << DYNAMIC_TREE_POINTS_NUMBER << " updates" << std::endl;
+
+	//every second update erases a point inserted earlier
+	DynamicKDTree dynamicTree(DYNAMIC_TREE_DIMENSION);
+	PointSet livePoints(DYNAMIC_TREE_DIMENSION);
+	BenchmarkClock::time_point start = BenchmarkClock::now();
+	for (int currentPointNumber = 0; currentPointNumber < points.size(); ++currentPointNumber) {
+		if (currentPointNumber % 2 == 1) {
+			dynamicTree.erase(currentPointNumber / 2);
+		} else {
+			dynamicTree.insert(points.getPoint(currentPointNumber), currentPointNumber);
+		}
+	}
+	double updatesTime = getElapsedMilliseconds(start);
+
+	//the even points of the second half are the ones which were not erased
+	for (int currentPointNumber = (points.size() / 2 + 1) / 2 * 2; currentPointNumber < points.size(); currentPointNumber += 2) {
+		livePoints.addPoint(points.getPoint(currentPointNumber), currentPointNumber);
+	}
+
+	KDTree staticTree(livePoints);
+	double dynamicQueriesTime = 0, staticQueriesTime = 0;
+	bool answersMatch = true;
+
+	for (int currentRequestNumber = 0; currentRequestNumber < requestPoints.size(); ++currentRequestNumber) {
+		double dynamicDistance = 0, staticDistance = 0;
+
+		start = BenchmarkClock::now();
+		dynamicTree.getMinDistanceIdentifier(requestPoints.getPoint(currentRequestNumber), dynamicDistance);
+		dynamicQueriesTime += getElapsedMilliseconds(start);
+
+		start = BenchmarkClock::now();
+		staticTree.getMinDistanceIdentifier(requestPoints.getPoint(currentRequestNumber), staticDistance);
+		staticQueriesTime += getElapsedMilliseconds(start);
+
+		answersMatch = answersMatch && (dynamicDistance == staticDistance);
+	}
+
+	std::cout << "  " << dynamicTree.size() << " live points, updates " << 1000 * updatesTime / points.size() << " us each" << std::endl;
+	std::cout << "  queries dynamic " << dynamicQueriesTime << " ms, rebuilt static " << staticQueriesTime << " ms, ratio ";
+	std::cout << dynamicQueriesTime / staticQueriesTime << (answersMatch ? ", answers match" : ", ANSWERS DIFFER") << std::endl;
+}
+
+template <typename Tree>
+void measureStorage(const char* storageName, const Tree &tree, double buildTime, const PointSet &requestPoints, const std::vector<int> &exactIdentifiers) {
+	std::vector<double> latencies(requestPoints.size());
+	int foundNumber = 0;
+	for (int currentRequestNumber = 0; currentRequestNumber < requestPoints.size(); ++currentRequestNumber) {
+		double distance = 0;
+		BenchmarkClock::time_point start = BenchmarkClock::now();
+		int identifier = tree.getMinDistanceIdentifier(requestPoints.getPoint(currentRequestNumber), distance);
+		latencies[currentRequestNumber] = getElapsedMilliseconds(start) * 1000;
+
+		foundNumber += (identifier == exactIdentifiers[currentRequestNumber]);
+	}
+
+	std::cout << "  " << std::setw(7) << std::left << storageName << std::right << " memory " << std::setw(7) << tree.getMemoryUsage() / 1048576.0 << " MB";
+	std::cout << ", build " << std::setw(8) << buildTime << " ms, recall " << 100.0 * foundNumber / requestPoints.size() << "%";
+	std::cout << ", p50 " << getPercentile(latencies, 0.5) << " us, p99 " << getPercentile(latencies, 0.99) << " us" << std::endl;
+}
+
+//the compact trees keep their exact points in a mapped file, whose size is printed as well
+template <typename Tree>
+void measureCompactStorage(const char* storageName, const PointSet &points, const PointSet &requestPoints, const std::vector<int> &exactIdentifiers) {
+	BenchmarkClock::time_point start = BenchmarkClock::now();
+	std::unique_ptr<Tree> tree;
+	if (typename Tree::ExactTree(points).save(EXACT_TREE_FILE_NAME)) {
+		tree = Tree::create(Tree::ExactTree::open(EXACT_TREE_FILE_NAME, false));
+	}
+	double buildTime = getElapsedMilliseconds(start);
+
+	if (!tree) {
+		std::cout << "  " << storageName << " exact file " << EXACT_TREE_FILE_NAME << " can not be written" << std::endl;
+		remove(EXACT_TREE_FILE_NAME);
+		return;
+	}
+
+	std::ifstream exactFile(EXACT_TREE_FILE_NAME, std::ios::binary | std::ios::ate);
+	std::cout << "  " << std::setw(7) << std::left << storageName << std::right << " mapped exact file " << exactFile.tellg() / 1048576.0 << " MB" << std::endl;
+	measureStorage(storageName, *tree, buildTime, requestPoints, exactIdentifiers);
+
+	tree.reset();
+	remove(EXACT_TREE_FILE_NAME);
+}
+
+void measureCompactStorage() {
+	std::default_random_engine engine(RANDOM_SEED);
+
+	PointSet points;
+	genPoints(&points, COMPACT_STORAGE_POINTS_NUMBER, COMPACT_STORAGE_DIMENSION, engine);
+
+	PointSet requestPoints;
+	genPoints(&requestPoints, REQUESTS_NUMBER, COMPACT_STORAGE_DIMENSION, engine);
+
+	std::vector<int> exactIdentifiers(requestPoints.size());
+	{
+		KDTree tree(points);
+		for (int currentRequestNumber = 0; currentRequestNumber < requestPoints.size(); ++currentRequestNumber) {
+			double distance = 0;
+			exactIdentifiers[currentRequestNumber] = tree.getMinDistanceIdentifier(requestPoints.getPoint(currentRequestNumber), distance);
+		}
+	}
+
+	std::cout << "compact storage, dimension " << COMPACT_STORAGE_DIMENSION << ", " << COMPACT_STORAGE_POINTS_NUMBER << " points";
+	std::cout << ", exact points " << static_cast<double>(points.size()) * points.getStride() * sizeof(double) / 1048576.0 << " MB" << std::endl;
+
+	{
+		BenchmarkClock::time_point start = BenchmarkClock::now();
+		KDTree tree(points);
+		measureStorage("double", tree, getElapsedMilliseconds(start), requestPoints, exactIdentifiers);
+	}
+	measureCompactStorage<FloatKDTree>("float", points, requestPoints, exactIdentifiers);
+	measureCompactStorage<Int16KDTree>("int16", points, requestPoints, exactIdentifiers);
+}
+
+std::string readWholeFile(const char* fileName) {
+	std::ifstream file(fileName, std::ios::binary);
+	std::ostringstream content;
+	content << file.rdbuf();
+	return content.str();
+}
+
+void measureTextIO() {
+	std::default_random_engine engine(RANDOM_SEED);
+	std::uniform_real_distribution<> randomGenerator(MIN_COORDINATE_VALUE, MAX_COORDINATE_VALUE);
+
+	std::vector<double> numbers(TEXT_IO_NUMBERS_NUMBER);
+	{
+		std::ofstream inputFile(TEXT_IO_INPUT_FILE_NAME);
+		inputFile << std::setprecision(15);
+		for (int currentNumber = 0; currentNumber < TEXT_IO_NUMBERS_NUMBER; ++currentNumber) {
+			numbers[currentNumber] = randomGenerator(engine);
+			inputFile << numbers[currentNumber] << (currentNumber % 10 == 9 ? '\n' : ' ');
+		}
+	}
+
+	std::cout << "text input and output, " << TEXT_IO_NUMBERS_NUMBER << " numbers" << std::endl;
+
+	std::vector<double> streamNumbers(TEXT_IO_NUMBERS_NUMBER), mappedNumbers(TEXT_IO_NUMBERS_NUMBER), blockNumbers(TEXT_IO_NUMBERS_NUMBER);
+	BenchmarkClock::time_point start = BenchmarkClock::now();
+	{
+		std::ifstream inputFile(TEXT_IO_INPUT_FILE_NAME);
+		for (int currentNumber = 0; currentNumber < TEXT_IO_NUMBERS_NUMBER; ++currentNumber) {
+			inputFile >> streamNumbers[currentNumber];
+		}
+	}
+	double streamReadTime = getElapsedMilliseconds(start);
+
+	start = BenchmarkClock::now();
+	{
+		FastInput input(TEXT_IO_INPUT_FILE_NAME);
+		for (int currentNumber = 0; currentNumber < TEXT_IO_NUMBERS_NUMBER; ++currentNumber) {
+			input.readDouble(mappedNumbers[currentNumber]);
+		}
+	}
+	double mappedReadTime = getElapsedMilliseconds(start);
+
+	start = BenchmarkClock::now();
+	{
+		FILE* inputFile = fopen(TEXT_IO_INPUT_FILE_NAME, "rb");
+		FastInput input(inputFile);
+		for (int currentNumber = 0; currentNumber < TEXT_IO_NUMBERS_NUMBER; ++currentNumber) {
+			input.readDouble(blockNumbers[currentNumber]);
+		}
+		fclose(inputFile);
+	}
+	double blockReadTime = getElapsedMilliseconds(start);
+
+	bool inputsMatch = (streamNumbers == mappedNumbers) && (streamNumbers == blockNumbers);
+	std::cout << "  read  iostream " << std::setw(9) << streamReadTime << " ms, mapped " << std::setw(9) << mappedReadTime << " ms";
+	std::cout << ", blocks " << std::setw(9) << blockReadTime << " ms, speedup " << streamReadTime / mappedReadTime;
+	std::cout << (inputsMatch ? ", values match" : ", VALUES DIFFER") << std::endl;
+
+	//the old answerRequests format: an identifier and a distance with 15 significant digits per line
+	start = BenchmarkClock::now();
+	{
+		std::ofstream outputFile(TEXT_IO_OUTPUT_FILE_NAME);
+		outputFile << std::setprecision(15);
+		for (int currentNumber = 0; currentNumber < TEXT_IO_NUMBERS_NUMBER; ++currentNumber) {
+			outputFile << currentNumber << ' ' << fabs(numbers[currentNumber]) << std::endl;
+		}
+	}
+	double streamWriteTime = getElapsedMilliseconds(start);
+	std::string streamOutput = readWholeFile(TEXT_IO_OUTPUT_FILE_NAME);
+
+	start = BenchmarkClock::now();
+	{
+		FILE* outputFile = fopen(TEXT_IO_OUTPUT_FILE_NAME, "wb");
+		FastOutput output(outputFile);
+		for (int currentNumber = 0; currentNumber < TEXT_IO_NUMBERS_NUMBER; ++currentNumber) {
+			output.writeInt(currentNumber);
+			output.writeChar(' ');
+			output.writeDouble(fabs(numbers[currentNumber]));
+			output.writeChar('\n');
+		}
+		output.flush();
+		fclose(outputFile);
+	}
+	double fastWriteTime = getElapsedMilliseconds(start);
+	std::string fastOutput = readWholeFile(TEXT_IO_OUTPUT_FILE_NAME);
+
+	std::cout << "  write iostream " << std::setw(9) << streamWriteTime << " ms, buffered " << std::setw(9) << fastWriteTime << " ms";
+	std::cout << ", speedup " << streamWriteTime / fastWriteTime << (streamOutput == fastOutput ? ", bytes match" : ", BYTES DIFFER") << std::endl;
+
+	remove(TEXT_IO_INPUT_FILE_NAME);
+	remove(TEXT_IO_OUTPUT_FILE_NAME);
+}
+
+int main() {
+	std::cout << std::fixed << std::setprecision(2);
+
+	compareDimensionSpecialization<3>();
+	compareDimensionSpecialization<8>();
+	compareDimensionSpecialization<10>();
+
+	measureParallelBuild();
+	measureApproximateSearch();
+	measureForestSearch();
+	measureDynamicTree();
+	measureTreeHandle();
+	measureTextIO();
+	measureCompactStorage();
+
+	return 0;
+}
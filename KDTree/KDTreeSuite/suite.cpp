@@ -0,0 +1,491 @@
+#include "../KDTree/KDTree.h"
+#include "../KDTree/BruteForce.h"
+#include "../KDTree/BallTree.h"
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <random>
+#include <chrono>
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+//every configuration gets its own generator seeded from these, so results do not depend on the order of the sweep
+const unsigned int DEFAULT_RANDOM_SEED = 2015;
+
+const double MIN_COORDINATE_VALUE = -100.0;
+const double MAX_COORDINATE_VALUE = 100.0;
+
+const int CLUSTERS_NUMBER = 16;
+const double CLUSTER_DEVIATION = 2.0;
+const int MANIFOLD_DIMENSION = 2;
+const int DUPLICATES_PER_POINT = 100;
+
+typedef std::chrono::steady_clock BenchmarkClock;
+
+//misses of one cache level made by the calling thread, a counter the system does not give reads -1
+class CacheMissCounter {
+public:
+	enum CacheLevel {
+		L1D_CACHE,
+		LAST_LEVEL_CACHE
+	};
+
+	explicit CacheMissCounter(CacheLevel level) :
+		descriptor_(-1) {
+
+#ifdef __linux__
+		perf_event_attr attributes;
+		memset(&attributes, 0, sizeof(attributes));
+		attributes.type = PERF_TYPE_HW_CACHE;
+		attributes.size = sizeof(attributes);
+		attributes.config = (level == L1D_CACHE ? PERF_COUNT_HW_CACHE_L1D : PERF_COUNT_HW_CACHE_LL) |
+			(PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+		attributes.disabled = 1;
+		attributes.exclude_kernel = 1;
+		attributes.exclude_hv = 1;
+		descriptor_ = static_cast<int>(syscall(__NR_perf_event_open, &attributes, 0, -1, -1, 0));
+#endif
+	}
+
+	~CacheMissCounter() {
+#ifdef __linux__
+		if (descriptor_ >= 0) {
+			close(descriptor_);
+		}
+#endif
+	}
+
+	void start() {
+#ifdef __linux__
+		if (descriptor_ >= 0) {
+			ioctl(descriptor_, PERF_EVENT_IOC_RESET, 0);
+			ioctl(descriptor_, PERF_EVENT_IOC_ENABLE, 0);
+		}
+#endif
+	}
+
+	long long stop() {
+#ifdef __linux__
+		long long missesNumber = 0;
+		if ((descriptor_ >= 0) && (ioctl(descriptor_, PERF_EVENT_IOC_DISABLE, 0) == 0) &&
+			(read(descriptor_, &missesNumber, sizeof(missesNumber)) == sizeof(missesNumber))) {
+
+			return missesNumber;
+		}
+#endif
+		return -1;
+	}
+
+private:
+	int descriptor_;
+
+	CacheMissCounter(const CacheMissCounter&);
+	CacheMissCounter& operator=(const CacheMissCounter&);
+};
+
+struct SuiteParameters {
+	std::vector<int> pointsNumbers;
+	std::vector<int> dimensions;
+	std::vector<int> leafSizes;
+	std::vector<std::string> distributions;
+	std::vector<std::string> queryOrders;
+	int requestsNumber;
+	int checkedRequestsNumber;
+	unsigned int seed;
+	std::string format;
+	std::string outputFileName;
+
+	SuiteParameters() :
+		requestsNumber(10000),
+		checkedRequestsNumber(1000),
+		seed(DEFAULT_RANDOM_SEED),
+		format("json") {
+
+		pointsNumbers.push_back(10000);
+		pointsNumbers.push_back(100000);
+		dimensions.push_back(2);
+		dimensions.push_back(3);
+		dimensions.push_back(10);
+		leafSizes.push_back(DEFAULT_LEAF_SIZE);
+		distributions.push_back("uniform");
+		distributions.push_back("clusters");
+		distributions.push_back("manifold");
+		distributions.push_back("duplicates");
+		queryOrders.push_back("arrival");
+	}
+};
+
+struct SuiteResult {
+	std::string distribution;
+	std::string queryOrder;
+	int pointsNumber;
+	int dimension;
+	int leafSize;
+	std::string splitRule;
+	bool bruteForce;
+	int depth;
+	double buildTime;
+	double queriesPerSecond;
+	double medianLatency;
+	double tailLatency;
+	double batchQueriesPerSecond;
+	double l1dMissesPerQuery;
+	double llcMissesPerQuery;
+	double ballTreeBuildTime;
+	double ballTreeQueriesPerSecond;
+	//the index with more queries per second on this dataset
+	std::string fasterIndex;
+	size_t memoryUsage;
+	int checkedNumber;
+	int mismatchesNumber;
+	SearchStatsHistogram stats;
+};
+
+double getElapsedMilliseconds(BenchmarkClock::time_point start) {
+	return std::chrono::duration<double, std::milli>(BenchmarkClock::now() - start).count();
+}
+
+double getPercentile(std::vector<double> values, double percentile) {
+	std::sort(values.begin(), values.end());
+	return values[std::min(values.size() - 1, static_cast<size_t>(percentile * values.size()))];
+}
+
+//the points of a distribution are drawn from the generator only, the shape of clusters and manifolds is part of it
+void genPoints(PointSet* points, const std::string &distribution, int pointsNumber, int dimension, std::default_random_engine &shapeEngine,
+	std::default_random_engine &engine) {
+
+	std::uniform_real_distribution<> uniformGenerator(MIN_COORDINATE_VALUE, MAX_COORDINATE_VALUE);
+	std::normal_distribution<> normalGenerator(0, CLUSTER_DEVIATION);
+
+	(*points).changeDimension(dimension);
+	(*points).resize(pointsNumber);
+
+	std::vector<double> centers(CLUSTERS_NUMBER * dimension);
+	std::vector<double> frequencies(MANIFOLD_DIMENSION * dimension), phases(dimension);
+	for (size_t currentValue = 0; currentValue < centers.size(); ++currentValue) {
+		centers[currentValue] = uniformGenerator(shapeEngine);
+	}
+	for (size_t currentValue = 0; currentValue < frequencies.size(); ++currentValue) {
+		frequencies[currentValue] = uniformGenerator(shapeEngine) / MAX_COORDINATE_VALUE * 3;
+	}
+	for (size_t currentValue = 0; currentValue < phases.size(); ++currentValue) {
+		phases[currentValue] = uniformGenerator(shapeEngine);
+	}
+
+	PointSet distinctPoints(dimension);
+	if (distribution == "duplicates") {
+		genPoints(&distinctPoints, "uniform", std::max(1, pointsNumber / DUPLICATES_PER_POINT), dimension, shapeEngine, shapeEngine);
+	}
+
+	for (int currentPointNumber = 0; currentPointNumber < pointsNumber; ++currentPointNumber) {
+		(*points).setIdentifier(currentPointNumber, currentPointNumber);
+		double* currentPoint = (*points).getPoint(currentPointNumber);
+
+		if (distribution == "clusters") {
+			const double* center = &centers[dimension * (engine() % CLUSTERS_NUMBER)];
+			for (int currentCoordinate = 0; currentCoordinate < dimension; ++currentCoordinate) {
+				currentPoint[currentCoordinate] = center[currentCoordinate] + normalGenerator(engine);
+			}
+		} else if (distribution == "manifold") {
+			//a curved surface of dimension MANIFOLD_DIMENSION
+			double parameters[MANIFOLD_DIMENSION];
+			for (int currentParameter = 0; currentParameter < MANIFOLD_DIMENSION; ++currentParameter) {
+				parameters[currentParameter] = uniformGenerator(engine) / MAX_COORDINATE_VALUE;
+			}
+			for (int currentCoordinate = 0; currentCoordinate < dimension; ++currentCoordinate) {
+				double angle = phases[currentCoordinate];
+				for (int currentParameter = 0; currentParameter < MANIFOLD_DIMENSION; ++currentParameter) {
+					angle += frequencies[MANIFOLD_DIMENSION * currentCoordinate + currentParameter] * parameters[currentParameter];
+				}
+				currentPoint[currentCoordinate] = MAX_COORDINATE_VALUE * sin(angle);
+			}
+		} else if (distribution == "duplicates") {
+			const double* distinctPoint = distinctPoints.getPoint(engine() % distinctPoints.size());
+			std::copy(distinctPoint, distinctPoint + dimension, currentPoint);
+		} else {
+			for (int currentCoordinate = 0; currentCoordinate < dimension; ++currentCoordinate) {
+				currentPoint[currentCoordinate] = uniformGenerator(engine);
+			}
+		}
+	}
+}
+
+QueryOrder getQueryOrder(const std::string &name) {
+	if (name == "morton") {
+		return MORTON_QUERY_ORDER;
+	}
+	if (name == "hilbert") {
+		return HILBERT_QUERY_ORDER;
+	}
+	return ARRIVAL_QUERY_ORDER;
+}
+
+double getMissesPerQuery(long long missesNumber, int requestsNumber) {
+	return (missesNumber < 0 ? -1 : static_cast<double>(missesNumber) / requestsNumber);
+}
+
+SuiteResult runConfiguration(const SuiteParameters &parameters, const std::string &distribution, const std::string &queryOrder, 
+	int pointsNumber, int dimension, int leafSize) {
+
+	SuiteResult result;
+	result.distribution = distribution;
+	result.queryOrder = queryOrder;
+	result.pointsNumber = pointsNumber;
+	result.dimension = dimension;
+
+	std::default_random_engine shapeEngine(parameters.seed);
+	std::default_random_engine engine(parameters.seed + 1);
+
+	PointSet points;
+	genPoints(&points, distribution, pointsNumber, dimension, shapeEngine, engine);
+
+	//the queries follow the distribution of the points
+	shapeEngine.seed(parameters.seed);
+	PointSet requestPoints;
+	genPoints(&requestPoints, distribution, parameters.requestsNumber, dimension, shapeEngine, engine);
+
+	//leaf size zero asks the build to tune the leaf size and the split rule and to fall back to a scan when it is cheaper
+	KDTreeBuildParameters buildParameters;
+	buildParameters.leafSize = (leafSize > 0 ? leafSize : DEFAULT_LEAF_SIZE);
+	buildParameters.autoTune = (leafSize == 0);
+	buildParameters.tuneSplitRule = (leafSize == 0);
+	buildParameters.bruteForceFallback = (leafSize == 0);
+
+	BenchmarkClock::time_point start = BenchmarkClock::now();
+	KDTree tree(points, buildParameters);
+	result.buildTime = getElapsedMilliseconds(start);
+	result.leafSize = tree.getLeafSize();
+	result.splitRule = (tree.getSplitRule() == MAX_VARIANCE_SPLIT ? "variance" : "widest");
+	result.bruteForce = tree.isBruteForce();
+	result.depth = tree.getDepth();
+	result.memoryUsage = tree.getMemoryUsage();
+
+	std::vector<double> latencies(requestPoints.size());
+	std::vector<double> distances(requestPoints.size());
+	BenchmarkClock::time_point queriesStart = BenchmarkClock::now();
+	for (int currentRequestNumber = 0; currentRequestNumber < requestPoints.size(); ++currentRequestNumber) {
+		start = BenchmarkClock::now();
+		tree.getMinDistanceIdentifier(requestPoints.getPoint(currentRequestNumber), distances[currentRequestNumber]);
+		latencies[currentRequestNumber] = getElapsedMilliseconds(start) * 1000;
+	}
+	result.queriesPerSecond = requestPoints.size() / (getElapsedMilliseconds(queriesStart) / 1000);
+	result.medianLatency = getPercentile(latencies, 0.5);
+	result.tailLatency = getPercentile(latencies, 0.99);
+
+	//the whole batch runs as one task on this thread, so the cache counters see all of its searches
+	std::vector<int> batchIdentifiers(requestPoints.size());
+	std::vector<double> batchDistances(requestPoints.size());
+	ThreadPool threadPool(1);
+	CacheMissCounter l1dCounter(CacheMissCounter::L1D_CACHE);
+	CacheMissCounter llcCounter(CacheMissCounter::LAST_LEVEL_CACHE);
+	l1dCounter.start();
+	llcCounter.start();
+	start = BenchmarkClock::now();
+	tree.queryBatch(requestPoints, batchIdentifiers, batchDistances, threadPool, getQueryOrder(queryOrder), std::max(1, requestPoints.size()));
+	result.batchQueriesPerSecond = requestPoints.size() / (getElapsedMilliseconds(start) / 1000);
+	result.llcMissesPerQuery = getMissesPerQuery(llcCounter.stop(), requestPoints.size());
+	result.l1dMissesPerQuery = getMissesPerQuery(l1dCounter.stop(), requestPoints.size());
+
+	//the ball tree answers the same queries with the same leaf size
+	start = BenchmarkClock::now();
+	BallTree ballTree(points, result.leafSize);
+	result.ballTreeBuildTime = getElapsedMilliseconds(start);
+
+	std::vector<double> ballTreeDistances(requestPoints.size());
+	start = BenchmarkClock::now();
+	for (int currentRequestNumber = 0; currentRequestNumber < requestPoints.size(); ++currentRequestNumber) {
+		ballTree.getMinDistanceIdentifier(requestPoints.getPoint(currentRequestNumber), ballTreeDistances[currentRequestNumber]);
+	}
+	result.ballTreeQueriesPerSecond = requestPoints.size() / (getElapsedMilliseconds(start) / 1000);
+	result.fasterIndex = (result.ballTreeQueriesPerSecond > result.queriesPerSecond ? "ball_tree" : "kd_tree");
+
+	//the counters are gathered apart from the timed loop, so they do not disturb the latencies
+	for (int currentRequestNumber = 0; currentRequestNumber < requestPoints.size(); ++currentRequestNumber) {
+		SearchStats stats;
+		double distance;
+		tree.getMinDistanceIdentifier(requestPoints.getPoint(currentRequestNumber), distance, stats);
+		result.stats.add(stats);
+	}
+
+	result.checkedNumber = std::min(parameters.checkedRequestsNumber, requestPoints.size());
+	result.mismatchesNumber = 0;
+	for (int currentRequestNumber = 0; currentRequestNumber < result.checkedNumber; ++currentRequestNumber) {
+		double expectedDistance = simpleAlgoritm(points, requestPoints.getPoint(currentRequestNumber));
+		if ((fabs(distances[currentRequestNumber] - expectedDistance) > EPS) || (fabs(batchDistances[currentRequestNumber] - expectedDistance) > EPS)
+			|| (fabs(ballTreeDistances[currentRequestNumber] - expectedDistance) > EPS)) {
+
+			++result.mismatchesNumber;
+		}
+	}
+
+	return result;
+}
+
+//counters that could not be read are null in json
+std::string getJsonValue(double value) {
+	if (value < 0) {
+		return "null";
+	}
+
+	std::ostringstream output;
+	output << std::fixed << std::setprecision(3) << value;
+	return output.str();
+}
+
+void printResults(const std::vector<SuiteResult> &results, const std::string &format, std::ostream &output) {
+	output << std::fixed << std::setprecision(3);
+
+	if (format == "csv") {
+		output << "distribution,query_order,points,dimension,leaf_size,split_rule,brute_force,depth,build_ms,queries_per_second,p50_us,p99_us,";
+		output << "batch_queries_per_second,l1d_misses_per_query,llc_misses_per_query,ball_tree_build_ms,ball_tree_queries_per_second,faster_index,memory_bytes,";
+		output << "mean_nodes,p99_nodes,mean_leaves,mean_distances,p99_distances,mean_pruned,checked,mismatches\n";
+		for (size_t currentResult = 0; currentResult < results.size(); ++currentResult) {
+			const SuiteResult &result = results[currentResult];
+			output << result.distribution << ',' << result.queryOrder << ',' << result.pointsNumber << ',' << result.dimension << ',' << result.leafSize << ',' << result.splitRule << ',' << result.bruteForce << ',' << result.depth << ',';
+			output << result.buildTime << ',' << result.queriesPerSecond << ',' << result.medianLatency << ',' << result.tailLatency << ',';
+			output << result.batchQueriesPerSecond << ',' << result.l1dMissesPerQuery << ',' << result.llcMissesPerQuery << ',';
+			output << result.ballTreeBuildTime << ',' << result.ballTreeQueriesPerSecond << ',' << result.fasterIndex << ',';
+			output << result.memoryUsage << ',' << result.stats.nodesVisited.getMean() << ',' << result.stats.nodesVisited.getPercentile(0.99) << ',';
+			output << result.stats.leavesScanned.getMean() << ',' << result.stats.distancesComputed.getMean() << ',';
+			output << result.stats.distancesComputed.getPercentile(0.99) << ',' << result.stats.subtreesPruned.getMean() << ',';
+			output << result.checkedNumber << ',' << result.mismatchesNumber << '\n';
+		}
+		return;
+	}
+
+	output << "[\n";
+	for (size_t currentResult = 0; currentResult < results.size(); ++currentResult) {
+		const SuiteResult &result = results[currentResult];
+		output << "  {\"distribution\": \"" << result.distribution << "\", \"query_order\": \"" << result.queryOrder << "\"";
+		output << ", \"points\": " << result.pointsNumber;
+		output << ", \"dimension\": " << result.dimension << ", \"leaf_size\": " << result.leafSize;
+		output << ", \"split_rule\": \"" << result.splitRule << "\"";
+		output << ", \"brute_force\": " << (result.bruteForce ? "true" : "false") << ", \"depth\": " << result.depth;
+		output << ", \"build_ms\": " << result.buildTime << ", \"queries_per_second\": " << result.queriesPerSecond;
+		output << ", \"p50_us\": " << result.medianLatency << ", \"p99_us\": " << result.tailLatency;
+		output << ", \"batch_queries_per_second\": " << result.batchQueriesPerSecond;
+		output << ", \"l1d_misses_per_query\": " << getJsonValue(result.l1dMissesPerQuery);
+		output << ", \"llc_misses_per_query\": " << getJsonValue(result.llcMissesPerQuery);
+		output << ", \"ball_tree_build_ms\": " << result.ballTreeBuildTime << ", \"ball_tree_queries_per_second\": " << result.ballTreeQueriesPerSecond;
+		output << ", \"faster_index\": \"" << result.fasterIndex << "\"";
+		output << ", \"memory_bytes\": " << result.memoryUsage;
+		output << ", \"mean_nodes\": " << result.stats.nodesVisited.getMean() << ", \"p99_nodes\": " << result.stats.nodesVisited.getPercentile(0.99);
+		output << ", \"mean_leaves\": " << result.stats.leavesScanned.getMean();
+		output << ", \"mean_distances\": " << result.stats.distancesComputed.getMean();
+		output << ", \"p99_distances\": " << result.stats.distancesComputed.getPercentile(0.99);
+		output << ", \"mean_pruned\": " << result.stats.subtreesPruned.getMean() << ", \"checked\": " << result.checkedNumber;
+		output << ", \"mismatches\": " << result.mismatchesNumber << "}" << (currentResult + 1 < results.size() ? "," : "") << "\n";
+	}
+	output << "]\n";
+}
+
+template <typename Value>
+std::vector<Value> parseList(const std::string &text) {
+	std::vector<Value> values;
+	std::istringstream input(text);
+	std::string item;
+
+	while (std::getline(input, item, ',')) {
+		std::istringstream itemInput(item);
+		Value value;
+		itemInput >> value;
+		values.push_back(value);
+	}
+
+	return values;
+}
+
+void printUsage() {
+	std::cerr << "usage: KDTreeSuite [--points 10000,100000] [--dimensions 2,3,10] [--leaf-sizes 8, 0 tunes]" << std::endl;
+	std::cerr << "       [--distributions uniform,clusters,manifold,duplicates] [--queries 10000] [--checked 1000]" << std::endl;
+	std::cerr << "       [--query-orders arrival,morton,hilbert] [--seed 2015] [--format json|csv] [--output file]" << std::endl;
+}
+
+bool parseArguments(int argc, char* argv[], SuiteParameters &parameters) {
+	for (int currentArgument = 1; currentArgument < argc; currentArgument += 2) {
+		if (currentArgument + 1 >= argc) {
+			return false;
+		}
+
+		std::string name = argv[currentArgument];
+		std::string value = argv[currentArgument + 1];
+		if (name == "--points") {
+			parameters.pointsNumbers = parseList<int>(value);
+		} else if (name == "--dimensions") {
+			parameters.dimensions = parseList<int>(value);
+		} else if (name == "--leaf-sizes") {
+			parameters.leafSizes = parseList<int>(value);
+		} else if (name == "--distributions") {
+			parameters.distributions = parseList<std::string>(value);
+		} else if (name == "--query-orders") {
+			parameters.queryOrders = parseList<std::string>(value);
+		} else if (name == "--queries") {
+			parameters.requestsNumber = atoi(value.c_str());
+		} else if (name == "--checked") {
+			parameters.checkedRequestsNumber = atoi(value.c_str());
+		} else if (name == "--seed") {
+			parameters.seed = static_cast<unsigned int>(atoi(value.c_str()));
+		} else if (name == "--format") {
+			parameters.format = value;
+		} else if (name == "--output") {
+			parameters.outputFileName = value;
+		} else {
+			return false;
+		}
+	}
+
+	for (size_t currentQueryOrder = 0; currentQueryOrder < parameters.queryOrders.size(); ++currentQueryOrder) {
+		const std::string &queryOrder = parameters.queryOrders[currentQueryOrder];
+		if ((queryOrder != "arrival") && (queryOrder != "morton") && (queryOrder != "hilbert")) {
+			return false;
+		}
+	}
+
+	return (parameters.format == "json") || (parameters.format == "csv");
+}
+
+int main(int argc, char* argv[]) {
+	SuiteParameters parameters;
+	if (!parseArguments(argc, argv, parameters)) {
+		printUsage();
+		return 1;
+	}
+
+	std::vector<SuiteResult> results;
+	int mismatchesNumber = 0;
+	for (size_t currentDistribution = 0; currentDistribution < parameters.distributions.size(); ++currentDistribution) {
+		for (size_t currentPointsNumber = 0; currentPointsNumber < parameters.pointsNumbers.size(); ++currentPointsNumber) {
+			for (size_t currentDimension = 0; currentDimension < parameters.dimensions.size(); ++currentDimension) {
+				for (size_t currentLeafSize = 0; currentLeafSize < parameters.leafSizes.size(); ++currentLeafSize) {
+					for (size_t currentQueryOrder = 0; currentQueryOrder < parameters.queryOrders.size(); ++currentQueryOrder) {
+						results.push_back(runConfiguration(parameters, parameters.distributions[currentDistribution], parameters.queryOrders[currentQueryOrder],
+							parameters.pointsNumbers[currentPointsNumber], parameters.dimensions[currentDimension], parameters.leafSizes[currentLeafSize]));
+						mismatchesNumber += results.back().mismatchesNumber;
+					}
+				}
+			}
+		}
+	}
+
+	if (parameters.outputFileName.empty()) {
+		printResults(results, parameters.format, std::cout);
+	} else {
+		std::ofstream outputFile(parameters.outputFileName.c_str());
+		printResults(results, parameters.format, outputFile);
+	}
+
+	//a failed check fails the run, so the suite can guard releases
+	return (mismatchesNumber == 0 ? 0 : 2);
+}